@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <chrono>
+
+#include "audio.hpp"
+
+AudioRing::AudioRing(size_t capacity) : head(0), tail(0)
+{
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+size_t AudioRing::push(const stereo_sample* samples, size_t count)
+{
+    size_t current_tail = tail.load(std::memory_order_relaxed);
+    size_t free = buffer.size() - (current_tail - head.load(std::memory_order_acquire));
+    count = std::min(count, free);
+
+    for (size_t i = 0; i < count; i++)
+        buffer[(current_tail + i) & mask] = samples[i];
+
+    tail.store(current_tail + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::pop(stereo_sample* samples, size_t count)
+{
+    size_t current_head = head.load(std::memory_order_relaxed);
+    size_t available = tail.load(std::memory_order_acquire) - current_head;
+    count = std::min(count, available);
+
+    for (size_t i = 0; i < count; i++)
+        samples[i] = buffer[(current_head + i) & mask];
+
+    head.store(current_head + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::size() const
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+size_t AudioRing::capacity() const
+{
+    return buffer.size();
+}
+
+bool NullAudioSink::is_realtime() const
+{
+    return true;
+}
+
+void NullAudioSink::write(const stereo_sample* samples, size_t count)
+{
+
+}
+
+WavAudioSink::WavAudioSink() : data_size(0)
+{
+
+}
+
+WavAudioSink::~WavAudioSink()
+{
+    if (file.is_open())
+    {
+        write_header();
+        file.close();
+    }
+}
+
+bool WavAudioSink::open(const std::string& path)
+{
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    data_size = 0;
+    write_header();
+    return true;
+}
+
+//Written once up front and again on close, when the sizes are known
+void WavAudioSink::write_header()
+{
+    auto write32 = [this](uint32_t value) { file.write((char*)&value, sizeof(value)); };
+    auto write16 = [this](uint16_t value) { file.write((char*)&value, sizeof(value)); };
+
+    file.seekp(0);
+    file.write("RIFF", 4);
+    write32(36 + data_size);
+    file.write("WAVE", 4);
+
+    file.write("fmt ", 4);
+    write32(16);
+    write16(1);
+    write16(2);
+    write32(AudioOutput::SAMPLE_RATE);
+    write32(AudioOutput::SAMPLE_RATE * sizeof(stereo_sample));
+    write16(sizeof(stereo_sample));
+    write16(16);
+
+    file.write("data", 4);
+    write32(data_size);
+    file.seekp(0, std::ios::end);
+}
+
+bool WavAudioSink::is_realtime() const
+{
+    return false;
+}
+
+void WavAudioSink::write(const stereo_sample* samples, size_t count)
+{
+    file.write((const char*)samples, count * sizeof(stereo_sample));
+    data_size += count * sizeof(stereo_sample);
+}
+
+AudioOutput::AudioOutput() : ring(RING_SIZE), sink_realtime(false), running(false)
+{
+    produced = 0;
+    consumed = 0;
+    dropped = 0;
+    underruns = 0;
+    rate = 1.0;
+}
+
+AudioOutput::~AudioOutput()
+{
+    stop();
+}
+
+//Must not be called while the emulation thread is pushing samples
+void AudioOutput::set_sink(std::unique_ptr<AudioSink> new_sink)
+{
+    stop();
+
+    //Anything left over belongs to the old sink
+    stereo_sample discard[PERIOD];
+    while (ring.pop(discard, PERIOD));
+
+    sink = std::move(new_sink);
+    if (!sink)
+        return;
+
+    sink_realtime = sink->is_realtime();
+    rate = 1.0;
+    running = true;
+    thread = std::thread(&AudioOutput::output_loop, this);
+}
+
+void AudioOutput::stop()
+{
+    if (!thread.joinable())
+        return;
+    running = false;
+    thread.join();
+}
+
+void AudioOutput::push(const stereo_sample* samples, size_t count)
+{
+    if (!sink)
+        return;
+
+    produced += count;
+    if (sink_realtime)
+    {
+        //Running faster than real time: drop what doesn't fit rather than stall emulation
+        size_t pushed = ring.push(samples, count);
+        dropped += count - pushed;
+        return;
+    }
+
+    //Capture sinks must not lose anything, so wait for the output thread to catch up
+    while (count)
+    {
+        size_t pushed = ring.push(samples, count);
+        samples += pushed;
+        count -= pushed;
+        if (count)
+            std::this_thread::yield();
+    }
+}
+
+AudioMetrics AudioOutput::get_metrics() const
+{
+    AudioMetrics metrics;
+    metrics.fill = ring.size();
+    metrics.capacity = ring.capacity();
+    metrics.produced = produced;
+    metrics.consumed = consumed;
+    metrics.dropped = dropped;
+    metrics.underruns = underruns;
+    metrics.rate = rate;
+    return metrics;
+}
+
+void AudioOutput::output_loop()
+{
+    if (sink_realtime)
+        realtime_loop();
+    else
+        drain_loop();
+}
+
+/**
+ * Feeds the sink one PERIOD at a time on a 48 kHz clock.
+ * The input is resampled at a rate nudged by how far the ring is from TARGET_FILL, which stretches or squeezes
+ * playback slightly when emulation runs slower or faster than real time. This trades a small pitch shift for
+ * not having to stretch audio in the time domain.
+ */
+void AudioOutput::realtime_loop()
+{
+    typedef std::chrono::steady_clock clock;
+    const clock::duration period_duration = std::chrono::microseconds(1000000LL * PERIOD / SAMPLE_RATE);
+
+    std::vector<stereo_sample> input(PERIOD * 2 + 2);
+    stereo_sample output[PERIOD];
+    stereo_sample last = {0, 0};
+    double position = 0.0;
+
+    clock::time_point next_period = clock::now();
+    while (running)
+    {
+        double max_skew = MAX_RATE_SKEW;
+        double skew = ((double)ring.size() - TARGET_FILL) / TARGET_FILL;
+        double current_rate = 1.0 + std::max(-max_skew, std::min(max_skew, skew * max_skew));
+        rate = current_rate;
+
+        //input[0] is the last sample of the previous period, and position is relative to it
+        size_t needed = (size_t)(position + PERIOD * current_rate);
+        input[0] = last;
+        size_t popped = ring.pop(&input[1], needed);
+        consumed += popped;
+        if (popped < needed)
+            underruns++;
+
+        for (int i = 0; i < PERIOD; i++)
+        {
+            double pos = position + i * current_rate;
+            size_t index = (size_t)pos;
+            if (index >= popped)
+            {
+                output[i] = input[popped];
+                continue;
+            }
+
+            int32_t frac = (int32_t)((pos - index) * 0x8000);
+            const stereo_sample& a = input[index];
+            const stereo_sample& b = input[index + 1];
+            output[i].left = a.left + (((b.left - a.left) * frac) >> 15);
+            output[i].right = a.right + (((b.right - a.right) * frac) >> 15);
+        }
+
+        if (popped < needed)
+            position = 0.0;
+        else
+            position += PERIOD * current_rate - popped;
+        last = input[popped];
+
+        sink->write(output, PERIOD);
+
+        //If we fell far behind, e.g. after a breakpoint, don't try to make up for it all at once
+        next_period += period_duration;
+        clock::time_point now = clock::now();
+        if (now > next_period + period_duration * 4)
+            next_period = now;
+        std::this_thread::sleep_until(next_period);
+    }
+}
+
+void AudioOutput::drain_loop()
+{
+    stereo_sample buffer[PERIOD];
+    while (true)
+    {
+        bool stopping = !running;
+        size_t popped = ring.pop(buffer, PERIOD);
+        if (popped)
+        {
+            sink->write(buffer, popped);
+            consumed += popped;
+            continue;
+        }
+
+        //The ring is only known to be fully drained once it's empty after the stop request
+        if (stopping)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
@@ -0,0 +1,130 @@
+#ifndef AUDIO_HPP
+#define AUDIO_HPP
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "iop/spu.hpp"
+
+/**
+  * Single-producer single-consumer ring of stereo samples.
+  * Unlike CircularFifo, it moves samples in bulk and never dies when full; callers get back how many samples fit.
+  */
+class AudioRing
+{
+    private:
+        std::vector<stereo_sample> buffer;
+        size_t mask;
+
+        //Free-running counters, so the ring can be completely full without an empty slot
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+    public:
+        //Capacity is rounded up to a power of two
+        AudioRing(size_t capacity);
+
+        size_t push(const stereo_sample* samples, size_t count);
+        size_t pop(stereo_sample* samples, size_t count);
+
+        size_t size() const;
+        size_t capacity() const;
+};
+
+class AudioSink
+{
+    public:
+        virtual ~AudioSink() {}
+
+        //Realtime sinks are fed one period at a time at the output sample rate, with the rate adjusted to keep the
+        //ring from running dry or overflowing. Other sinks take every sample as soon as it has been produced.
+        virtual bool is_realtime() const = 0;
+        virtual void write(const stereo_sample* samples, size_t count) = 0;
+};
+
+//Consumes audio in real time without any audio hardware, for headless runs
+class NullAudioSink : public AudioSink
+{
+    public:
+        bool is_realtime() const override;
+        void write(const stereo_sample* samples, size_t count) override;
+};
+
+class WavAudioSink : public AudioSink
+{
+    private:
+        std::ofstream file;
+        uint32_t data_size;
+
+        void write_header();
+    public:
+        WavAudioSink();
+        ~WavAudioSink();
+
+        bool open(const std::string& path);
+
+        bool is_realtime() const override;
+        void write(const stereo_sample* samples, size_t count) override;
+};
+
+struct AudioMetrics
+{
+    size_t fill;
+    size_t capacity;
+    uint64_t produced;
+    uint64_t consumed;
+
+    //Samples thrown away because a realtime sink couldn't keep up
+    uint64_t dropped;
+
+    //Output periods that ran out of samples and had to hold the last one
+    uint64_t underruns;
+
+    //Rate the realtime output is currently consuming samples at, relative to 48 kHz
+    double rate;
+};
+
+/**
+  * Carries mixed SPU output from the emulation thread to an AudioSink on its own thread.
+  * Without a sink, pushed samples are discarded.
+  */
+class AudioOutput
+{
+    private:
+        constexpr static int RING_SIZE = 8192;
+        constexpr static int PERIOD = 480;
+
+        //The realtime rate controller aims for this many samples in the ring and never strays further than MAX_RATE_SKEW
+        constexpr static int TARGET_FILL = 2400;
+        constexpr static double MAX_RATE_SKEW = 0.05;
+
+        AudioRing ring;
+        std::unique_ptr<AudioSink> sink;
+        bool sink_realtime;
+
+        std::thread thread;
+        std::atomic_bool running;
+
+        std::atomic<uint64_t> produced, consumed, dropped, underruns;
+        std::atomic<double> rate;
+
+        void output_loop();
+        void realtime_loop();
+        void drain_loop();
+        void stop();
+    public:
+        constexpr static int SAMPLE_RATE = 48000;
+
+        AudioOutput();
+        ~AudioOutput();
+
+        void set_sink(std::unique_ptr<AudioSink> new_sink);
+        void push(const stereo_sample* samples, size_t count);
+
+        AudioMetrics get_metrics() const;
+};
+
+#endif // AUDIO_HPP
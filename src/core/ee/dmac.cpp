@@ -596,12 +596,14 @@ int DMAC::process_SIF0()
     uint32_t max_qwc = 8 - ((channels[EE_SIF0].address >> 4) & 0x7);
     int quads_to_transfer = std::min({channels[EE_SIF0].quadword_count, max_qwc, sif->get_SIF0_size() / 4U});
     int count = 0;
+
+    //A burst never exceeds 8 quadwords, so pull it out of the FIFO in one go
+    uint128_t quads[8];
+    if (quads_to_transfer)
+        sif->read_SIF0(quads, quads_to_transfer);
     while (count < quads_to_transfer)
     {
-        uint128_t quad;
-        for (int i = 0; i < 4; i++)
-            quad._u32[i] = sif->read_SIF0();
-        store128(channels[EE_SIF0].address, quad);
+        store128(channels[EE_SIF0].address, quads[count]);
         advance_dest_dma(EE_SIF0);
         count++;
     }
@@ -713,12 +715,14 @@ int DMAC::process_SIF1()
             channels[EE_SIF1].has_dma_stalled = false;
         }
 
+        uint128_t quads[8];
         while (count < quads_to_transfer)
         {
-            sif->write_SIF1(fetch128(channels[EE_SIF1].address));
+            quads[count] = fetch128(channels[EE_SIF1].address);
             advance_source_dma(EE_SIF1);
             count++;
         }
+        sif->write_SIF1(quads, count);
     }
     if (!channels[EE_SIF1].quadword_count)
     {
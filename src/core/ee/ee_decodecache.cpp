@@ -0,0 +1,39 @@
+#include "ee_decodecache.hpp"
+#include "emotioninterpreter.hpp"
+#include "../errors.hpp"
+
+EE_DecodeCache::EE_DecodeCache()
+{
+    reset();
+}
+
+void EE_DecodeCache::reset()
+{
+    pages.clear();
+    last_page_index = 0;
+    last_page = nullptr;
+}
+
+EE_DecodedInstr* EE_DecodeCache::lookup_page(uint32_t page_index)
+{
+    std::unique_ptr<EE_DecodedInstr[]>& page = pages[page_index];
+    if (!page)
+        page.reset(new EE_DecodedInstr[ENTRIES_PER_PAGE]());
+
+    last_page_index = page_index;
+    last_page = page.get();
+    return last_page;
+}
+
+EE_InterpreterFn EE_DecodeCache::decode(EE_DecodedInstr& entry, uint32_t instruction)
+{
+    EE_InstrInfo info;
+    EmotionInterpreter::lookup(info, instruction);
+
+    if (info.interpreter_fn == nullptr)
+        Errors::die("[EE Interpreter] Lookup returned nullptr interpreter_fn");
+
+    entry.instruction = instruction;
+    entry.fn = info.interpreter_fn;
+    return entry.fn;
+}
@@ -0,0 +1,54 @@
+#ifndef EE_DECODECACHE_HPP
+#define EE_DECODECACHE_HPP
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+class EmotionEngine;
+
+typedef void (*EE_InterpreterFn)(EmotionEngine&, uint32_t);
+
+struct EE_DecodedInstr
+{
+    uint32_t instruction;
+    EE_InterpreterFn fn;
+};
+
+/**
+  * Caches the interpreter handler for each instruction word, in pages indexed by virtual PC.
+  * Decoding only depends on the instruction word, so an entry is checked against the word just fetched instead of
+  * being invalidated on writes. That also catches code that was changed by DMA or through another mapping.
+  */
+class EE_DecodeCache
+{
+    private:
+        constexpr static int PAGE_SIZE = 4096;
+        constexpr static int ENTRIES_PER_PAGE = PAGE_SIZE / 4;
+
+        std::unordered_map<uint32_t, std::unique_ptr<EE_DecodedInstr[]>> pages;
+        uint32_t last_page_index;
+        EE_DecodedInstr* last_page;
+
+        EE_DecodedInstr* lookup_page(uint32_t page_index);
+        EE_InterpreterFn decode(EE_DecodedInstr& entry, uint32_t instruction);
+    public:
+        EE_DecodeCache();
+
+        void reset();
+        inline EE_InterpreterFn get(uint32_t PC, uint32_t instruction);
+};
+
+inline EE_InterpreterFn EE_DecodeCache::get(uint32_t PC, uint32_t instruction)
+{
+    uint32_t page_index = PC / PAGE_SIZE;
+    EE_DecodedInstr* page = last_page;
+    if (page_index != last_page_index || !page)
+        page = lookup_page(page_index);
+
+    EE_DecodedInstr& entry = page[(PC & (PAGE_SIZE - 1)) / 4];
+    if (entry.instruction == instruction && entry.fn)
+        return entry.fn;
+    return decode(entry, instruction);
+}
+
+#endif // EE_DECODECACHE_HPP
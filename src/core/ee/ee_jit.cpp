@@ -22,6 +22,31 @@ namespace EE_JIT
     {
         jit64.reset(clear_cache);
     }
+
+    void set_pass_enabled(EE_JitPass pass, bool enabled)
+    {
+        jit64.set_pass_enabled(pass, enabled);
+    }
+
+    void print_pass_stats()
+    {
+        jit64.print_pass_stats();
+    }
+
+    void set_block_stats_enabled(bool enabled)
+    {
+        jit64.set_block_stats_enabled(enabled);
+    }
+
+    void print_block_report(int count)
+    {
+        jit64.print_block_report(count);
+    }
+
+    void set_background_compile(bool enabled)
+    {
+        jit64.set_background_compile(enabled);
+    }
     /*
     void set_current_program(uint32_t crc)
     {
@@ -3,11 +3,17 @@
 #include <cstdint>
 
 class EmotionEngine;
+enum class EE_JitPass;
 
 namespace EE_JIT
 {
     uint16_t run(EmotionEngine* ee);
     void reset(bool clear_cache);
+    void set_pass_enabled(EE_JitPass pass, bool enabled);
+    void print_pass_stats();
+    void set_block_stats_enabled(bool enabled);
+    void print_block_report(int count = 20);
+    void set_background_compile(bool enabled);
 };
 
 #endif // EE_JIT_HPP
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <cmath>
 #include <algorithm>
 
@@ -7,6 +8,8 @@
 #include "../gif.hpp"
 
 #include "../errors.hpp"
+#include "../profiler.hpp"
+#include "../jitcommon/jitsymbols.hpp"
 
 /**
  * Calling convention notes (needed for calling C++ functions within generated code)
@@ -32,7 +35,11 @@
  * https://en.wikipedia.org/wiki/X86_calling_conventions#x86-64_calling_conventions
  */
 
-EE_JIT64::EE_JIT64() : jit_block("EE"), emitter(&jit_block), prologue_block(nullptr)
+uint32_t EE_JIT64::saved_mxcsr;
+uint32_t EE_JIT64::ee_mxcsr;
+
+EE_JIT64::EE_JIT64() : jit_block("EE"), emitter(&jit_block), prologue_block(nullptr), dispatcher_entry(nullptr),
+    background_compile(false), discarded_compiles(0)
 {
 }
 
@@ -45,6 +52,9 @@ void EE_JIT64::reset(bool clear_cache)
     saved_int_regs = std::vector<REG_64>();
     saved_xmm_regs = std::vector<REG_64>();
     cycles_added = 0;
+    gpr_live.clear();
+    gpr_refs.clear();
+    cur_instr = 0;
     for (int i = 0; i < 16; i++)
     {
         xmm_regs[i].used = false;
@@ -76,6 +86,7 @@ void EE_JIT64::reset(bool clear_cache)
 
     if (clear_cache)
     {
+        worker.cancel_all();
         jit_heap.flush_all_blocks();
         prologue_block = create_prologue_block();
     }
@@ -99,23 +110,155 @@ uint8_t* exec_block_ee(EE_JIT64& jit, EmotionEngine& ee)
         }
     }
 
-    if (is_modified || recompiledBlock == nullptr)
+    jit.jit_heap.record_dispatch_miss(ee.PC);
+
+    if (jit.background_compile && (is_modified || recompiledBlock == nullptr))
+    {
+        jit.install_compiled_blocks();
+        recompiledBlock = jit.jit_heap.find_block(ee.PC);
+
+        //Interpret until the block is ready rather than stalling on the compiler
+        if (!recompiledBlock)
+        {
+            jit.request_compile(ee);
+            ee.interpret_block();
+            return jit.dispatcher_entry;
+        }
+    }
+    else if (is_modified || recompiledBlock == nullptr)
     {
         printf("[EE_JIT64] Block not found at $%08X: recompiling\n", ee.PC);
+        uint64_t compile_start = Profiler::timestamp();
+        auto stats_start = std::chrono::steady_clock::now();
         IR::Block block = jit.ir.translate(ee);
+        jit.optimizer.optimize(block);
         recompiledBlock = jit.recompile_block(ee, block);
+        Profiler::add_jit_compile(Profiler::JIT_EE, compile_start);
+
+        EEJitBlockStats* stats = jit.jit_heap.get_block_stats(ee.PC);
+        if (stats)
+        {
+            std::chrono::nanoseconds compile_time = std::chrono::steady_clock::now() - stats_start;
+            stats->compile_ns += compile_time.count();
+            stats->compiles++;
+            stats->guest_instrs = block.get_guest_instruction_count();
+            stats->host_size = (uint8_t*)recompiledBlock->code_end - (uint8_t*)recompiledBlock->code_start;
+        }
     }
     jit.jit_heap.lookup_cache[(ee.PC >> 2) & 0x7FFF] = recompiledBlock;
     return (uint8_t*)recompiledBlock->code_start;
 }
 
+void EE_JIT64::request_compile(EmotionEngine& ee)
+{
+    uint32_t pc = ee.get_PC();
+    if (worker.is_pending(pc))
+        return;
+
+    EE_JitCompileRequest request;
+    request.ee = &ee;
+    request.pc = pc;
+    request.generation = jit_heap.get_generation(pc);
+    request.block = ir.translate(ee);
+    request.stats = jit_heap.get_block_stats(pc);
+    worker.request(std::move(request));
+}
+
+void EE_JIT64::install_compiled_blocks()
+{
+    EE_JitCompileResult result;
+    while (worker.pop_result(result))
+    {
+        //The page was invalidated or the cache flushed while this was compiling, so the code may be stale
+        if (result.generation != jit_heap.get_generation(result.pc))
+        {
+            discarded_compiles++;
+            continue;
+        }
+
+        if (jit_heap.find_block(result.pc))
+            continue;
+
+        std::size_t code_size = result.code.size() - result.literal_size;
+        EEJitBlockRecord* record = jit_heap.insert_code(result.pc, result.code.data(), result.literal_size, code_size);
+        JitSymbols::add_block(record->code_start, record->code_end, "EE_%08X", result.pc);
+
+        EEJitBlockStats* stats = jit_heap.get_block_stats(result.pc);
+        if (stats)
+        {
+            stats->compile_ns += result.compile_ns;
+            stats->compiles++;
+            stats->guest_instrs = result.guest_instrs;
+            stats->host_size = code_size;
+        }
+    }
+}
+
+void EE_JIT64::compile_detached(EmotionEngine& ee, IR::Block& block, uint32_t pc, EEJitBlockStats* stats,
+                                std::vector<uint8_t>& code, std::size_t& literal_size)
+{
+    optimizer.optimize(block);
+    emit_block(ee, block, pc, stats);
+
+    uint8_t* literals_start = jit_block.get_literals_start();
+    literal_size = jit_block.get_code_start() - literals_start;
+    code.assign(literals_start, jit_block.get_code_pos());
+}
+
 uint16_t EE_JIT64::run(EmotionEngine& ee)
 {
+    if (background_compile)
+        install_compiled_blocks();
+
     prologue_block(*this, ee, &jit_heap.lookup_cache[0]);
 
     return cycle_count;
 }
 
+void EE_JIT64::set_pass_enabled(EE_JitPass pass, bool enabled)
+{
+    optimizer.set_pass_enabled(pass, enabled);
+
+    //The worker has its own copy of the optimizer, which can't be touched while it's running
+    if (background_compile)
+    {
+        worker.stop();
+        worker.start(optimizer);
+    }
+}
+
+void EE_JIT64::set_background_compile(bool enabled)
+{
+    background_compile = enabled;
+    if (enabled)
+        worker.start(optimizer);
+    else
+    {
+        worker.stop();
+        if (discarded_compiles)
+            printf("[EE_JIT64] %llu background compiles were discarded\n", (unsigned long long)discarded_compiles);
+    }
+}
+
+void EE_JIT64::print_pass_stats() const
+{
+    optimizer.print_stats();
+}
+
+void EE_JIT64::set_block_stats_enabled(bool enabled)
+{
+    //Execution counters are compiled into each block, so everything has to be recompiled
+    reset(true);
+    jit_heap.set_block_stats_enabled(enabled);
+}
+
+void EE_JIT64::print_block_report(int count)
+{
+    jit_heap.print_block_report(count);
+    if (background_compile)
+        printf("[EE_JIT64] Stale background compiles discarded: %llu\n", (unsigned long long)discarded_compiles);
+}
+
 EEJitPrologue EE_JIT64::create_prologue_block()
 {
     jit_block.clear();
@@ -133,11 +276,15 @@ EEJitPrologue EE_JIT64::create_prologue_block()
     emitter.MOV64_MR(REG_64::RDX, REG_64::R13);
 #endif
 
+    std::size_t dispatcher_offset = jit_block.get_code_pos() - jit_block.get_code_start();
     emit_dispatcher();
 
     //Reserve 0xFFFFFFFF as the PC.
     //Because this is an invalid address, it doesn't matter that the prologue block has this.
-    return (EEJitPrologue)jit_heap.insert_block(0xFFFFFFFF, &jit_block)->code_start;
+    EEJitBlockRecord* record = jit_heap.insert_block(0xFFFFFFFF, &jit_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "EE_prologue");
+    dispatcher_entry = (uint8_t*)record->code_start + dispatcher_offset;
+    return (EEJitPrologue)record->code_start;
 }
 
 void EE_JIT64::emit_dispatcher()
@@ -206,6 +353,16 @@ void EE_JIT64::emit_dispatcher()
 }
 
 EEJitBlockRecord* EE_JIT64::recompile_block(EmotionEngine& ee, IR::Block& block)
+{
+    uint32_t pc = ee.get_PC();
+    emit_block(ee, block, pc, jit_heap.get_block_stats(pc));
+
+    EEJitBlockRecord* record = jit_heap.insert_block(pc, &jit_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "EE_%08X", record->block_data.pc);
+    return record;
+}
+
+void EE_JIT64::emit_block(EmotionEngine& ee, IR::Block& block, uint32_t pc, EEJitBlockStats* stats)
 {
     cycles_added = 0;
     ee_branch = false;
@@ -227,18 +384,30 @@ EEJitBlockRecord* EE_JIT64::recompile_block(EmotionEngine& ee, IR::Block& block)
     // An extra 0x8 is needed so that functions we call can have a 16-byte aligned stack pointer.
     emitter.SUB64_REG_IMM(0x1B8, REG_64::RSP);
 
+    //No registers are allocated yet, so RCX is free to use
+    if (stats)
+    {
+        emitter.load_addr((uint64_t)&stats->executions, REG_64::RAX);
+        emitter.MOV64_FROM_MEM(REG_64::RAX, REG_64::RCX);
+        emitter.ADD64_REG_IMM(1, REG_64::RCX);
+        emitter.MOV64_TO_MEM(REG_64::RCX, REG_64::RAX);
+    }
+
+    // Liveness lets the allocator drop registers whose values are never read again instead of writing them back
+    EE_JitOptimizer::compute_liveness(block.get_instrs(), gpr_live, gpr_refs);
+    cur_instr = 0;
+
     while (block.get_instruction_count() > 0 && !likely_branch)
     {
         IR::Instruction instr = block.get_next_instr();
         emit_instruction(ee, instr);
+        cur_instr++;
     }
 
     if (likely_branch)
         handle_branch_likely(ee, block);
     else
         cleanup_recompiler(ee, true, true, block.get_cycle_count());
-
-    return jit_heap.insert_block(ee.get_PC(), &jit_block);
 }
 
 void EE_JIT64::emit_instruction(EmotionEngine &ee, IR::Instruction &instr)
@@ -875,9 +1044,11 @@ void EE_JIT64::call_abi_func(uint64_t addr)
 #ifdef _WIN32
     const static REG_64 saved_regs[] = { RCX, RDX, R8, R9, R10, R11 };
     const static REG_64 abi_regs[] = { RCX, RDX, R8, R9 };
+    const static REG_64 callee_saved_regs[] = { RBX, RBP, RDI, RSI, R12, R13, R14, R15 };
 #else
     const static REG_64 saved_regs[] = { RDI, RSI, RCX, RDX, R8, R9, R10, R11 };
     const static REG_64 abi_regs[] = { RDI, RSI, RDX, RCX, R8, R9 };
+    const static REG_64 callee_saved_regs[] = { RBX, RBP, R12, R13, R14, R15 };
 #endif    
 
     for (int i = 0; i < abi_int_count; ++i)
@@ -898,13 +1069,44 @@ void EE_JIT64::call_abi_func(uint64_t addr)
     // Store any volatile INT registers into the stack
     for (REG_64 reg : saved_regs)
     {
-        if (int_regs[reg].used /* && !int_regs[reg].stored*/)
+        if (!int_regs[reg].used /* || int_regs[reg].stored*/)
+            continue;
+
+        // EE GPRs the current instruction doesn't use don't have to come back in the same register.
+        // If the value is dead or still matches the EE state, drop it. If it's dirty, move it into a free
+        // callee-saved register so it stays resident across the call.
+        if (!int_regs[reg].locked && int_regs[reg].type == REG_TYPE::GPR && !is_int_reg_referenced(reg))
         {
-            // Note: The 0x20 here is the int register array offset noted in recompile_block
-            // TODO: Store 0x20 in some sort of constant
-            emitter.MOV64_TO_MEM(reg, REG_64::RSP, 0x20 + (int)reg * sizeof(uint64_t));
-            // int_regs[reg].stored = true;
+            if (is_int_reg_dead(reg) || !int_regs[reg].modified)
+            {
+                int_regs[reg].used = false;
+                continue;
+            }
+
+            int callee_reg = -1;
+            for (REG_64 candidate : callee_saved_regs)
+            {
+                if (!int_regs[candidate].locked && !int_regs[candidate].used)
+                {
+                    callee_reg = candidate;
+                    break;
+                }
+            }
+
+            if (callee_reg >= 0)
+            {
+                emitter.MOV64_MR(reg, (REG_64)callee_reg);
+                int_regs[callee_reg] = int_regs[reg];
+                int_regs[reg].used = false;
+                int_regs[reg].modified = false;
+                continue;
+            }
         }
+
+        // Note: The 0x20 here is the int register array offset noted in recompile_block
+        // TODO: Store 0x20 in some sort of constant
+        emitter.MOV64_TO_MEM(reg, REG_64::RSP, 0x20 + (int)reg * sizeof(uint64_t));
+        // int_regs[reg].stored = true;
     }
 
     // Call function
@@ -970,6 +1172,7 @@ int EE_JIT64::search_for_register_scratchpad(AllocReg *regs)
 
     int reg = -1;
     int age = 0;
+    int dead_reg = -1;
     for (int i = 0; i < 16; i++)
     {
         if (regs[i].locked)
@@ -978,12 +1181,19 @@ int EE_JIT64::search_for_register_scratchpad(AllocReg *regs)
         if (!regs[i].used)
             return i;
 
+        if (dead_reg < 0 && is_int_reg_dead(i))
+            dead_reg = i;
+
         if (regs[i].age > age)
         {
             reg = i;
             age = regs[i].age;
         }
     }
+
+    // A register holding a dead value can be taken without writing it back
+    if (dead_reg >= 0)
+        return dead_reg;
     return reg;
 }
 
@@ -1007,6 +1217,7 @@ int EE_JIT64::search_for_register_priority(AllocReg *regs)
 
     int reg = -1;
     int age = 0;
+    int dead_reg = -1;
     for (int i = 0; i < 16; i++)
     {
         if (regs[i].locked)
@@ -1015,12 +1226,19 @@ int EE_JIT64::search_for_register_priority(AllocReg *regs)
         if (!regs[i].used)
             return i;
 
+        if (dead_reg < 0 && is_int_reg_dead(i))
+            dead_reg = i;
+
         if (regs[i].age > age)
         {
             reg = i;
             age = regs[i].age;
         }
     }
+
+    // A register holding a dead value can be taken without writing it back
+    if (dead_reg >= 0)
+        return dead_reg;
     return reg;
 }
 
@@ -1045,6 +1263,27 @@ int EE_JIT64::search_for_register_xmm(AllocReg *regs)
     return reg;
 }
 
+bool EE_JIT64::is_int_reg_dead(int reg) const
+{
+    // Only EE GPRs are tracked. Anything else, or any point past the end of the block, counts as live.
+    const AllocReg& alloc = int_regs[reg];
+    if (!alloc.used || alloc.type != REG_TYPE::GPR || alloc.reg <= 0 || alloc.reg >= 32)
+        return false;
+    if (cur_instr >= gpr_live.size())
+        return false;
+    return !(gpr_live[cur_instr] & (1u << alloc.reg));
+}
+
+bool EE_JIT64::is_int_reg_referenced(int reg) const
+{
+    const AllocReg& alloc = int_regs[reg];
+    if (alloc.type != REG_TYPE::GPR || alloc.reg < 0 || alloc.reg >= 32)
+        return true;
+    if (cur_instr >= gpr_refs.size())
+        return true;
+    return (gpr_refs[cur_instr] & (1u << alloc.reg)) != 0;
+}
+
 REG_64 EE_JIT64::alloc_reg(EmotionEngine& ee, int reg, REG_TYPE type, REG_STATE state, REG_64 destination)
 {
     // An explicit destination is not provided, so we find one ourselves here.
@@ -1122,7 +1361,8 @@ REG_64 EE_JIT64::alloc_reg(EmotionEngine& ee, int reg, REG_TYPE type, REG_STATE
     switch (type)
     {
         case REG_TYPE::INTSCRATCHPAD:
-            flush_int_reg(ee, destination);
+            if (!is_int_reg_dead(destination))
+                flush_int_reg(ee, destination);
             int_regs[destination].modified = false;
             int_regs[destination].used = true;
             int_regs[destination].age = 0;
@@ -1168,8 +1408,9 @@ REG_64 EE_JIT64::alloc_reg(EmotionEngine& ee, int reg, REG_TYPE type, REG_STATE
                 }
             }
 
-            // Flush new register's contents back to EE state
-            flush_int_reg(ee, destination);
+            // Flush new register's contents back to EE state, unless they're overwritten before being read again
+            if (!is_int_reg_dead(destination))
+                flush_int_reg(ee, destination);
             int_regs[destination].used = false;
 
             if (state != REG_STATE::WRITE)
@@ -1618,7 +1859,10 @@ void EE_JIT64::handle_branch_likely(EmotionEngine& ee, IR::Block& block)
 
     // execute delay slot and flush EE state back to EE
     for (IR::Instruction instr = block.get_next_instr(); instr.op != IR::Opcode::Null; instr = block.get_next_instr())
+    {
         emit_instruction(ee, instr);
+        cur_instr++;
+    }
     cleanup_recompiler(ee, true, true, block.get_cycle_count());
 }
 
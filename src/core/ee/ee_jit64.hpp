@@ -2,7 +2,9 @@
 #define EE_JIT64_HPP
 #include "../jitcommon/emitter64.hpp"
 #include "../jitcommon/ir_block.hpp"
+#include "ee_jitopt.hpp"
 #include "ee_jittrans.hpp"
+#include "ee_jitworker.hpp"
 #include "emotion.hpp"
 #include "vu.hpp"
 #include <stack>
@@ -74,6 +76,7 @@ private:
     EEJitHeap jit_heap;
     Emitter64 emitter;
     EE_JitTranslator ir;
+    EE_JitOptimizer optimizer;
 
     int sp_offset;
     std::vector<REG_64> saved_int_regs;
@@ -85,16 +88,30 @@ private:
     uint32_t ee_branch_dest, ee_branch_fail_dest;
     uint32_t ee_branch_delay_dest, ee_branch_delay_fail_dest;
     uint16_t cycle_count;
-    uint32_t saved_mxcsr;
-    uint32_t ee_mxcsr;
+
+    //Shared so blocks compiled by the background worker's instance refer to the same state
+    static uint32_t saved_mxcsr;
+    static uint32_t ee_mxcsr;
     // Cycles added to the cycle count in the middle of the block, e.g. UpdateVU0
     uint64_t cycles_added;
 
     bool should_update_mac;
 
+    // GPR liveness of the block being recompiled, indexed by instruction (see EE_JitOptimizer::compute_liveness)
+    std::vector<uint32_t> gpr_live;
+    std::vector<uint32_t> gpr_refs;
+    size_t cur_instr;
+
     //Pointer to the dispatcher prologue that begins execution of recompiled code
     EEJitPrologue prologue_block;
 
+    //Dispatcher inside the prologue block, for returning to after interpreting a block
+    uint8_t* dispatcher_entry;
+
+    bool background_compile;
+    EE_JitWorker worker;
+    uint64_t discarded_compiles;
+
     void handle_branch_likely(EmotionEngine& ee, IR::Block& block);
 
     // Instructions
@@ -291,6 +308,8 @@ private:
     int search_for_register_priority(AllocReg *regs);
     int search_for_register_scratchpad(AllocReg *regs);
     int search_for_register_xmm(AllocReg *regs);
+    bool is_int_reg_dead(int reg) const;
+    bool is_int_reg_referenced(int reg) const;
     REG_64 alloc_reg(EmotionEngine& ee, int reg, REG_TYPE type, REG_STATE state, REG_64 destination = (REG_64)-1);
     REG_64 lalloc_int_reg(EmotionEngine& ee, int reg, REG_TYPE type, REG_STATE state, REG_64 destination = (REG_64)-1);
     REG_64 lalloc_xmm_reg(EmotionEngine& ee, int reg, REG_TYPE type, REG_STATE state, REG_64 destination = (REG_64)-1);
@@ -315,6 +334,11 @@ private:
     void emit_dispatcher();
     void emit_instruction(EmotionEngine &ee, IR::Instruction &instr);
     EEJitBlockRecord* recompile_block(EmotionEngine& ee, IR::Block& block);
+    void emit_block(EmotionEngine& ee, IR::Block& block, uint32_t pc, EEJitBlockStats* stats);
+    void compile_detached(EmotionEngine& ee, IR::Block& block, uint32_t pc, EEJitBlockStats* stats,
+                          std::vector<uint8_t>& code, std::size_t& literal_size);
+    void request_compile(EmotionEngine& ee);
+    void install_compiled_blocks();
     void cleanup_recompiler(EmotionEngine& ee, bool clear_regs, bool dispatcher, uint64_t cycles);
     void emit_epilogue();
 public:
@@ -323,7 +347,14 @@ public:
     void reset(bool clear_cache = true);
     uint16_t run(EmotionEngine& ee);
 
+    void set_pass_enabled(EE_JitPass pass, bool enabled);
+    void print_pass_stats() const;
+    void set_block_stats_enabled(bool enabled);
+    void print_block_report(int count);
+    void set_background_compile(bool enabled);
+
     friend uint8_t* exec_block_ee(EE_JIT64& jit, EmotionEngine& ee);
+    friend class EE_JitWorker;
 };
 
 // Various wrapper functions
@@ -0,0 +1,736 @@
+#include <cstdio>
+#include "ee_jitopt.hpp"
+
+namespace
+{
+
+enum class OpClass
+{
+    Pure,       //Writes dest from GPR sources only, no side effects. Removable if dest is dead.
+    Load,       //Reads a base GPR and memory, writes dest
+    Store,      //Reads a base GPR and a value GPR, writes memory
+    Branch,     //Ends the block, may write $ra
+    Neutral,    //Touches neither GPRs nor memory
+    Barrier     //Anything else: assumed to read/write every GPR and all of memory
+};
+
+struct OpInfo
+{
+    OpClass type;
+    uint32_t reads;
+    uint32_t writes;
+};
+
+const int REG_SP = 29;
+const int REG_RA = 31;
+
+uint32_t gpr_bit(uint64_t reg)
+{
+    return (reg < 32) ? (1u << reg) : 0;
+}
+
+OpInfo make_info(OpClass type, uint32_t reads, uint32_t writes)
+{
+    OpInfo info;
+    info.type = type;
+    info.reads = reads;
+    info.writes = writes;
+    return info;
+}
+
+OpInfo get_op_info(const IR::Instruction& instr)
+{
+    const OpInfo barrier = make_info(OpClass::Barrier, 0xFFFFFFFF, 0xFFFFFFFF);
+    uint64_t dest = (uint64_t)instr.get_dest();
+    uint64_t source = instr.get_source();
+    uint64_t source2 = instr.get_source2();
+    uint32_t link = instr.get_is_link() ? gpr_bit(REG_RA) : 0;
+
+    switch (instr.op)
+    {
+        case IR::Opcode::LoadConst:
+        case IR::Opcode::ClearDoublewordReg:
+        case IR::Opcode::ClearWordReg:
+            if (!dest || dest >= 32)
+                return barrier;
+            return make_info(OpClass::Pure, 0, gpr_bit(dest));
+        case IR::Opcode::MoveDoublewordReg:
+        case IR::Opcode::MoveWordReg:
+        case IR::Opcode::AddWordImm:
+        case IR::Opcode::AddDoublewordImm:
+        case IR::Opcode::AndImm:
+        case IR::Opcode::OrImm:
+        case IR::Opcode::XorImm:
+        case IR::Opcode::ShiftLeftLogical:
+        case IR::Opcode::ShiftRightArithmetic:
+        case IR::Opcode::ShiftRightLogical:
+        case IR::Opcode::DoublewordShiftLeftLogical:
+        case IR::Opcode::DoublewordShiftRightArithmetic:
+        case IR::Opcode::DoublewordShiftRightLogical:
+        case IR::Opcode::SetOnLessThanImmediate:
+        case IR::Opcode::SetOnLessThanImmediateUnsigned:
+        case IR::Opcode::NegateWordReg:
+        case IR::Opcode::NegateDoublewordReg:
+            if (!dest || dest >= 32 || source >= 32)
+                return barrier;
+            return make_info(OpClass::Pure, gpr_bit(source), gpr_bit(dest));
+        case IR::Opcode::AddWordReg:
+        case IR::Opcode::AddDoublewordReg:
+        case IR::Opcode::SubWordReg:
+        case IR::Opcode::SubDoublewordReg:
+        case IR::Opcode::AndReg:
+        case IR::Opcode::OrReg:
+        case IR::Opcode::XorReg:
+        case IR::Opcode::NorReg:
+        case IR::Opcode::SetOnLessThan:
+        case IR::Opcode::SetOnLessThanUnsigned:
+            if (!dest || dest >= 32 || source >= 32 || source2 >= 32)
+                return barrier;
+            return make_info(OpClass::Pure, gpr_bit(source) | gpr_bit(source2), gpr_bit(dest));
+        case IR::Opcode::LoadByte:
+        case IR::Opcode::LoadByteUnsigned:
+        case IR::Opcode::LoadHalfword:
+        case IR::Opcode::LoadHalfwordUnsigned:
+        case IR::Opcode::LoadWord:
+        case IR::Opcode::LoadWordUnsigned:
+        case IR::Opcode::LoadDoubleword:
+        case IR::Opcode::LoadQuadword:
+            if (!dest || dest >= 32 || source >= 32)
+                return barrier;
+            return make_info(OpClass::Load, gpr_bit(source), gpr_bit(dest));
+        case IR::Opcode::LoadWordLeft:
+        case IR::Opcode::LoadWordRight:
+        case IR::Opcode::LoadDoublewordLeft:
+        case IR::Opcode::LoadDoublewordRight:
+            if (!dest || dest >= 32 || source >= 32)
+                return barrier;
+            return make_info(OpClass::Load, gpr_bit(source) | gpr_bit(dest), gpr_bit(dest));
+        case IR::Opcode::StoreByte:
+        case IR::Opcode::StoreHalfword:
+        case IR::Opcode::StoreWord:
+        case IR::Opcode::StoreWordLeft:
+        case IR::Opcode::StoreWordRight:
+        case IR::Opcode::StoreDoubleword:
+        case IR::Opcode::StoreDoublewordLeft:
+        case IR::Opcode::StoreDoublewordRight:
+        case IR::Opcode::StoreQuadword:
+            //Stores use dest as the base register and source as the value
+            if (dest >= 32 || source >= 32)
+                return barrier;
+            return make_info(OpClass::Store, gpr_bit(dest) | gpr_bit(source), 0);
+        case IR::Opcode::BranchEqual:
+        case IR::Opcode::BranchNotEqual:
+            return make_info(OpClass::Branch, gpr_bit(source) | gpr_bit(source2), link);
+        case IR::Opcode::BranchEqualZero:
+        case IR::Opcode::BranchNotEqualZero:
+        case IR::Opcode::BranchLessThanZero:
+        case IR::Opcode::BranchGreaterThanZero:
+        case IR::Opcode::BranchLessThanOrEqualZero:
+        case IR::Opcode::BranchGreaterThanOrEqualZero:
+        case IR::Opcode::JumpIndirect:
+            return make_info(OpClass::Branch, gpr_bit(source), link);
+        case IR::Opcode::Jump:
+            return make_info(OpClass::Branch, 0, link);
+        case IR::Opcode::Nop:
+        case IR::Opcode::FloatingPointAbsoluteValue:
+        case IR::Opcode::FloatingPointNegate:
+        case IR::Opcode::FloatingPointMaximum:
+        case IR::Opcode::FloatingPointMinimum:
+        case IR::Opcode::FloatingPointSquareRoot:
+        case IR::Opcode::FloatingPointReciprocalSquareRoot:
+        case IR::Opcode::FloatingPointAdd:
+        case IR::Opcode::FloatingPointMultiply:
+        case IR::Opcode::FloatingPointMultiplyAdd:
+        case IR::Opcode::FloatingPointMultiplySubtract:
+        case IR::Opcode::FloatingPointSubtract:
+        case IR::Opcode::FloatingPointDivide:
+        case IR::Opcode::FloatingPointCompareEqual:
+        case IR::Opcode::FloatingPointCompareLessThan:
+        case IR::Opcode::FloatingPointCompareLessThanOrEqual:
+        case IR::Opcode::FloatingPointConvertToFixedPoint:
+        case IR::Opcode::FixedPointConvertToFloatingPoint:
+            return make_info(OpClass::Neutral, 0, 0);
+        default:
+            return barrier;
+    }
+}
+
+int64_t sign_extend_word(uint64_t value)
+{
+    return (int64_t)(int32_t)(uint32_t)value;
+}
+
+//Computes the result of a Pure op given its source values, matching the code EE_JIT64 emits for it
+uint64_t evaluate_pure(const IR::Instruction& instr, uint64_t a, uint64_t b)
+{
+    uint64_t imm = instr.get_source2();
+    switch (instr.op)
+    {
+        case IR::Opcode::LoadConst:
+            return instr.get_source();
+        case IR::Opcode::ClearDoublewordReg:
+        case IR::Opcode::ClearWordReg:
+            return 0;
+        case IR::Opcode::MoveDoublewordReg:
+            return a;
+        case IR::Opcode::MoveWordReg:
+            return (uint32_t)a;
+        case IR::Opcode::AddWordImm:
+            return sign_extend_word(a + imm);
+        case IR::Opcode::AddDoublewordImm:
+            return a + imm;
+        case IR::Opcode::AndImm:
+            return a & (uint16_t)imm;
+        case IR::Opcode::OrImm:
+            return a | (uint16_t)imm;
+        case IR::Opcode::XorImm:
+            return a ^ (uint16_t)imm;
+        case IR::Opcode::ShiftLeftLogical:
+            return sign_extend_word((uint32_t)a << (imm & 0x1F));
+        case IR::Opcode::ShiftRightArithmetic:
+            return sign_extend_word((uint32_t)((int32_t)a >> (imm & 0x1F)));
+        case IR::Opcode::ShiftRightLogical:
+            return sign_extend_word((uint32_t)a >> (imm & 0x1F));
+        case IR::Opcode::DoublewordShiftLeftLogical:
+            return a << (imm & 0x3F);
+        case IR::Opcode::DoublewordShiftRightArithmetic:
+            return (uint64_t)((int64_t)a >> (imm & 0x3F));
+        case IR::Opcode::DoublewordShiftRightLogical:
+            return a >> (imm & 0x3F);
+        case IR::Opcode::SetOnLessThanImmediate:
+            return (int64_t)a < (int64_t)imm;
+        case IR::Opcode::SetOnLessThanImmediateUnsigned:
+            return a < imm;
+        case IR::Opcode::NegateWordReg:
+            return (uint32_t)(0 - (uint32_t)a);
+        case IR::Opcode::NegateDoublewordReg:
+            return 0 - a;
+        case IR::Opcode::AddWordReg:
+            return sign_extend_word(a + b);
+        case IR::Opcode::AddDoublewordReg:
+            return a + b;
+        case IR::Opcode::SubWordReg:
+            return sign_extend_word(a - b);
+        case IR::Opcode::SubDoublewordReg:
+            return a - b;
+        case IR::Opcode::AndReg:
+            return a & b;
+        case IR::Opcode::OrReg:
+            return a | b;
+        case IR::Opcode::XorReg:
+            return a ^ b;
+        case IR::Opcode::NorReg:
+            return ~(a | b);
+        case IR::Opcode::SetOnLessThan:
+            return (int64_t)a < (int64_t)b;
+        case IR::Opcode::SetOnLessThanUnsigned:
+            return a < b;
+        default:
+            return 0;
+    }
+}
+
+bool has_register_source2(IR::Opcode op)
+{
+    switch (op)
+    {
+        case IR::Opcode::AddWordReg:
+        case IR::Opcode::AddDoublewordReg:
+        case IR::Opcode::SubWordReg:
+        case IR::Opcode::SubDoublewordReg:
+        case IR::Opcode::AndReg:
+        case IR::Opcode::OrReg:
+        case IR::Opcode::XorReg:
+        case IR::Opcode::NorReg:
+        case IR::Opcode::SetOnLessThan:
+        case IR::Opcode::SetOnLessThanUnsigned:
+            return true;
+        default:
+            return false;
+    }
+}
+
+//Tracks which GPRs hold values known at translation time. $zero is always known.
+struct ConstState
+{
+    uint32_t known;
+    uint64_t value[32];
+
+    ConstState()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        known = 1;
+        value[0] = 0;
+    }
+
+    bool all_known(uint32_t regs) const
+    {
+        return (known & regs) == regs;
+    }
+
+    //Returns true and the result if instr is a Pure op whose sources are all known
+    bool try_fold(const IR::Instruction& instr, const OpInfo& info, uint64_t& result) const
+    {
+        if (info.type != OpClass::Pure || !all_known(info.reads))
+            return false;
+
+        uint64_t a = (instr.op == IR::Opcode::LoadConst) ? 0 : value[instr.get_source() & 0x1F];
+        uint64_t b = has_register_source2(instr.op) ? value[instr.get_source2() & 0x1F] : 0;
+        result = evaluate_pure(instr, a, b);
+        return true;
+    }
+
+    void update(const IR::Instruction& instr, const OpInfo& info)
+    {
+        uint64_t result;
+        if (info.type == OpClass::Barrier)
+        {
+            reset();
+            return;
+        }
+
+        if (try_fold(instr, info, result))
+        {
+            int dest = instr.get_dest();
+            known |= 1u << dest;
+            value[dest] = result;
+            return;
+        }
+
+        known &= ~info.writes;
+        known |= 1;
+    }
+};
+
+struct StackSlot
+{
+    int64_t offset;
+    int size;
+    int reg;
+};
+
+bool ranges_overlap(int64_t a, int size_a, int64_t b, int size_b)
+{
+    return a < b + size_b && b < a + size_a;
+}
+
+const char* pass_name(int pass)
+{
+    switch ((EE_JitPass)pass)
+    {
+        case EE_JitPass::ConstantFolding:
+            return "Constant folding";
+        case EE_JitPass::BranchFolding:
+            return "Branch folding";
+        case EE_JitPass::LoadStoreForwarding:
+            return "Load/store forwarding";
+        case EE_JitPass::DeadStoreElimination:
+            return "Dead store elimination";
+        default:
+            return "?";
+    }
+}
+
+};
+
+EE_JitOptimizer::EE_JitOptimizer()
+{
+    for (int i = 0; i < PASS_COUNT; i++)
+        pass_enabled[i] = true;
+    reset_stats();
+}
+
+void EE_JitOptimizer::optimize(IR::Block &block)
+{
+    std::vector<IR::Instruction>& instrs = block.get_instrs();
+
+    //Forwarding runs first so that the moves it creates can be folded, and dead store elimination
+    //runs last to clean up the partial constants left behind by folding (e.g. the LUI of a LUI/ORI pair)
+    const EE_JitPass order[] =
+    {
+        EE_JitPass::LoadStoreForwarding,
+        EE_JitPass::ConstantFolding,
+        EE_JitPass::BranchFolding,
+        EE_JitPass::DeadStoreElimination
+    };
+
+    for (EE_JitPass pass : order)
+    {
+        int index = (int)pass;
+        if (!pass_enabled[index])
+            continue;
+
+        EE_JitPassStats& stat = stats[index];
+        stat.blocks++;
+        stat.instrs_seen += instrs.size();
+
+        switch (pass)
+        {
+            case EE_JitPass::ConstantFolding:
+                constant_folding(instrs, stat);
+                break;
+            case EE_JitPass::BranchFolding:
+                branch_folding(instrs, stat);
+                break;
+            case EE_JitPass::LoadStoreForwarding:
+                load_store_forwarding(instrs, stat);
+                break;
+            case EE_JitPass::DeadStoreElimination:
+                dead_store_elimination(instrs, stat);
+                break;
+            default:
+                break;
+        }
+
+        //EE_JIT64 treats a Null op as the end of a likely branch's delay slot, so none may remain
+        remove_null_instrs(instrs, stat);
+    }
+}
+
+void EE_JitOptimizer::constant_folding(std::vector<IR::Instruction> &instrs, EE_JitPassStats &stat)
+{
+    ConstState state;
+
+    for (IR::Instruction& instr : instrs)
+    {
+        OpInfo info = get_op_info(instr);
+        uint64_t result;
+
+        if (instr.op != IR::Opcode::LoadConst && state.try_fold(instr, info, result))
+        {
+            int dest = instr.get_dest();
+            instr.op = IR::Opcode::LoadConst;
+            instr.set_dest(dest);
+            instr.set_source(result);
+            stat.instrs_rewritten++;
+        }
+
+        state.update(instr, info);
+    }
+}
+
+void EE_JitOptimizer::branch_folding(std::vector<IR::Instruction> &instrs, EE_JitPassStats &stat)
+{
+    ConstState state;
+
+    for (unsigned int i = 0; i < instrs.size(); i++)
+    {
+        IR::Instruction& instr = instrs[i];
+        OpInfo info = get_op_info(instr);
+
+        if (info.type != OpClass::Branch || instr.op == IR::Opcode::Jump || !state.all_known(info.reads))
+        {
+            state.update(instr, info);
+            continue;
+        }
+
+        int64_t a = (int64_t)state.value[instr.get_source() & 0x1F];
+        int64_t b = (instr.op == IR::Opcode::BranchEqual || instr.op == IR::Opcode::BranchNotEqual) ?
+                    (int64_t)state.value[instr.get_source2() & 0x1F] : 0;
+        uint32_t dest = instr.get_jump_dest();
+        bool taken;
+
+        switch (instr.op)
+        {
+            case IR::Opcode::BranchEqual:
+            case IR::Opcode::BranchEqualZero:
+                taken = a == b;
+                break;
+            case IR::Opcode::BranchNotEqual:
+            case IR::Opcode::BranchNotEqualZero:
+                taken = a != b;
+                break;
+            case IR::Opcode::BranchLessThanZero:
+                taken = a < 0;
+                break;
+            case IR::Opcode::BranchGreaterThanZero:
+                taken = a > 0;
+                break;
+            case IR::Opcode::BranchLessThanOrEqualZero:
+                taken = a <= 0;
+                break;
+            case IR::Opcode::BranchGreaterThanOrEqualZero:
+                taken = a >= 0;
+                break;
+            case IR::Opcode::JumpIndirect:
+                taken = true;
+                dest = (uint32_t)a;
+                break;
+            default:
+                return;
+        }
+
+        //A not-taken likely branch nullifies its delay slot, which is everything after it in the block
+        if (!taken && instr.get_is_likely())
+        {
+            for (unsigned int j = i + 1; j < instrs.size(); j++)
+                instrs[j].op = IR::Opcode::Null;
+        }
+
+        //Links happen regardless of the outcome, and Jump handles them the same way
+        instr.op = IR::Opcode::Jump;
+        instr.set_jump_dest(taken ? dest : instr.get_jump_fail_dest());
+        instr.set_is_likely(false);
+        stat.instrs_rewritten++;
+        return;
+    }
+}
+
+void EE_JitOptimizer::load_store_forwarding(std::vector<IR::Instruction> &instrs, EE_JitPassStats &stat)
+{
+    //Only stack accesses are forwarded. Any other base register may point at an I/O register where
+    //reads have side effects or don't return the last value written.
+    std::vector<StackSlot> slots;
+
+    for (IR::Instruction& instr : instrs)
+    {
+        OpInfo info = get_op_info(instr);
+
+        if (info.type == OpClass::Barrier)
+        {
+            slots.clear();
+            continue;
+        }
+
+        if (info.type == OpClass::Store)
+        {
+            int64_t offset = (int64_t)instr.get_source2();
+            int size = 0;
+            switch (instr.op)
+            {
+                case IR::Opcode::StoreByte:
+                    size = 1;
+                    break;
+                case IR::Opcode::StoreHalfword:
+                    size = 2;
+                    break;
+                case IR::Opcode::StoreWord:
+                    size = 4;
+                    break;
+                case IR::Opcode::StoreDoubleword:
+                    size = 8;
+                    break;
+                default:
+                    break;
+            }
+
+            //Unaligned and quadword stores cover an area that depends on the runtime value of $sp
+            if (instr.get_dest() != REG_SP || !size)
+            {
+                slots.clear();
+                continue;
+            }
+
+            for (auto it = slots.begin(); it != slots.end(); )
+            {
+                if (ranges_overlap(it->offset, it->size, offset, size))
+                    it = slots.erase(it);
+                else
+                    ++it;
+            }
+
+            if (size >= 4)
+                slots.push_back({offset, size, (int)instr.get_source()});
+            continue;
+        }
+
+        bool is_word = instr.op == IR::Opcode::LoadWord;
+        bool is_doubleword = instr.op == IR::Opcode::LoadDoubleword;
+        if (info.type == OpClass::Load && instr.get_source() == REG_SP && (is_word || is_doubleword))
+        {
+            int64_t offset = (int64_t)instr.get_source2();
+            int size = is_word ? 4 : 8;
+            int dest = instr.get_dest();
+
+            for (StackSlot& slot : slots)
+            {
+                bool low_half = slot.offset == offset && (slot.size == size || (is_word && slot.size == 8));
+                bool high_half = is_word && slot.size == 8 && offset == slot.offset + 4;
+                if (!low_half && !high_half)
+                    continue;
+
+                if (!slot.reg)
+                {
+                    instr.op = IR::Opcode::LoadConst;
+                    instr.set_source(0);
+                }
+                else if (high_half)
+                {
+                    instr.op = IR::Opcode::DoublewordShiftRightArithmetic;
+                    instr.set_source(slot.reg);
+                    instr.set_source2(32);
+                }
+                else if (is_word)
+                {
+                    instr.op = IR::Opcode::AddWordImm;
+                    instr.set_source(slot.reg);
+                    instr.set_source2(0);
+                }
+                else if (slot.reg == dest)
+                {
+                    instr.op = IR::Opcode::Null;
+                }
+                else
+                {
+                    instr.op = IR::Opcode::MoveDoublewordReg;
+                    instr.set_source(slot.reg);
+                }
+                stat.instrs_rewritten++;
+                break;
+            }
+
+            if (dest == REG_SP)
+            {
+                slots.clear();
+                continue;
+            }
+
+            for (auto it = slots.begin(); it != slots.end(); )
+            {
+                if (it->reg == dest)
+                    it = slots.erase(it);
+                else
+                    ++it;
+            }
+
+            //The loaded register now mirrors the slot, so a later reload can be forwarded from it
+            slots.push_back({offset, size, dest});
+            continue;
+        }
+
+        if (info.writes & gpr_bit(REG_SP))
+        {
+            slots.clear();
+            continue;
+        }
+
+        for (auto it = slots.begin(); it != slots.end(); )
+        {
+            if (info.writes & gpr_bit(it->reg))
+                it = slots.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+void EE_JitOptimizer::dead_store_elimination(std::vector<IR::Instruction> &instrs, EE_JitPassStats &stat)
+{
+    //Every GPR is live out of the block, and branches are treated as fully live too: the delay slot
+    //of a likely branch only executes conditionally, so it can't be used to kill earlier writes.
+    uint32_t live = 0xFFFFFFFF;
+
+    for (int i = (int)instrs.size() - 1; i >= 0; i--)
+    {
+        IR::Instruction& instr = instrs[i];
+        OpInfo info = get_op_info(instr);
+
+        switch (info.type)
+        {
+            case OpClass::Barrier:
+            case OpClass::Branch:
+                live = 0xFFFFFFFF;
+                break;
+            case OpClass::Pure:
+                if (!(live & info.writes))
+                {
+                    instr.op = IR::Opcode::Null;
+                    break;
+                }
+                live = (live & ~info.writes) | info.reads;
+                break;
+            case OpClass::Load:
+                live = (live & ~info.writes) | info.reads;
+                break;
+            case OpClass::Store:
+                live |= info.reads;
+                break;
+            case OpClass::Neutral:
+                break;
+        }
+    }
+}
+
+void EE_JitOptimizer::remove_null_instrs(std::vector<IR::Instruction> &instrs, EE_JitPassStats &stat)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < instrs.size(); i++)
+    {
+        if (instrs[i].op == IR::Opcode::Null)
+            continue;
+        if (out != i)
+            instrs[out] = instrs[i];
+        out++;
+    }
+
+    stat.instrs_removed += instrs.size() - out;
+    instrs.resize(out);
+}
+
+void EE_JitOptimizer::compute_liveness(const std::vector<IR::Instruction> &instrs,
+                                       std::vector<uint32_t> &live, std::vector<uint32_t> &refs)
+{
+    live.resize(instrs.size());
+    refs.resize(instrs.size());
+
+    //Same rules as dead store elimination: everything is live out of the block and across any op that
+    //isn't modelled, as those may exit the block early or touch the EE state through memory.
+    uint32_t live_after = 0xFFFFFFFF;
+
+    for (int i = (int)instrs.size() - 1; i >= 0; i--)
+    {
+        OpInfo info = get_op_info(instrs[i]);
+
+        switch (info.type)
+        {
+            case OpClass::Barrier:
+            case OpClass::Branch:
+                refs[i] = 0xFFFFFFFF;
+                live[i] = 0xFFFFFFFF;
+                live_after = 0xFFFFFFFF;
+                break;
+            default:
+                refs[i] = info.reads | info.writes;
+                live[i] = live_after | refs[i];
+                live_after = (live_after & ~info.writes) | info.reads;
+                break;
+        }
+    }
+}
+
+void EE_JitOptimizer::set_pass_enabled(EE_JitPass pass, bool enabled)
+{
+    pass_enabled[(int)pass] = enabled;
+}
+
+bool EE_JitOptimizer::is_pass_enabled(EE_JitPass pass) const
+{
+    return pass_enabled[(int)pass];
+}
+
+const EE_JitPassStats& EE_JitOptimizer::get_stats(EE_JitPass pass) const
+{
+    return stats[(int)pass];
+}
+
+void EE_JitOptimizer::reset_stats()
+{
+    for (int i = 0; i < PASS_COUNT; i++)
+        stats[i] = {};
+}
+
+void EE_JitOptimizer::print_stats() const
+{
+    for (int i = 0; i < PASS_COUNT; i++)
+    {
+        const EE_JitPassStats& stat = stats[i];
+        printf("[EE_JIT64] %-24s %s: %llu blocks, %llu instrs, %llu rewritten, %llu removed\n",
+               pass_name(i), pass_enabled[i] ? "on " : "off",
+               (unsigned long long)stat.blocks, (unsigned long long)stat.instrs_seen,
+               (unsigned long long)stat.instrs_rewritten, (unsigned long long)stat.instrs_removed);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef EE_JITOPT_HPP
+#define EE_JITOPT_HPP
+#include <cstdint>
+#include <vector>
+#include "../jitcommon/ir_block.hpp"
+
+enum class EE_JitPass
+{
+    ConstantFolding,
+    BranchFolding,
+    LoadStoreForwarding,
+    DeadStoreElimination,
+    COUNT
+};
+
+struct EE_JitPassStats
+{
+    uint64_t blocks;
+    uint64_t instrs_seen;
+    uint64_t instrs_rewritten;
+    uint64_t instrs_removed;
+};
+
+/**
+  * Optimization passes run over an EE IR block after translation and before it is handed to EE_JIT64.
+  * Every pass is block-local and conservative: any IR op that isn't explicitly modelled below is
+  * treated as reading and writing every GPR and all of memory.
+  * Folded results mirror what EE_JIT64 emits for the original op, so a pass never changes behaviour.
+  */
+class EE_JitOptimizer
+{
+    private:
+        constexpr static int PASS_COUNT = (int)EE_JitPass::COUNT;
+
+        bool pass_enabled[PASS_COUNT];
+        EE_JitPassStats stats[PASS_COUNT];
+
+        void constant_folding(std::vector<IR::Instruction>& instrs, EE_JitPassStats& stat);
+        void branch_folding(std::vector<IR::Instruction>& instrs, EE_JitPassStats& stat);
+        void load_store_forwarding(std::vector<IR::Instruction>& instrs, EE_JitPassStats& stat);
+        void dead_store_elimination(std::vector<IR::Instruction>& instrs, EE_JitPassStats& stat);
+
+        static void remove_null_instrs(std::vector<IR::Instruction>& instrs, EE_JitPassStats& stat);
+    public:
+        EE_JitOptimizer();
+
+        void optimize(IR::Block& block);
+
+        void set_pass_enabled(EE_JitPass pass, bool enabled);
+        bool is_pass_enabled(EE_JitPass pass) const;
+        const EE_JitPassStats& get_stats(EE_JitPass pass) const;
+        void reset_stats();
+        void print_stats() const;
+
+        //For each instruction, live[i] holds the GPRs whose current value may still be read while or after
+        //it executes, and refs[i] the GPRs it accesses itself. Unmodelled ops reference every GPR.
+        static void compute_liveness(const std::vector<IR::Instruction>& instrs,
+                                     std::vector<uint32_t>& live, std::vector<uint32_t>& refs);
+};
+
+#endif // EE_JITOPT_HPP
@@ -113,6 +113,7 @@ IR::Block EE_JitTranslator::translate(EmotionEngine &ee)
 
 
     block.set_cycle_count(cycle_count);
+    block.set_guest_instruction_count(ops_translated);
 
     return block;
 }
@@ -0,0 +1,122 @@
+#include <chrono>
+
+#include "ee_jitworker.hpp"
+#include "ee_jit64.hpp"
+#include "../profiler.hpp"
+
+EE_JitWorker::EE_JitWorker() : quit(false)
+{
+
+}
+
+EE_JitWorker::~EE_JitWorker()
+{
+    stop();
+}
+
+void EE_JitWorker::start(const EE_JitOptimizer& optimizer)
+{
+    if (is_running())
+        return;
+
+    if (!compiler)
+    {
+        compiler.reset(new EE_JIT64);
+        compiler->reset(false);
+    }
+    compiler->optimizer = optimizer;
+    compiler->optimizer.reset_stats();
+
+    quit = false;
+    thread = std::thread(&EE_JitWorker::thread_loop, this);
+    printf("[EE_JIT64] Background compilation started\n");
+}
+
+void EE_JitWorker::stop()
+{
+    if (!is_running())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        quit = true;
+    }
+    queue_cond.notify_one();
+    thread.join();
+
+    cancel_all();
+}
+
+bool EE_JitWorker::is_running() const
+{
+    return thread.joinable();
+}
+
+bool EE_JitWorker::is_pending(uint32_t pc) const
+{
+    return pending.count(pc);
+}
+
+void EE_JitWorker::request(EE_JitCompileRequest&& request)
+{
+    pending.insert(request.pc);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        requests.push_back(std::move(request));
+    }
+    queue_cond.notify_one();
+}
+
+bool EE_JitWorker::pop_result(EE_JitCompileResult& result)
+{
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    if (results.empty())
+        return false;
+
+    result = std::move(results.front());
+    results.pop_front();
+    pending.erase(result.pc);
+    return true;
+}
+
+void EE_JitWorker::cancel_all()
+{
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    requests.clear();
+    results.clear();
+    pending.clear();
+}
+
+void EE_JitWorker::thread_loop()
+{
+    while (true)
+    {
+        EE_JitCompileRequest request;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cond.wait(lock, [this]() { return quit || !requests.empty(); });
+            if (quit)
+                return;
+
+            request = std::move(requests.front());
+            requests.pop_front();
+        }
+
+        uint64_t profile_start = Profiler::timestamp();
+        auto start = std::chrono::steady_clock::now();
+
+        EE_JitCompileResult result;
+        result.pc = request.pc;
+        result.generation = request.generation;
+        result.guest_instrs = request.block.get_guest_instruction_count();
+        compiler->compile_detached(*request.ee, request.block, request.pc, request.stats, result.code,
+                                   result.literal_size);
+
+        std::chrono::nanoseconds compile_time = std::chrono::steady_clock::now() - start;
+        result.compile_ns = compile_time.count();
+        Profiler::add_jit_compile(Profiler::JIT_EE, profile_start);
+
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        results.push_back(std::move(result));
+    }
+}
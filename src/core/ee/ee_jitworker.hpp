@@ -0,0 +1,79 @@
+#ifndef EE_JITWORKER_HPP
+#define EE_JITWORKER_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../jitcommon/ir_block.hpp"
+
+class EmotionEngine;
+class EE_JIT64;
+class EE_JitOptimizer;
+struct EEJitBlockStats;
+
+struct EE_JitCompileRequest
+{
+    EmotionEngine* ee;
+    uint32_t pc;
+    uint64_t generation;
+    IR::Block block;
+
+    //Only used for its address, the worker never touches the stats themselves
+    EEJitBlockStats* stats;
+};
+
+struct EE_JitCompileResult
+{
+    uint32_t pc;
+    uint64_t generation;
+    uint32_t guest_instrs;
+    uint64_t compile_ns;
+
+    //Literals followed by code, ready to be copied into the heap
+    std::vector<uint8_t> code;
+    std::size_t literal_size;
+};
+
+/**
+  * Compiles EE blocks on a separate thread.
+  * Translation stays on the emulation thread, since it reads guest memory; the worker only optimizes and emits
+  * with its own EE_JIT64. Results are picked up by the emulation thread, which checks their generation against
+  * the heap before installing them.
+  */
+class EE_JitWorker
+{
+    private:
+        std::unique_ptr<EE_JIT64> compiler;
+        std::thread thread;
+        std::mutex queue_mutex;
+        std::condition_variable queue_cond;
+        std::deque<EE_JitCompileRequest> requests;
+        std::deque<EE_JitCompileResult> results;
+        bool quit;
+
+        //Only touched by the emulation thread
+        std::unordered_set<uint32_t> pending;
+
+        void thread_loop();
+    public:
+        EE_JitWorker();
+        ~EE_JitWorker();
+
+        void start(const EE_JitOptimizer& optimizer);
+        void stop();
+        bool is_running() const;
+
+        bool is_pending(uint32_t pc) const;
+        void request(EE_JitCompileRequest&& request);
+        bool pop_result(EE_JitCompileResult& result);
+
+        //Drops queued requests and finished results. A block already being compiled still comes back later.
+        void cancel_all();
+};
+
+#endif // EE_JITWORKER_HPP
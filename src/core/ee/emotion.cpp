@@ -108,6 +108,7 @@ void EmotionEngine::reset()
     wait_for_VU0 = false;
     wait_for_interlock = false;
     delay_slot = 0;
+    decode_cache.reset();
 
     //OsdConfigParam is used by certain games to detect language settings.
     //This is not initialized until OSDSYS boots. Since fast boot skips this,
@@ -170,48 +171,69 @@ void EmotionEngine::run(int cycles)
     cp0->count_up(cycles);
 }
 
-void EmotionEngine::run_interpreter()
+inline void EmotionEngine::interpret_instr()
 {
-    while (cycles_to_run > 0)
-    {
-        cycles_to_run--;
-        cycle_count++;
+    cycles_to_run--;
+    cycle_count++;
 
-        uint32_t instruction = read_instr(PC);
-        uint32_t lastPC = PC;
+    uint32_t instruction = read_instr(PC);
+    uint32_t lastPC = PC;
 
-        if (can_disassemble)
-        {
-            std::string disasm = EmotionDisasm::disasm_instr(instruction, PC);
-            printf("[$%08X] $%08X - %s\n", PC, instruction, disasm.c_str());
-            //print_state();
-        }
+    if (can_disassemble)
+    {
+        std::string disasm = EmotionDisasm::disasm_instr(instruction, PC);
+        printf("[$%08X] $%08X - %s\n", PC, instruction, disasm.c_str());
+        //print_state();
+    }
 
-        EmotionInterpreter::interpret(*this, instruction);
-        set_PC(get_PC() + 4);
+    decode_cache.get(lastPC, instruction)(*this, instruction);
+    set_PC(get_PC() + 4);
 
-        //Simulate dual-issue if both instructions are NOPs
-        if (!instruction && !read32(PC))
-            set_PC(get_PC() + 4);
+    //Simulate dual-issue if both instructions are NOPs
+    if (!instruction && !read32(PC))
+        set_PC(get_PC() + 4);
 
-        if (branch_on)
+    if (branch_on)
+    {
+        if (!delay_slot)
         {
-            if (!delay_slot)
+            //If the PC == LastPC it means we've reversed it to handle COP2 sync, so don't branch yet
+            if (PC != lastPC)
             {
-                //If the PC == LastPC it means we've reversed it to handle COP2 sync, so don't branch yet
-                if (PC != lastPC)
+                branch_on = false;
+                if (!new_PC || (new_PC & 0x3))
                 {
-                    branch_on = false;
-                    if (!new_PC || (new_PC & 0x3))
-                    {
-                        Errors::die("[EE] Jump to invalid address $%08X from $%08X\n", new_PC, PC - 8);
-                    }
-                    set_PC(new_PC);
+                    Errors::die("[EE] Jump to invalid address $%08X from $%08X\n", new_PC, PC - 8);
                 }
+                set_PC(new_PC);
             }
-            else
-                delay_slot--;
         }
+        else
+            delay_slot--;
+    }
+}
+
+void EmotionEngine::run_interpreter()
+{
+    while (cycles_to_run > 0)
+        interpret_instr();
+}
+
+void EmotionEngine::interpret_block()
+{
+    //Runs straight-line code until control flow goes elsewhere or we're out of cycles.
+    //A pending branch is always finished first, as JIT blocks can't start inside a delay slot.
+    while (true)
+    {
+        uint32_t lastPC = PC;
+        interpret_instr();
+
+        if (branch_on)
+            continue;
+
+        bool sequential = PC == lastPC + 4 || PC == lastPC + 8;
+        if (!sequential || cycles_to_run <= 0)
+            break;
     }
 }
 
@@ -1210,6 +1232,6 @@ void EmotionEngine::cop2_updatevu0()
     else if (!vu0->is_interlocked())
     {
         uint64_t current_count = (get_cycle_count() - cop2_last_cycle);
-        vu0->run(current_count);
+        e->run_vu0(current_count);
     }
 }
@@ -5,6 +5,7 @@
 #include <functional>
 #include "cop0.hpp"
 #include "cop1.hpp"
+#include "ee_decodecache.hpp"
 
 #include "../int128.hpp"
 
@@ -84,6 +85,7 @@ class EmotionEngine
         uint32_t PC_now;
 
         EE_ICacheLine icache[128];
+        EE_DecodeCache decode_cache;
 
         bool wait_for_IRQ, wait_for_VU0, wait_for_interlock;
         bool branch_on;
@@ -97,6 +99,7 @@ class EmotionEngine
 
         std::function<void(EmotionEngine&)> run_func;
 
+        void interpret_instr();
         uint32_t get_paddr(uint32_t vaddr);
         void handle_exception(uint32_t new_addr, uint8_t code);
         void deci2call(uint32_t func, uint32_t param);
@@ -108,6 +111,7 @@ class EmotionEngine
         void init_tlb();
         void run(int cycles);
         void run_interpreter();
+        void interpret_block();
         void run_jit();
         uint64_t get_cycle_count();
         uint64_t get_cycle_count_goal();
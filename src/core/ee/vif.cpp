@@ -50,8 +50,7 @@ void VectorInterface::reset()
     else
         fifo_size = 32;
 
-    if(vu->get_id() == 1)
-        VU_JIT::reset();
+    VU_JIT::reset(vu->get_id());
 }
 
 bool VectorInterface::check_vif_stall(uint32_t value)
@@ -168,6 +168,7 @@ void VectorUnit::reset()
     running = false;
     tbit_stop = false;
     vumem_is_dirty = true; //assume we don't know the contents on reset
+    dirty_ranges = ~0ULL;
     finish_on = false;
     branch_on = false;
     second_branch_pending = false;
@@ -543,6 +544,38 @@ void VectorUnit::update_XGKick()
 
 void VectorUnit::run_jit(int cycles)
 {
+    //VU0 keeps pace with the EE rather than the cycles given, the same as in run()
+    if (!id)
+    {
+        if (!running)
+            return;
+
+        int cycles_to_run = (eecpu->get_cycle_count() - eecpu->get_cop2_last_cycle());
+        if (cycles_to_run <= 0)
+            return;
+        eecpu->set_cop2_last_cycle(eecpu->get_cop2_last_cycle() + cycles_to_run);
+
+        clear_interlock();
+
+        while (running && cycles_to_run > 0)
+        {
+            int block_cycles = VU_JIT::run(this);
+            cycle_count += block_cycles;
+            cycles_to_run -= block_cycles;
+
+            //Break out from the VU0 loop to give COP2 time to catch the interlock
+            if (is_interlocked() && check_interlock())
+                break;
+        }
+
+        if (!running)
+            cycle_count = eecpu->get_cop2_last_cycle();
+
+        if (cycles_to_run < 0)
+            eecpu->set_cop2_last_cycle(eecpu->get_cop2_last_cycle() + std::abs(cycles_to_run));
+        return;
+    }
+
     int runfor = 0;
     if (cycles > 0)
     {
@@ -817,10 +850,7 @@ void VectorUnit::disasm_micromem()
     uint32_t crc = crc_microprogram();
 
     //Set the current program crc to the VU JIT
-    if (get_id() == 1)
-    {
-        VU_JIT::set_current_program(crc);
-    }
+    VU_JIT::set_current_program(get_id(), crc);
 
     clear_dirty();
 
@@ -891,19 +921,69 @@ void VectorUnit::disasm_micromem()
 
 #define POLY 0x82f63b78
 
+namespace
+{
+
+//Slicing-by-8 tables for CRC32C, the same polynomial the bitwise version used
+struct CRC32CTable
+{
+    uint32_t t[8][256];
+
+    CRC32CTable()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; k++)
+                crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+            t[0][i] = crc;
+        }
+        for (int i = 0; i < 256; i++)
+        {
+            for (int j = 1; j < 8; j++)
+                t[j][i] = (t[j - 1][i] >> 8) ^ t[0][t[j - 1][i] & 0xFF];
+        }
+    }
+};
+
+const CRC32CTable crc32c_table;
+
+uint32_t crc32c(const uint8_t* data, size_t len)
+{
+    const uint32_t (*t)[256] = crc32c_table.t;
+    uint32_t crc = ~0U;
+
+    //len is always a multiple of 8 here
+    for (size_t i = 0; i < len; i += 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, data + i, sizeof(lo));
+        memcpy(&hi, data + i + 4, sizeof(hi));
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    return ~crc;
+}
+
+};
+
 uint32_t VectorUnit::crc_microprogram()
 {
-    uint32_t crc = 0;
     int len = (get_id()) ? 0x4000 : 0x1000;
-    int addr = 0x0000;
+    int ranges = len >> MICROPROGRAM_RANGE_SHIFT;
+    int range_size = 1 << MICROPROGRAM_RANGE_SHIFT;
 
-    crc = ~crc;
-    while (len--) {
-        crc ^= read_instr<uint8_t>(addr++);
-        for (int k = 0; k < 8; k++)
-            crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+    //Only rehash the ranges written to since the last call
+    for (int i = 0; i < ranges; i++)
+    {
+        if (dirty_ranges & (1ULL << i))
+            range_crcs[i] = crc32c(&instr_mem.m[i * range_size], range_size);
     }
-    return ~crc;
+    dirty_ranges = 0;
+
+    //The program is identified by the CRC of its range CRCs
+    return crc32c((uint8_t*)range_crcs, ranges * sizeof(uint32_t));
 }
 
 void VectorUnit::start_program(uint32_t addr)
@@ -912,9 +992,9 @@ void VectorUnit::start_program(uint32_t addr)
     //printf("[VU%d] CallMS Starting execution at $%08X! Cur PC %x\n", get_id(), new_addr, PC);
 
     //Enable this if disabling micromem disasm
-    if (get_id() == 1 && is_dirty())
+    if (is_dirty())
     {
-        VU_JIT::set_current_program(crc_microprogram());
+        VU_JIT::set_current_program(get_id(), crc_microprogram());
         clear_dirty();
     }
     
@@ -105,6 +105,12 @@ class VectorUnit
 
         std::unordered_set<uint32_t> seen_microprogram_crcs;
 
+        //Instruction memory is hashed in fixed-size ranges, so an upload only rehashes the ranges it touched
+        constexpr static int MICROPROGRAM_RANGE_SHIFT = 8;
+        constexpr static int MICROPROGRAM_RANGES = sizeof(VU_Mem) >> MICROPROGRAM_RANGE_SHIFT;
+        uint64_t dirty_ranges;
+        uint32_t range_crcs[MICROPROGRAM_RANGES];
+
         bool running;
         bool tbit_stop;
         bool vumem_is_dirty;
@@ -420,7 +426,10 @@ inline T VectorUnit::read_mem(uint32_t addr)
 template <typename T>
 inline void VectorUnit::write_instr(uint32_t addr, T data)
 {
-    *(T*)&instr_mem.m[addr & mem_mask] = data;
+    addr &= mem_mask;
+    *(T*)&instr_mem.m[addr] = data;
+    dirty_ranges |= 1ULL << (addr >> MICROPROGRAM_RANGE_SHIFT);
+    dirty_ranges |= 1ULL << (((addr + sizeof(T) - 1) & mem_mask) >> MICROPROGRAM_RANGE_SHIFT);
     vumem_is_dirty = true;
 }
 
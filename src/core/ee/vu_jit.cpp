@@ -11,21 +11,40 @@
 namespace VU_JIT
 {
 
-VU_JIT64 jit64;
+//Generated code addresses a single VU's state directly, so each VU gets its own heap and caches
+VU_JIT64 jit64[2];
 
 uint16_t run(VectorUnit *vu)
 {
-    return jit64.run(*vu);
+    return jit64[vu->get_id()].run(*vu);
 }
 
 void reset()
 {
-    jit64.reset();
+    jit64[0].reset();
+    jit64[1].reset();
 }
 
-void set_current_program(uint32_t crc)
+void reset(int id)
 {
-    jit64.set_current_program(crc);
+    jit64[id].reset();
+}
+
+void set_current_program(int id, uint32_t crc)
+{
+    jit64[id].set_current_program(crc);
+}
+
+void set_disk_cache_path(const std::string& path)
+{
+    jit64[0].set_disk_cache_path(path.empty() ? path : path + ".vu0");
+    jit64[1].set_disk_cache_path(path);
+}
+
+void save_disk_cache()
+{
+    jit64[0].save_disk_cache();
+    jit64[1].save_disk_cache();
 }
 
 };
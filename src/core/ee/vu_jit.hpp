@@ -1,6 +1,7 @@
 #ifndef VU_JIT_HPP
 #define VU_JIT_HPP
 #include <cstdint>
+#include <string>
 
 class VectorUnit;
 
@@ -9,7 +10,10 @@ namespace VU_JIT
 
 uint16_t run(VectorUnit* vu);
 void reset();
-void set_current_program(uint32_t crc);
+void reset(int id);
+void set_current_program(int id, uint32_t crc);
+void set_disk_cache_path(const std::string& path);
+void save_disk_cache();
 
 };
 
@@ -6,6 +6,8 @@
 #include "../gif.hpp"
 
 #include "../errors.hpp"
+#include "../profiler.hpp"
+#include "../jitcommon/jitsymbols.hpp"
 
 /**
  * Calling convention notes (needed for calling C++ functions within generated code)
@@ -78,6 +80,11 @@ void vu_tbit_stop_execution(VectorUnit& vu)
     vu.stop_by_tbit();
 }
 
+void vu_mbit_interlock(VectorUnit& vu)
+{
+    vu.check_interlock();
+}
+
 void vu_set_int(VectorUnit& vu, int dest, uint16_t value)
 {
     vu.set_int(dest, value);
@@ -191,6 +198,7 @@ void VU_JIT64::reset(bool clear_cache)
 
     if (clear_cache)
     {
+        Profiler::add_jit_flush(Profiler::JIT_VU);
         jit_heap.flush_all_blocks();
         create_prologue_block();
     }
@@ -208,6 +216,16 @@ void VU_JIT64::set_current_program(uint32_t crc)
     current_program = crc;
 }
 
+void VU_JIT64::set_disk_cache_path(const std::string &path)
+{
+    disk_cache.set_path(path);
+}
+
+void VU_JIT64::save_disk_cache()
+{
+    disk_cache.save();
+}
+
 uint64_t VU_JIT64::get_vf_addr(VectorUnit &vu, int index)
 {
     if (index < 32)
@@ -434,7 +452,7 @@ void VU_JIT64::load_int(VectorUnit &vu, IR::Instruction &instr)
     else
     {
         REG_64 dest = alloc_int_reg(vu, instr.get_dest(), REG_STATE::WRITE);
-        uint16_t offset = (instr.get_source() + field_offset) & 0x3FFF;
+        uint16_t offset = (instr.get_source() + field_offset) & vu.mem_mask;
         emitter.load_addr((uint64_t)&vu.data_mem.m[offset], REG_64::R15);
         emitter.MOV16_FROM_MEM(REG_64::R15, dest);
     }
@@ -498,7 +516,7 @@ void VU_JIT64::load_quad(VectorUnit &vu, IR::Instruction &instr)
     }
     else
     {
-        uint16_t offset = instr.get_source() & 0x3FFF;
+        uint16_t offset = instr.get_source() & vu.mem_mask;
         emitter.load_addr((uint64_t)&vu.data_mem.m[offset], REG_64::R15);
     }
 
@@ -539,7 +557,7 @@ void VU_JIT64::store_quad(VectorUnit &vu, IR::Instruction &instr)
     }
     else
     {
-        uint16_t offset = instr.get_source2() & 0x3FFF;
+        uint16_t offset = instr.get_source2() & vu.mem_mask;
         emitter.load_addr((uint64_t)&vu.data_mem.m[offset], REG_64::R15);
     }
 
@@ -856,7 +874,8 @@ void VU_JIT64::branch_equal(VectorUnit &vu, IR::Instruction &instr)
     }
     else
     {
-        if (instr.get_source() == vu.int_backup_id_rec)
+        //field2 holds which of the two registers was backed up
+        if (instr.get_source() == instr.get_field2())
         {
             op1 = REG_64::R15;
             op2 = alloc_int_reg(vu, instr.get_source2(), REG_STATE::READ);
@@ -894,7 +913,8 @@ void VU_JIT64::branch_not_equal(VectorUnit &vu, IR::Instruction &instr)
     }
     else
     {
-        if (instr.get_source() == vu.int_backup_id_rec)
+        //field2 holds which of the two registers was backed up
+        if (instr.get_source() == instr.get_field2())
         {
             op1 = REG_64::R15;
             op2 = alloc_int_reg(vu, instr.get_source2(), REG_STATE::READ);
@@ -2306,9 +2326,6 @@ void VU_JIT64::backup_vi(VectorUnit& vu, IR::Instruction& instr)
     emitter.MOV8_IMM_MEM(instr.get_source(), REG_64::RAX);
     emitter.load_addr((uint64_t)&vu.int_branch_delay, REG_64::RAX);
     emitter.MOV8_IMM_MEM(1, REG_64::RAX);
-    
-
-    vu.int_backup_id_rec = instr.get_source();
 }
 
 void VU_JIT64::clear_int_delay(VectorUnit& vu, IR::Instruction& instr)
@@ -2465,6 +2482,17 @@ void VU_JIT64::stop_by_tbit(VectorUnit &vu, IR::Instruction &instr)
     end_of_program = true;
 }
 
+void VU_JIT64::interlock_mbit(VectorUnit &vu, IR::Instruction &instr)
+{
+    //Resume after the M-bit instruction. If the block also ends on a branch or E-bit,
+    //those overwrite the PC afterwards
+    emitter.load_addr((uint64_t)&vu.PC, REG_64::RAX);
+    emitter.MOV16_IMM_MEM(instr.get_jump_dest(), REG_64::RAX);
+
+    prepare_abi(vu, (uint64_t)&vu);
+    call_abi_func((uint64_t)vu_mbit_interlock);
+}
+
 void VU_JIT64::save_pc(VectorUnit &vu, IR::Instruction &instr)
 {
     emitter.load_addr((uint64_t)&prev_pc, REG_64::RAX);
@@ -2788,7 +2816,9 @@ void VU_JIT64::create_prologue_block()
 
     jit_block.print_block();
 
-    prologue_block = (VUJitPrologue)jit_heap.insert_block(state, &jit_block)->code_start;
+    VUJitBlockRecord* record = jit_heap.insert_block(state, &jit_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "VU_prologue");
+    prologue_block = (VUJitPrologue)record->code_start;
 }
 
 void VU_JIT64::emit_prologue()
@@ -3082,6 +3112,9 @@ void VU_JIT64::emit_instruction(VectorUnit &vu, IR::Instruction &instr)
         case IR::Opcode::StopTBit:
             stop_by_tbit(vu, instr);
             break;
+        case IR::Opcode::InterlockMBit:
+            interlock_mbit(vu, instr);
+            break;
         case IR::Opcode::SavePC:
             save_pc(vu, instr);
             break;
@@ -3122,7 +3155,11 @@ VUJitBlockRecord* VU_JIT64::recompile_block(VectorUnit& vu, IR::Block& block)
     else
         cleanup_recompiler(vu, true);
 
-    return jit_heap.insert_block(VUBlockState{vu.get_PC(), prev_pc, current_program, vu.pipeline_state[0], vu.pipeline_state[1]}, &jit_block);
+    VUJitBlockRecord* record = jit_heap.insert_block(VUBlockState{vu.get_PC(), prev_pc, current_program,
+                                                     vu.pipeline_state[0], vu.pipeline_state[1]}, &jit_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "VU%d_%08X_%04X", vu.get_id(), current_program,
+                          record->block_data.pc);
+    return record;
 }
 
 void VU_JIT64::cleanup_recompiler(VectorUnit& vu, bool clear_regs)
@@ -3274,14 +3311,27 @@ extern "C"
 uint8_t* exec_block_vu(VU_JIT64& jit, VectorUnit& vu)
 {
     //fprintf(stderr, "[VU_JIT64] Executing block at $%04X, Prev PC $%04X Current Program %08X: recompiling\n", vu.PC, jit.prev_pc, jit.current_program);
-    VUJitBlockRecord* found_block = jit.jit_heap.find_block(VUBlockState
-        { vu.get_PC(), jit.prev_pc, jit.current_program, vu.pipeline_state[0], vu.pipeline_state[1] });
+    VUBlockState state{ vu.get_PC(), jit.prev_pc, jit.current_program, vu.pipeline_state[0], vu.pipeline_state[1] };
+    VUJitBlockRecord* found_block = jit.jit_heap.find_block(state);
 
     if (!found_block)
     {
         //fprintf(stderr, "[VU_JIT64] Block not found at $%04X, Prev PC $%04X Current Program %08X: recompiling\n", vu.PC, jit.prev_pc, jit.current_program);
-        IR::Block block = jit.ir.translate(vu, vu.get_instr_mem(), jit.prev_pc);
+        uint64_t compile_start = Profiler::timestamp();
+        IR::Block block;
+
+        //A pending VI backup changes how the translator handles the first branch, and it isn't part of the key
+        bool cacheable = !vu.int_branch_delay;
+        if (!cacheable || !jit.disk_cache.find_block(state, block))
+        {
+            block = jit.ir.translate(vu, vu.get_instr_mem(), jit.prev_pc);
+
+            //Neither is FBRST, which decides whether a T-bit ends the block
+            if (cacheable && !jit.ir.block_has_tbit())
+                jit.disk_cache.insert_block(state, block);
+        }
         found_block = jit.recompile_block(vu, block);
+        Profiler::add_jit_compile(Profiler::JIT_VU, compile_start);
     }
     return (uint8_t*)found_block->code_start;
 }
@@ -3294,6 +3344,7 @@ uint16_t VU_JIT64::run(VectorUnit& vu)
     if (jit_heap.heap_is_full())
     {
         printf("[VU JIT] Not enough room for new blocks, clearing cache\n");
+        Profiler::add_jit_flush(Profiler::JIT_VU);
         jit_heap.flush_all_blocks();
         create_prologue_block();
     }
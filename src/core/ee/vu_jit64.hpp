@@ -2,6 +2,7 @@
 #define VU_JIT64_HPP
 #include "../jitcommon/emitter64.hpp"
 #include "../jitcommon/ir_block.hpp"
+#include "vu_jitdiskcache.hpp"
 #include "vu_jittrans.hpp"
 #include "vu.hpp"
 
@@ -39,6 +40,7 @@ class VU_JIT64
         AllocReg int_regs[16];
         JitBlock jit_block;
         VUJitHeap jit_heap;
+        VUJitDiskCache disk_cache;
         Emitter64 emitter;
         VU_JitTranslator ir;
         VUJitPrologue prologue_block;
@@ -173,6 +175,7 @@ class VU_JIT64
         void update_xgkick(VectorUnit& vu, IR::Instruction& instr);
         void stop(VectorUnit& vu, IR::Instruction& instr);
         void stop_by_tbit(VectorUnit& vu, IR::Instruction& instr);
+        void interlock_mbit(VectorUnit& vu, IR::Instruction& instr);
         void save_pc(VectorUnit& vu, IR::Instruction& instr);
         void save_pipeline_state(VectorUnit& vu, IR::Instruction& instr);
         void move_delayed_branch(VectorUnit& vu, IR::Instruction& instr);
@@ -203,6 +206,8 @@ class VU_JIT64
 
         void reset(bool clear_cache = true);
         void set_current_program(uint32_t crc);
+        void set_disk_cache_path(const std::string& path);
+        void save_disk_cache();
         uint16_t run(VectorUnit& vu);
 
         friend uint8_t* exec_block_vu(VU_JIT64& jit, VectorUnit& vu);
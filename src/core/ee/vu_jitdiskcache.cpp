@@ -0,0 +1,244 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include "vu_jitdiskcache.hpp"
+
+using namespace std;
+
+namespace
+{
+
+const char CACHE_MAGIC[8] = {'D', 'O', 'B', 'I', 'E', 'V', 'U', 'C'};
+
+template <typename T>
+void write_value(ofstream& file, T value)
+{
+    file.write((char*)&value, sizeof(T));
+}
+
+template <typename T>
+bool read_value(ifstream& file, T& value)
+{
+    file.read((char*)&value, sizeof(T));
+    return (bool)file;
+}
+
+};
+
+VUJitDiskCache::VUJitDiskCache() : dirty(false)
+{
+
+}
+
+VUJitDiskCache::~VUJitDiskCache()
+{
+    save();
+}
+
+uint32_t VUJitDiskCache::ir_opcode_count()
+{
+    //Any change to the IR opcode list invalidates every stored block
+    static const uint32_t count = 0
+#define INSTR(name) + 1
+#include "../jitcommon/ir_instrlist.inc"
+#undef INSTR
+    ;
+    return count;
+}
+
+void VUJitDiskCache::set_path(const string &new_path)
+{
+    if (new_path == path)
+        return;
+
+    save();
+    blocks.clear();
+    dirty = false;
+    path = new_path;
+    load();
+}
+
+bool VUJitDiskCache::load()
+{
+    if (path.empty())
+        return false;
+
+    ifstream file(path, ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[sizeof(CACHE_MAGIC)];
+    uint32_t version, opcode_count, entries;
+    file.read(magic, sizeof(magic));
+    if (!file || memcmp(magic, CACHE_MAGIC, sizeof(magic)))
+    {
+        printf("[VU JIT] Disk cache %s is not a VU cache, ignoring\n", path.c_str());
+        return false;
+    }
+
+    if (!read_value(file, version) || !read_value(file, opcode_count) || !read_value(file, entries))
+        return false;
+
+    if (version != VERSION || opcode_count != ir_opcode_count())
+    {
+        printf("[VU JIT] Disk cache version mismatch (%d, expected %d), discarding\n", version, VERSION);
+        return false;
+    }
+
+    unordered_map<VUBlockState, VUCachedBlock, VUBlockStateHash> loaded;
+    for (uint32_t i = 0; i < entries; i++)
+    {
+        VUBlockState state;
+        VUCachedBlock cached;
+        int32_t cycle_count;
+        uint32_t instr_count;
+
+        bool ok = read_value(file, state.pc) && read_value(file, state.prev_pc) &&
+                  read_value(file, state.program) && read_value(file, state.param1) &&
+                  read_value(file, state.param2) && read_value(file, cycle_count) &&
+                  read_value(file, instr_count);
+        if (!ok)
+            break;
+
+        cached.cycle_count = cycle_count;
+        cached.instrs.reserve(instr_count);
+        for (uint32_t j = 0; j < instr_count && ok; j++)
+        {
+            uint16_t op, cycles;
+            uint32_t jump_dest, jump_fail_dest, return_addr, opcode;
+            int32_t dest, base;
+            uint64_t source, source2;
+            uint8_t bc, field, field2, is_likely, is_link;
+
+            ok = read_value(file, op) && read_value(file, jump_dest) && read_value(file, jump_fail_dest) &&
+                 read_value(file, return_addr) && read_value(file, dest) && read_value(file, base) &&
+                 read_value(file, source) && read_value(file, source2) && read_value(file, cycles) &&
+                 read_value(file, bc) && read_value(file, field) && read_value(file, field2) &&
+                 read_value(file, is_likely) && read_value(file, is_link) && read_value(file, opcode);
+            if (!ok || op >= ir_opcode_count())
+            {
+                ok = false;
+                break;
+            }
+
+            IR::Instruction instr((IR::Opcode)op);
+            instr.set_jump_dest(jump_dest);
+            instr.set_jump_fail_dest(jump_fail_dest);
+            instr.set_return_addr(return_addr);
+            instr.set_dest(dest);
+            instr.set_base(base);
+            instr.set_source(source);
+            instr.set_source2(source2);
+            instr.set_cycle_count(cycles);
+            instr.set_bc(bc);
+            instr.set_field(field);
+            instr.set_field2(field2);
+            instr.set_is_likely(is_likely);
+            instr.set_is_link(is_link);
+            instr.set_opcode(opcode);
+            cached.instrs.push_back(instr);
+        }
+
+        if (!ok)
+        {
+            printf("[VU JIT] Disk cache %s is truncated, discarding\n", path.c_str());
+            return false;
+        }
+
+        loaded[state] = cached;
+    }
+
+    blocks.swap(loaded);
+    printf("[VU JIT] Loaded %d blocks from disk cache\n", (int)blocks.size());
+    return true;
+}
+
+void VUJitDiskCache::save()
+{
+    if (path.empty() || !dirty)
+        return;
+
+    //Write to a temporary file first so a crash mid-save can't leave a half-written cache behind
+    string temp_path = path + ".tmp";
+    ofstream file(temp_path, ios::binary);
+    if (!file.is_open())
+    {
+        printf("[VU JIT] Failed to open %s for writing\n", temp_path.c_str());
+        return;
+    }
+
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    write_value(file, VERSION);
+    write_value(file, ir_opcode_count());
+    write_value(file, (uint32_t)blocks.size());
+
+    for (auto& kv : blocks)
+    {
+        const VUBlockState& state = kv.first;
+        const VUCachedBlock& cached = kv.second;
+
+        write_value(file, state.pc);
+        write_value(file, state.prev_pc);
+        write_value(file, state.program);
+        write_value(file, state.param1);
+        write_value(file, state.param2);
+        write_value(file, (int32_t)cached.cycle_count);
+        write_value(file, (uint32_t)cached.instrs.size());
+
+        for (const IR::Instruction& instr : cached.instrs)
+        {
+            write_value(file, (uint16_t)instr.op);
+            write_value(file, instr.get_jump_dest());
+            write_value(file, instr.get_jump_fail_dest());
+            write_value(file, instr.get_return_addr());
+            write_value(file, (int32_t)instr.get_dest());
+            write_value(file, (int32_t)instr.get_base());
+            write_value(file, instr.get_source());
+            write_value(file, instr.get_source2());
+            write_value(file, instr.get_cycle_count());
+            write_value(file, instr.get_bc());
+            write_value(file, instr.get_field());
+            write_value(file, instr.get_field2());
+            write_value(file, (uint8_t)instr.get_is_likely());
+            write_value(file, (uint8_t)instr.get_is_link());
+            write_value(file, instr.get_opcode());
+        }
+    }
+
+    file.close();
+    if (!file || rename(temp_path.c_str(), path.c_str()))
+    {
+        printf("[VU JIT] Failed to write disk cache %s\n", path.c_str());
+        remove(temp_path.c_str());
+        return;
+    }
+
+    dirty = false;
+}
+
+bool VUJitDiskCache::find_block(const VUBlockState &state, IR::Block &block)
+{
+    if (path.empty())
+        return false;
+
+    auto it = blocks.find(state);
+    if (it == blocks.end())
+        return false;
+
+    block.get_instrs() = it->second.instrs;
+    block.set_cycle_count(it->second.cycle_count);
+    return true;
+}
+
+void VUJitDiskCache::insert_block(const VUBlockState &state, const IR::Block& block)
+{
+    if (path.empty() || blocks.size() >= MAX_ENTRIES)
+        return;
+
+    VUCachedBlock cached;
+    cached.cycle_count = block.get_cycle_count();
+    cached.instrs = block.get_instrs();
+
+    blocks[state] = cached;
+    dirty = true;
+}
@@ -0,0 +1,46 @@
+#ifndef VU_JITDISKCACHE_HPP
+#define VU_JITDISKCACHE_HPP
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../jitcommon/ir_block.hpp"
+#include "../jitcommon/jitcache.hpp"
+
+struct VUCachedBlock
+{
+    int cycle_count;
+    std::vector<IR::Instruction> instrs;
+};
+
+/**
+  * Persistent cache of translated VU microprograms.
+  * Native code can't be reused between sessions as it embeds absolute host addresses, so the
+  * translated IR is stored instead, keyed by the same VUBlockState (program CRC, PC and pipeline
+  * state) the in-memory JIT heap uses. A hit skips the translator's analysis passes entirely.
+  * The file is rejected whole if its version or the IR opcode table doesn't match this build.
+  */
+class VUJitDiskCache
+{
+    private:
+        //Bump whenever VU_JitTranslator output changes for the same input
+        constexpr static uint32_t VERSION = 4;
+        constexpr static int MAX_ENTRIES = 64 * 1024;
+
+        std::unordered_map<VUBlockState, VUCachedBlock, VUBlockStateHash> blocks;
+        std::string path;
+        bool dirty;
+
+        static uint32_t ir_opcode_count();
+    public:
+        VUJitDiskCache();
+        ~VUJitDiskCache();
+
+        void set_path(const std::string& new_path);
+        bool load();
+        void save();
+
+        bool find_block(const VUBlockState& state, IR::Block& block);
+        void insert_block(const VUBlockState& state, const IR::Block& block);
+};
+
+#endif // VU_JITDISKCACHE_HPP
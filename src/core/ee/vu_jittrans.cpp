@@ -16,6 +16,11 @@ void VU_JitTranslator::reset_instr_info()
     memset(instr_info, 0, sizeof(instr_info));
 }
 
+bool VU_JitTranslator::block_has_tbit() const
+{
+    return has_tbit;
+}
+
 IR::Block VU_JitTranslator::translate(VectorUnit &vu, uint8_t* instr_mem, uint32_t prev_pc)
 {
     IR::Block block;
@@ -24,6 +29,8 @@ IR::Block VU_JitTranslator::translate(VectorUnit &vu, uint8_t* instr_mem, uint32
 
     trans_branch_delay_slot = false;
     trans_ebit_delay_slot = false;
+    is_vu0 = vu.get_id() == 0;
+    has_tbit = false;
     cycles_this_block = 0;
     cycles_since_xgkick_update = 0;
 
@@ -48,7 +55,8 @@ IR::Block VU_JitTranslator::translate(VectorUnit &vu, uint8_t* instr_mem, uint32
 
         cur_PC &= vu.mem_mask;
 
-        if (instr_info[cur_PC].branch_delay_slot || instr_info[cur_PC].ebit_delay_slot || instr_info[cur_PC].tbit_end)
+        if (instr_info[cur_PC].branch_delay_slot || instr_info[cur_PC].ebit_delay_slot || instr_info[cur_PC].tbit_end ||
+            instr_info[cur_PC].mbit_end)
         {
             block_end = true;
 
@@ -167,6 +175,14 @@ IR::Block VU_JitTranslator::translate(VectorUnit &vu, uint8_t* instr_mem, uint32
             }
         }
 
+        //VU0 M-bit: signal the COP2 interlock and let run_jit decide whether to wait for the EE
+        if (is_vu0 && (upper & (1 << 29)))
+        {
+            IR::Instruction interlock(IR::Opcode::InterlockMBit);
+            interlock.set_jump_dest(cur_PC + 8);
+            block.add_instr(interlock);
+        }
+
         //End of microprogram delay slot
         if (upper & (1 << 30))
         {
@@ -239,10 +255,14 @@ IR::Block VU_JitTranslator::translate(VectorUnit &vu, uint8_t* instr_mem, uint32
         cur_PC += 8;
     }
 
-    IR::Instruction update;
-    update.op = IR::Opcode::UpdateXgkick;
-    update.set_source(cycles_since_xgkick_update);
-    block.add_instr(update);
+    //Only VU1 has a path to the GIF
+    if (!is_vu0)
+    {
+        IR::Instruction update;
+        update.op = IR::Opcode::UpdateXgkick;
+        update.set_source(cycles_since_xgkick_update);
+        block.add_instr(update);
+    }
     block.set_cycle_count(cycles_this_block);
 
     return block;
@@ -530,6 +550,7 @@ void VU_JitTranslator::handle_vu_stalls(VectorUnit &vu, uint16_t PC, uint32_t lo
                 {
                     instr_info[PC].use_backup_vi = true;
                     vu.int_backup_id_rec = vu.int_backup_id;
+                    instr_info[PC].backup_vi_id = vu.int_backup_id_rec;
 
                     printf("[VU_JIT] Using backed up VI%d at PC %x\n", vu.int_backup_id_rec, PC);
                 }
@@ -553,6 +574,7 @@ void VU_JitTranslator::handle_vu_stalls(VectorUnit &vu, uint16_t PC, uint32_t lo
 
                     if (instr_info[PC].use_backup_vi)
                     {
+                        instr_info[PC].backup_vi_id = vu.int_backup_id_rec;
                         int backup_pc = ((PC - 32) < vu.get_PC()) ? vu.get_PC() : (PC - 32);
 
                         int stalls = 0;
@@ -644,6 +666,7 @@ void VU_JitTranslator::interpreter_pass(VectorUnit &vu, uint8_t *instr_mem, uint
 
         instr_info[PC].backup_vi = 0;
         instr_info[PC].use_backup_vi = false;
+        instr_info[PC].backup_vi_id = 0;
         instr_info[PC].stall_amount = 0;
         instr_info[PC].swap_ops = false;
         instr_info[PC].update_q_pipeline = false;
@@ -658,6 +681,7 @@ void VU_JitTranslator::interpreter_pass(VectorUnit &vu, uint8_t *instr_mem, uint
         instr_info[PC].q_pipeline_instr = false;
         instr_info[PC].p_pipeline_instr = false;
         instr_info[PC].tbit_end = false;
+        instr_info[PC].mbit_end = false;
 
         uint32_t upper = *(uint32_t*)&instr_mem[PC + 4];
         uint32_t lower = *(uint32_t*)&instr_mem[PC];
@@ -762,6 +786,7 @@ void VU_JitTranslator::interpreter_pass(VectorUnit &vu, uint8_t *instr_mem, uint
 
         if (upper & (1 << 27))
         {
+            has_tbit = true;
             if (vu.read_fbrst() & (1 << (3 + (vu.get_id() * 8))))
             {
                 block_end = true;
@@ -769,6 +794,15 @@ void VU_JitTranslator::interpreter_pass(VectorUnit &vu, uint8_t *instr_mem, uint
             }
         }
 
+        //VU0 M-bit: end the block so the EE gets a chance to reach the interlock.
+        //Branches and E-bits keep their delay slot in the same block.
+        if (vu.get_id() == 0 && (upper & (1 << 29)) && !block_end &&
+            !instr_info[PC].is_branch && !instr_info[PC].is_ebit)
+        {
+            block_end = true;
+            instr_info[PC].mbit_end = true;
+        }
+
         //XGKick we need to save the VU state if it stalls
         if (!(upper & (1 << 31)) && (lower & (1 << 31)) && (lower & 0x7FF) == 0x6FC)
         {
@@ -883,8 +917,20 @@ void VU_JitTranslator::fallback_interpreter(IR::Instruction &instr, uint32_t ins
     instr.set_field(is_upper);
 }
 
+/**
+ * VU0 maps VU1's registers at $4000. Addresses from vi00 are known at translation time, so any that land
+ * there go through the interpreter. Register-based addresses are wrapped to the 4 KB data memory.
+ */
+bool VU_JitTranslator::is_vu0_reg_access(int base, int16_t imm)
+{
+    return is_vu0 && !base && ((uint16_t)imm & 0x4000);
+}
+
 void VU_JitTranslator::update_xgkick(std::vector<IR::Instruction> &instrs)
 {
+    if (is_vu0)
+        return;
+
     IR::Instruction update;
     update.op = IR::Opcode::UpdateXgkick;
     update.set_source(cycles_since_xgkick_update);
@@ -1692,6 +1738,9 @@ void VU_JitTranslator::lower2(std::vector<IR::Instruction> &instrs, uint32_t low
 
             if (!instr.get_dest())
                 return;
+
+            if (is_vu0_reg_access(instr.get_base(), imm))
+                fallback_interpreter(instr, lower, false);
         }
             break;
         case 0x01:
@@ -1705,6 +1754,9 @@ void VU_JitTranslator::lower2(std::vector<IR::Instruction> &instrs, uint32_t low
             instr.set_source((lower >> 11) & 0x1F);
             instr.set_base((lower >> 16) & 0xF);
             instr.set_source2((int64_t)imm);
+
+            if (is_vu0_reg_access(instr.get_base(), imm))
+                fallback_interpreter(instr, lower, false);
         }
             break;
         case 0x04:
@@ -1721,6 +1773,9 @@ void VU_JitTranslator::lower2(std::vector<IR::Instruction> &instrs, uint32_t low
 
             if (!instr.get_dest())
                 return;
+
+            if (is_vu0_reg_access(instr.get_base(), imm))
+                fallback_interpreter(instr, lower, false);
         }
             break;
         case 0x05:
@@ -1735,6 +1790,9 @@ void VU_JitTranslator::lower2(std::vector<IR::Instruction> &instrs, uint32_t low
             instr.set_source((lower >> 16) & 0xF);
             instr.set_base((lower >> 11) & 0xF);
             instr.set_source2((int64_t)imm);
+
+            if (is_vu0_reg_access(instr.get_base(), imm))
+                fallback_interpreter(instr, lower, false);
         }
             break;
         case 0x08:
@@ -1852,6 +1910,7 @@ void VU_JitTranslator::lower2(std::vector<IR::Instruction> &instrs, uint32_t low
             instr.set_jump_fail_dest(PC + 16);
             instr.set_bc(trans_branch_delay_slot);
             instr.set_field(instr_info[PC].use_backup_vi);
+            instr.set_field2(instr_info[PC].backup_vi_id);
             break;
         case 0x29:
             //IBNE
@@ -1862,6 +1921,7 @@ void VU_JitTranslator::lower2(std::vector<IR::Instruction> &instrs, uint32_t low
             instr.set_jump_fail_dest(PC + 16);
             instr.set_bc(trans_branch_delay_slot);
             instr.set_field(instr_info[PC].use_backup_vi);
+            instr.set_field2(instr_info[PC].backup_vi_id);
             break;
         case 0x2C:
             //IBLTZ
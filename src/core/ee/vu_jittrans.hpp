@@ -30,6 +30,7 @@ struct VU_InstrInfo
     bool is_ebit;
     bool is_branch;
     bool tbit_end;
+    bool mbit_end;
     bool swap_ops;
     bool update_q_pipeline;
     bool update_p_pipeline;
@@ -54,6 +55,7 @@ struct VU_InstrInfo
     uint8_t decoder_vi_read1;
     uint8_t decoder_vi_write;
     bool use_backup_vi;
+    uint8_t backup_vi_id;
 };
 
 class VU_JitTranslator
@@ -61,6 +63,10 @@ class VU_JitTranslator
     private:
         bool trans_branch_delay_slot;
         bool trans_ebit_delay_slot;
+        bool is_vu0;
+
+        //Whether the block ends at a T-bit depends on FBRST at translation time
+        bool has_tbit;
 
         int cycles_this_block;
         int cycles_since_xgkick_update;
@@ -86,6 +92,7 @@ class VU_JitTranslator
 
         void fallback_interpreter(IR::Instruction& instr, uint32_t instr_word, bool is_upper);
         void update_xgkick(std::vector<IR::Instruction>& instrs);
+        bool is_vu0_reg_access(int base, int16_t imm);
 
         void op_vectors(IR::Instruction& instr, uint32_t upper);
         void op_acc_and_vectors(IR::Instruction& instr, uint32_t upper);
@@ -104,6 +111,7 @@ class VU_JitTranslator
     public:
         IR::Block translate(VectorUnit& vu, uint8_t *instr_mem, uint32_t prev_pc);
         void reset_instr_info();
+        bool block_has_tbit() const;
 };
 
 #endif // VU_JITTRANS_HPP
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cfenv>
 #include <cstring>
 #include <cstdio>
@@ -5,6 +6,7 @@
 #include <sstream>
 #include "emulator.hpp"
 #include "errors.hpp"
+#include "profiler.hpp"
 
 #include "ee/vu_jit.hpp"
 #include "ee/ee_jit.hpp"
@@ -12,6 +14,14 @@
 #define CYCLES_PER_FRAME 4900000
 #define VBLANK_START_CYCLES CYCLES_PER_FRAME * 0.75
 
+//The SPU outputs a sample at 48 kHz, and samples are generated in blocks of up to SPU_MAX_BLOCK_SAMPLES
+#define SPU_SAMPLE_CYCLES 768
+#define SPU_MAX_BLOCK_SAMPLES 256
+
+//How far the IOP thread may trail the EE by default, in IOP cycles, and the most it runs between checks for new work
+#define IOP_THREAD_DEFAULT_SKEW 256
+#define IOP_THREAD_SLICE 4
+
 //These constants are used for the fast boot hack for .isos
 #define EELOAD_START 0x82000
 #define EELOAD_SIZE 0x20000
@@ -45,13 +55,25 @@ Emulator::Emulator() :
     ELF_file = nullptr;
     ELF_size = 0;
     gsdump_single_frame = false;
+    iop_threaded = false;
+    iop_max_skew = IOP_THREAD_DEFAULT_SKEW;
+    iop_thread_quit = false;
+    iop_thread_parked = false;
+    iop_thread_awake = false;
+    iop_target = 0;
+    iop_done = 0;
+    iop_messages_sent = 0;
+    iop_messages_done = 0;
+    iop_message_pending = false;
     ee_log.open("ee_log.txt", std::ios::out);
     set_ee_mode(CPU_MODE::DONT_CARE);
+    set_vu0_mode(CPU_MODE::DONT_CARE);
     set_vu1_mode(CPU_MODE::DONT_CARE);
 }
 
 Emulator::~Emulator()
 {
+    stop_iop_thread();
     if (ee_log.is_open())
         ee_log.close();
     delete[] RDRAM;
@@ -95,7 +117,10 @@ void Emulator::run()
 
     add_ee_event(VBLANK_START, &Emulator::vblank_start, VBLANK_START_CYCLES);
     add_ee_event(VBLANK_END, &Emulator::vblank_end, CYCLES_PER_FRAME);
-    
+
+    Profiler::begin_frame();
+    if (iop_threaded)
+        resume_iop_thread();
     while (!frame_ended)
     {
         int ee_cycles = scheduler.calculate_run_cycles();
@@ -103,26 +128,54 @@ void Emulator::run()
         int iop_cycles = scheduler.get_iop_run_cycles();
         scheduler.update_cycle_counts();
 
+        uint64_t t = Profiler::timestamp();
+        if (iop_threaded)
+            iop_target.store(scheduler.get_iop_target_cycles(), std::memory_order_release);
         cpu.run(ee_cycles);
-        iop_timers.run(iop_cycles);
-        iop_dma.run(iop_cycles);
-        iop.run(iop_cycles);
-        iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
+        t = Profiler::end_section(Profiler::SECTION_EE, t, ee_cycles);
+        if (iop_threaded)
+        {
+            //Only the time spent waiting on the IOP thread shows up here
+            wait_for_iop(iop_max_skew);
+            sif.update_EE_DMA_requests();
+            t = Profiler::end_section(Profiler::SECTION_IOP, t, iop_cycles);
+        }
+        else
+        {
+            iop_timers.run(iop_cycles);
+            t = Profiler::end_section(Profiler::SECTION_TIMERS, t);
+            iop_dma.run(iop_cycles);
+            t = Profiler::end_section(Profiler::SECTION_IOP_DMA, t, iop_cycles);
+            iop.run(iop_cycles);
+            iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
+            t = Profiler::end_section(Profiler::SECTION_IOP, t, iop_cycles);
+        }
 
         dmac.run(bus_cycles);
+        t = Profiler::end_section(Profiler::SECTION_DMAC, t, bus_cycles);
         timers.run(bus_cycles);
+        t = Profiler::end_section(Profiler::SECTION_TIMERS, t);
         ipu.run();
+        t = Profiler::end_section(Profiler::SECTION_IPU, t);
         vif0.update(bus_cycles);
+        t = Profiler::end_section(Profiler::SECTION_VIF0, t, bus_cycles);
         vif1.update(bus_cycles);
+        t = Profiler::end_section(Profiler::SECTION_VIF1, t, bus_cycles);
         gif.run(bus_cycles);
+        t = Profiler::end_section(Profiler::SECTION_GIF, t, bus_cycles);
         
         //VU's run at EE speed, however VU0 maintains its own speed
-        vu0.run(ee_cycles);
+        vu0_run_func(vu0, ee_cycles);
+        t = Profiler::end_section(Profiler::SECTION_VU0, t, ee_cycles);
         vu1_run_func(vu1, ee_cycles);
-
+        t = Profiler::end_section(Profiler::SECTION_VU1, t, ee_cycles);
 
         scheduler.process_events(this);
+        Profiler::end_section(Profiler::SECTION_EVENTS, t);
     }
+    if (iop_threaded)
+        pause_iop_thread();
+    Profiler::end_frame();
     fesetround(originalRounding);
 }
 
@@ -158,6 +211,7 @@ void Emulator::reset()
     iop_timers.reset();
     intc.reset();
     ipu.reset();
+    memcard.reset();
     pad.reset();
     scheduler.reset();
     sif.reset();
@@ -169,6 +223,7 @@ void Emulator::reset()
     vif1.reset();
     vu0.reset();
     vu1.reset();
+    VU_JIT::save_disk_cache();
     VU_JIT::reset();
     EE_JIT::reset(true);
 
@@ -186,7 +241,9 @@ void Emulator::reset()
 
     iop_scratchpad_start = 0x1F800000;
 
-    add_iop_event(SPU_SAMPLE, &Emulator::gen_sound_sample, 768);
+    spu_next_sample = SPU_SAMPLE_CYCLES;
+    spu_block_end = spu_next_sample + (SPU_MAX_BLOCK_SAMPLES - 1) * SPU_SAMPLE_CYCLES;
+    add_iop_event(SPU_SAMPLE, &Emulator::gen_sound_sample, spu_block_end);
 }
 
 void Emulator::print_state()
@@ -202,17 +259,22 @@ void Emulator::vblank_start()
     VBLANK_sent = true;
     gs.set_VBLANK(true);
     timers.gate(true, true);
-    cdvd.vsync();
     //cpu.set_disassembly(frames >= 223 && frames < 225);
     printf("VSYNC FRAMES: %d\n", frames);
     gs.assert_VSYNC();
-    iop_request_IRQ(0);
+    if (iop_threaded)
+        send_iop_message(IOP_MESSAGE_VBLANK_START);
+    else
+        iop_vblank_start();
 }
 
 void Emulator::vblank_end()
 {
     //VBLANK end
-    iop_request_IRQ(11);
+    if (iop_threaded)
+        send_iop_message(IOP_MESSAGE_VBLANK_END);
+    else
+        iop_vblank_end();
     gs.set_VBLANK(false);
     timers.gate(true, false);
     frame_ended = true;
@@ -220,6 +282,17 @@ void Emulator::vblank_end()
     gs.render_CRT();
 }
 
+void Emulator::iop_vblank_start()
+{
+    cdvd.vsync();
+    iop_request_IRQ(0);
+}
+
+void Emulator::iop_vblank_end()
+{
+    iop_request_IRQ(11);
+}
+
 void Emulator::cdvd_event()
 {
     cdvd.handle_N_command();
@@ -227,9 +300,55 @@ void Emulator::cdvd_event()
 
 void Emulator::gen_sound_sample()
 {
-    spu.gen_sample();
-    spu2.gen_sample();
-    add_iop_event(SPU_SAMPLE, &Emulator::gen_sound_sample, 768);
+    sync_spu();
+
+    spu_block_end = spu_next_sample + (get_spu_block_samples() - 1) * SPU_SAMPLE_CYCLES;
+    add_iop_event(SPU_SAMPLE, &Emulator::gen_sound_sample, spu_block_end - scheduler.get_iop_cycles());
+}
+
+/**
+ * Generates every sample that is due by the current IOP cycle.
+ * Anything that can observe or modify SPU state must call this first, as the SPU_SAMPLE event only fires once per block.
+ */
+void Emulator::sync_spu()
+{
+    int64_t now = scheduler.get_iop_cycles();
+    if (now < spu_next_sample)
+        return;
+
+    int64_t count = (now - spu_next_sample) / SPU_SAMPLE_CYCLES + 1;
+    spu_next_sample += count * SPU_SAMPLE_CYCLES;
+
+    stereo_sample samples[SPU_MAX_BLOCK_SAMPLES];
+    while (count)
+    {
+        int block = std::min(count, (int64_t)SPU_MAX_BLOCK_SAMPLES);
+        for (int i = 0; i < block; i++)
+        {
+            spu.gen_sample();
+            spu2.gen_sample();
+            samples[i] = SPU::mix(spu, spu2);
+        }
+        audio.push(samples, block);
+        count -= block;
+    }
+}
+
+//Ends the current block early if a state change means an IRQA hit or ADMA request can now happen inside it
+void Emulator::update_spu_block()
+{
+    int64_t block_end = spu_next_sample + (get_spu_block_samples() - 1) * SPU_SAMPLE_CYCLES;
+    if (block_end < spu_block_end)
+    {
+        spu_block_end = block_end;
+        scheduler.reschedule_event(SPU_SAMPLE, spu_block_end << 3);
+    }
+}
+
+int Emulator::get_spu_block_samples()
+{
+    int samples = spu.samples_until_event(SPU_MAX_BLOCK_SAMPLES);
+    return spu2.samples_until_event(samples);
 }
 
 void Emulator::ee_irq_check()
@@ -253,7 +372,7 @@ void Emulator::update_joystick(JOYSTICK joystick, JOYSTICK_AXIS axis, uint8_t va
     pad.update_joystick(joystick, axis, val);
 }
 
-uint32_t* Emulator::get_framebuffer()
+GSOutputFrames* Emulator::get_framebuffer()
 {
     //This function should only be called upon ending a frame; return nullptr otherwise
     if (!frame_ended)
@@ -266,6 +385,11 @@ void Emulator::get_resolution(int &w, int &h)
     gs.get_resolution(w, h);
 }
 
+double Emulator::get_refresh_rate()
+{
+    return gs.get_refresh_rate();
+}
+
 void Emulator::get_inner_resolution(int &w, int &h)
 {
     gs.get_inner_resolution(w, h);
@@ -286,6 +410,9 @@ void Emulator::fast_boot()
 {
     if (skip_BIOS_hack == LOAD_DISC)
     {
+        //Once caught up, the IOP thread stays idle until the EE moves on, so the drive is safe to use from here
+        sync_iop();
+
         //First we need to determine the name of the game executable
         //This is done by finding SYSTEM.CNF on the game disc, then getting the name of the executable it points to.
         uint32_t system_cnf_size;
@@ -348,6 +475,205 @@ void Emulator::set_ee_mode(CPU_MODE mode)
     }
 }
 
+void Emulator::set_vu_jit_cache_path(const std::string& path)
+{
+    VU_JIT::set_disk_cache_path(path);
+}
+
+void Emulator::set_audio_sink(std::unique_ptr<AudioSink> sink)
+{
+    audio.set_sink(std::move(sink));
+}
+
+AudioMetrics Emulator::get_audio_metrics() const
+{
+    return audio.get_metrics();
+}
+
+//Must not be called while a frame is running
+void Emulator::set_iop_threaded(bool threaded)
+{
+    if (threaded == iop_threaded)
+        return;
+
+    if (!threaded)
+        stop_iop_thread();
+    iop_threaded = threaded;
+    scheduler.set_iop_threaded(threaded);
+    sif.set_threaded(threaded);
+    if (threaded)
+        start_iop_thread();
+}
+
+void Emulator::set_iop_max_skew(int cycles)
+{
+    iop_max_skew = std::max(cycles, 0);
+}
+
+void Emulator::start_iop_thread()
+{
+    iop_thread_quit = false;
+    iop_thread_parked = false;
+    iop_thread_awake = false;
+    iop_thread = std::thread(&Emulator::iop_thread_loop, this);
+}
+
+void Emulator::stop_iop_thread()
+{
+    if (!iop_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(iop_thread_mutex);
+        iop_thread_quit = true;
+    }
+    iop_thread_notifier.notify_all();
+    iop_thread.join();
+}
+
+void Emulator::resume_iop_thread()
+{
+    iop_done = scheduler.get_iop_cycles();
+    iop_target = scheduler.get_iop_target_cycles();
+    {
+        std::lock_guard<std::mutex> lock(iop_thread_mutex);
+        iop_thread_awake = true;
+    }
+    iop_thread_notifier.notify_all();
+}
+
+//Lets the IOP catch up completely and parks it, so everything outside of run() sees a single-threaded emulator
+void Emulator::pause_iop_thread()
+{
+    wait_for_iop(0);
+
+    std::unique_lock<std::mutex> lock(iop_thread_mutex);
+    iop_thread_awake = false;
+    iop_thread_notifier.wait(lock, [this] { return iop_thread_parked; });
+    lock.unlock();
+
+    //Nothing can be left flagged across a savestate
+    sif.update_EE_DMA_requests();
+    sif.update_IOP_DMA_requests();
+}
+
+void Emulator::wait_for_iop(int64_t max_skew)
+{
+    int64_t target = iop_target.load(std::memory_order_relaxed);
+    while (target - iop_done.load(std::memory_order_acquire) > max_skew)
+        std::this_thread::yield();
+
+    //A full sync also needs everything sent at the target cycle to have been applied
+    if (!max_skew)
+    {
+        while (iop_messages_done.load(std::memory_order_acquire) != iop_messages_sent)
+            std::this_thread::yield();
+    }
+}
+
+/**
+ * Called before the EE touches state the IOP thread owns, namely IOP RAM and the CDVD registers.
+ * Waiting for the IOP to reach the published target stops it there, and the acquire on iop_done makes its writes
+ * visible. The EE's own writes are released to the IOP along with the next target in run().
+ */
+void Emulator::sync_iop()
+{
+    if (iop_threaded)
+        wait_for_iop(0);
+}
+
+void Emulator::send_iop_message(IOP_MESSAGE_TYPE type)
+{
+    IOPMessage message;
+    message.type = type;
+    message.time = scheduler.get_iop_target_cycles();
+    iop_messages.push(message);
+    iop_messages_sent++;
+}
+
+void Emulator::handle_iop_message(const IOPMessage& message)
+{
+    switch (message.type)
+    {
+        case IOP_MESSAGE_VBLANK_START:
+            iop_vblank_start();
+            break;
+        case IOP_MESSAGE_VBLANK_END:
+            iop_vblank_end();
+            break;
+    }
+}
+
+/**
+ * Runs the IOP side in slices of at most IOP_THREAD_SLICE cycles, the same granularity lock-step mode gets.
+ * Slices never cross the target, a pending message or an IOP event, so the IOP sees everything from the EE at
+ * exactly the cycle it would have in lock-step. Only the IOP's effects on the EE side arrive late, by up to the skew.
+ */
+void Emulator::iop_thread_loop()
+{
+    while (true)
+    {
+        if (!iop_thread_awake.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(iop_thread_mutex);
+            iop_thread_parked = true;
+            iop_thread_notifier.notify_all();
+            iop_thread_notifier.wait(lock, [this] { return iop_thread_awake || iop_thread_quit; });
+            if (iop_thread_quit)
+                return;
+            iop_thread_parked = false;
+            continue;
+        }
+
+        //Messages must be checked after loading the target, so everything sent before it was published is seen
+        int64_t target = iop_target.load(std::memory_order_acquire);
+        int64_t now = scheduler.get_iop_cycles();
+        while (true)
+        {
+            if (!iop_message_pending)
+                iop_message_pending = iop_messages.pop(iop_pending_message);
+            if (!iop_message_pending || iop_pending_message.time > now)
+                break;
+            handle_iop_message(iop_pending_message);
+            iop_message_pending = false;
+            iop_messages_done.fetch_add(1, std::memory_order_release);
+        }
+        if (iop_message_pending)
+            target = std::min(target, iop_pending_message.time);
+
+        if (now >= target)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        int cycles = std::min({target - now, scheduler.get_iop_cycles_to_event(), (int64_t)IOP_THREAD_SLICE});
+        sif.update_IOP_DMA_requests();
+        iop_timers.run(cycles);
+        iop_dma.run(cycles);
+        iop.run(cycles);
+        iop.interrupt_check(IOP_I_CTRL && (IOP_I_MASK & IOP_I_STAT));
+
+        scheduler.add_iop_thread_cycles(cycles);
+        scheduler.process_iop_events(this);
+        iop_done.store(now + cycles, std::memory_order_release);
+    }
+}
+
+void Emulator::set_vu0_mode(CPU_MODE mode)
+{
+    switch (mode)
+    {
+        case CPU_MODE::INTERPRETER:
+            vu0_run_func = &VectorUnit::run;
+            break;
+        case CPU_MODE::JIT:
+        default:
+            vu0_run_func = &VectorUnit::run_jit;
+            break;
+    }
+}
+
 void Emulator::set_vu1_mode(CPU_MODE mode)
 {
     switch (mode)
@@ -389,6 +715,11 @@ bool Emulator::load_CDVD(const char *name, CDVD_CONTAINER type)
     return cdvd.load_disc(name, type);
 }
 
+bool Emulator::load_memcard(const char* name)
+{
+    return memcard.open(name);
+}
+
 void Emulator::execute_ELF()
 {
     if (!ELF_file)
@@ -446,6 +777,11 @@ bool Emulator::check_cop2_interlock()
    return vu_interlock;
 }
 
+void Emulator::run_vu0(int cycles)
+{
+    vu0_run_func(vu0, cycles);
+}
+
 bool Emulator::interlock_cop2_check(bool isCOP2)
 {
     if (isCOP2)
@@ -471,7 +807,10 @@ bool Emulator::interlock_cop2_check(bool isCOP2)
 uint8_t Emulator::read8(uint32_t address)
 {
     if (address >= 0x1C000000 && address < 0x1C200000)
+    {
+        sync_iop();
         return IOP_RAM[address & 0x1FFFFF];
+    }
     if (address >= 0x10000000 && address < 0x10002000)
         return (timers.read32(address & ~0xF) >> (8 * (address & 0x3)));
     if (address >= 0x10008000 && address < 0x1000F000)
@@ -484,6 +823,8 @@ uint8_t Emulator::read8(uint32_t address)
         return vu1.read_instr<uint8_t>(address);
     if (address >= 0x1100C000 && address < 0x11010000)
         return vu1.read_mem<uint8_t>(address);
+    if (address >= 0x1F402000 && address < 0x1F402020)
+        sync_iop();
     switch (address)
     {
         case 0x1F40200F:
@@ -504,7 +845,10 @@ uint16_t Emulator::read16(uint32_t address)
     if (address >= 0x10008000 && address < 0x1000F000)
         return dmac.read16(address);
     if (address >= 0x1C000000 && address < 0x1C200000)
+    {
+        sync_iop();
         return *(uint16_t*)&IOP_RAM[address & 0x1FFFFF];
+    }
     if (address >= 0x11000000 && address < 0x11004000)
         return vu0.read_instr<uint16_t>(address);
     if (address >= 0x11004000 && address < 0x11008000)
@@ -533,7 +877,10 @@ uint32_t Emulator::read32(uint32_t address)
     if (address >= 0x10008000 && address < 0x1000F000)
         return dmac.read32(address);
     if (address >= 0x1C000000 && address < 0x1C200000)
+    {
+        sync_iop();
         return *(uint32_t*)&IOP_RAM[address & 0x1FFFFF];
+    }
     if (address >= 0x11000000 && address < 0x11004000)
         return vu0.read_instr<uint32_t>(address);
     if (address >= 0x11004000 && address < 0x11008000)
@@ -644,7 +991,10 @@ uint64_t Emulator::read64(uint32_t address)
     if ((address & (0xFF000000)) == 0x12000000)
         return gs.read64_privileged(address);
     if (address >= 0x1C000000 && address < 0x1C200000)
+    {
+        sync_iop();
         return *(uint64_t*)&IOP_RAM[address & 0x1FFFFF];
+    }
     switch (address)
     {
         case 0x10002000:
@@ -684,6 +1034,7 @@ void Emulator::write8(uint32_t address, uint8_t value)
     }
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_iop();
         IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
@@ -726,6 +1077,7 @@ void Emulator::write16(uint32_t address, uint16_t value)
     }
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_iop();
         *(uint16_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
@@ -761,6 +1113,7 @@ void Emulator::write32(uint32_t address, uint32_t value)
 {
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_iop();
         *(uint32_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
@@ -891,6 +1244,7 @@ void Emulator::write64(uint32_t address, uint64_t value)
 {
     if (address >= 0x1C000000 && address < 0x1C200000)
     {
+        sync_iop();
         *(uint64_t*)&IOP_RAM[address & 0x1FFFFF] = value;
         return;
     }
@@ -1074,9 +1428,15 @@ uint16_t Emulator::iop_read16(uint32_t address)
     if (address >= 0x1FC00000 && address < 0x20000000)
         return *(uint16_t*)&BIOS[address & 0x3FFFFF];
     if (address >= 0x1F900000 && address < 0x1F900400)
+    {
+        sync_spu();
         return spu.read16(address);
+    }
     if (address >= 0x1F900400 && address < 0x1F900800)
+    {
+        sync_spu();
         return spu2.read16(address);
+    }
     switch (address)
     {
         case 0x1F801100:
@@ -1311,12 +1671,16 @@ void Emulator::iop_write16(uint32_t address, uint16_t value)
     }
     if (address >= 0x1F900000 && address < 0x1F900400)
     {
+        sync_spu();
         spu.write16(address, value);
+        update_spu_block();
         return;
     }
     if (address >= 0x1F900400 && address < 0x1F900800)
     {
+        sync_spu();
         spu2.write16(address, value);
+        update_spu_block();
         return;
     }
     switch (address)
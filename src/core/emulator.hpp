@@ -1,7 +1,11 @@
 #ifndef EMULATOR_HPP
 #define EMULATOR_HPP
+#include <atomic>
+#include <condition_variable>
 #include <fstream>
 #include <functional>
+#include <mutex>
+#include <thread>
 
 #include "ee/dmac.hpp"
 #include "ee/emotion.hpp"
@@ -20,6 +24,8 @@
 #include "iop/sio2.hpp"
 #include "iop/spu.hpp"
 
+#include "audio.hpp"
+#include "circularFIFO.hpp"
 #include "int128.hpp"
 #include "gs.hpp"
 #include "gif.hpp"
@@ -40,6 +46,19 @@ enum CPU_MODE
     INTERPRETER
 };
 
+enum IOP_MESSAGE_TYPE
+{
+    IOP_MESSAGE_VBLANK_START,
+    IOP_MESSAGE_VBLANK_END
+};
+
+//EE-side work for the IOP thread, applied when the IOP reaches the cycle it was sent at
+struct IOPMessage
+{
+    IOP_MESSAGE_TYPE type;
+    int64_t time;
+};
+
 class Emulator
 {
     private:
@@ -73,6 +92,7 @@ class Emulator
 
         std::ofstream ee_log;
         std::string ee_stdout;
+        std::function<void(VectorUnit&, int)> vu0_run_func;
         std::function<void(VectorUnit&, int)> vu1_run_func;
 
         uint8_t* RDRAM;
@@ -99,7 +119,48 @@ class Emulator
         uint8_t* ELF_file;
         uint32_t ELF_size;
 
+        //IOP cycle of the next SPU sample to generate and of the pending SPU_SAMPLE event
+        int64_t spu_next_sample;
+        int64_t spu_block_end;
+
+        AudioOutput audio;
+
+        /**
+          * With the IOP threaded, the IOP, its DMA and timers, the SPUs and the CDVD drive run on iop_thread.
+          * The EE side publishes how far the IOP may run in iop_target and waits whenever the IOP falls more
+          * than iop_max_skew cycles behind. Outside of Emulator::run the thread is parked and fully caught up.
+          */
+        bool iop_threaded;
+        int iop_max_skew;
+        std::thread iop_thread;
+        std::mutex iop_thread_mutex;
+        std::condition_variable iop_thread_notifier;
+        bool iop_thread_quit, iop_thread_parked;
+        std::atomic_bool iop_thread_awake;
+        alignas(64) std::atomic<int64_t> iop_target;
+        alignas(64) std::atomic<int64_t> iop_done;
+
+        alignas(64) CircularFifo<IOPMessage, 16> iop_messages;
+        uint64_t iop_messages_sent;
+        std::atomic<uint64_t> iop_messages_done;
+        IOPMessage iop_pending_message;
+        bool iop_message_pending;
+
         void iop_IRQ_check(uint32_t new_stat, uint32_t new_mask);
+        int get_spu_block_samples();
+
+        void iop_vblank_start();
+        void iop_vblank_end();
+
+        void iop_thread_loop();
+        void start_iop_thread();
+        void stop_iop_thread();
+        void resume_iop_thread();
+        void pause_iop_thread();
+        void wait_for_iop(int64_t max_skew);
+        void sync_iop();
+        void send_iop_message(IOP_MESSAGE_TYPE type);
+        void handle_iop_message(const IOPMessage& message);
 
         bool frame_ended;
     public:
@@ -115,14 +176,22 @@ class Emulator
         void fast_boot();
         void set_skip_BIOS_hack(SKIP_HACK type);
         void set_ee_mode(CPU_MODE mode);
+        void set_vu0_mode(CPU_MODE mode);
         void set_vu1_mode(CPU_MODE mode);
+        void set_vu_jit_cache_path(const std::string& path);
+        void set_iop_threaded(bool threaded);
+        void set_iop_max_skew(int cycles);
+        void set_audio_sink(std::unique_ptr<AudioSink> sink);
+        AudioMetrics get_audio_metrics() const;
         void load_BIOS(const uint8_t* BIOS);
         void load_ELF(const uint8_t* ELF, uint32_t size);
         bool load_CDVD(const char* name, CDVD_CONTAINER type);
+        bool load_memcard(const char* name);
         void execute_ELF();
-        uint32_t* get_framebuffer();
+        GSOutputFrames* get_framebuffer();
         void get_resolution(int& w, int& h);
         void get_inner_resolution(int& w, int& h);
+        double get_refresh_rate();
 
         //Events
         void vblank_start();
@@ -141,6 +210,7 @@ class Emulator
         bool interlock_cop2_check(bool isCOP2);
         void clear_cop2_interlock();
         bool check_cop2_interlock();
+        void run_vu0(int cycles);
 
         uint8_t read8(uint32_t address);
         uint16_t read16(uint32_t address);
@@ -164,6 +234,8 @@ class Emulator
         void iop_write32(uint32_t address, uint32_t value);
 
         void iop_request_IRQ(int index);
+        void sync_spu();
+        void update_spu_block();
         void iop_ksprintf();
         void iop_puts();
 
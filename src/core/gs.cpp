@@ -14,29 +14,30 @@ registers.
 **/
 
 GraphicsSynthesizer::GraphicsSynthesizer(INTC* intc) 
-    : intc(intc), frame_complete(false),
-    output_buffer1(nullptr), output_buffer2(nullptr)
+    : intc(intc), frame_complete(false)
 {
+    //Allocated up front so the frontend can hold on to the buffers for the GS's whole lifetime
+    for (int i = 0; i < GSOutputFrames::FRAME_COUNT; i++)
+    {
+        output_frames.buffers[i] = new uint32_t[1920 * 1280]();
+        output_frames.width[i] = 0;
+        output_frames.height[i] = 0;
+    }
+    output_frames.back = 0;
+    output_frames.front = 1;
+    output_frames.ready = 2;
 }
 
 GraphicsSynthesizer::~GraphicsSynthesizer()
 {
     gs_thread.exit();
 
-    delete[] output_buffer1;
-    delete[] output_buffer2;
+    for (int i = 0; i < GSOutputFrames::FRAME_COUNT; i++)
+        delete[] output_frames.buffers[i];
 }
 
 void GraphicsSynthesizer::reset()
 {
-    if (!output_buffer1)
-        output_buffer1 = new uint32_t[1920 * 1280];
-
-    if (!output_buffer2)
-        output_buffer2 = new uint32_t[1920 * 1280];
-
-    current_lock = std::unique_lock<std::mutex>();
-    using_first_buffer = true;
     frame_count = 0;
     set_CRT(false, 0x2, false);
     reg.reset();
@@ -64,35 +65,12 @@ void GraphicsSynthesizer::set_CRT(bool interlaced, int mode, bool frame_mode)
     gs_thread.send_message({ GSCommand::set_crt_t, payload });
 }
 
-uint32_t* GraphicsSynthesizer::get_framebuffer()
+GSOutputFrames* GraphicsSynthesizer::get_framebuffer()
 {
-    uint32_t* out;
     GSReturnMessage data;
 
     gs_thread.wait_for_return(GSReturn::render_complete_t, data);
-    
-    if (using_first_buffer)
-    {
-        while (!output_buffer1_mutex.try_lock())
-        {
-            printf("[GS] buffer 1 lock failed!\n");
-            std::this_thread::yield();
-        }
-        current_lock = std::unique_lock<std::mutex>(output_buffer1_mutex, std::adopt_lock);
-        out = output_buffer1;
-    }
-    else
-    {
-        while (!output_buffer2_mutex.try_lock())
-        {
-            printf("[GS] buffer 2 lock failed!\n");
-            std::this_thread::yield();
-        }
-        current_lock = std::unique_lock<std::mutex>(output_buffer2_mutex, std::adopt_lock);
-        out = output_buffer2;
-    }
-    using_first_buffer = !using_first_buffer;
-    return out;
+    return &output_frames;
 }
 
 void GraphicsSynthesizer::set_CSR_FIFO(uint8_t value)
@@ -147,25 +125,17 @@ void GraphicsSynthesizer::assert_FINISH()
 void GraphicsSynthesizer::render_CRT()
 {
     GSMessagePayload payload;
+    payload.render_payload = { &output_frames };
 
-    if (using_first_buffer)
-        payload.render_payload = { output_buffer1, &output_buffer1_mutex };
-    else
-        payload.render_payload = { output_buffer2, &output_buffer2_mutex }; ;
-    
     gs_thread.send_message({ GSCommand::render_crt_t, payload });
     gs_thread.wake_thread();
 }
 
-uint32_t* GraphicsSynthesizer::render_partial_frame(uint16_t& width, uint16_t& height)
+GSOutputFrames* GraphicsSynthesizer::render_partial_frame(uint16_t& width, uint16_t& height)
 {
     GSMessagePayload payload;
+    payload.render_payload = { &output_frames };
 
-    if (using_first_buffer)
-        payload.render_payload = { output_buffer1, &output_buffer1_mutex };
-    else
-        payload.render_payload = { output_buffer2, &output_buffer2_mutex }; ;
-    
     gs_thread.send_message({ GSCommand::memdump_t,payload });
     gs_thread.wake_thread();
     GSReturnMessage data;
@@ -173,19 +143,7 @@ uint32_t* GraphicsSynthesizer::render_partial_frame(uint16_t& width, uint16_t& h
     
     width = data.payload.xy_payload.x;
     height = data.payload.xy_payload.y;
-
-    if (using_first_buffer)
-    {
-        using_first_buffer = false;
-        current_lock = std::unique_lock<std::mutex>(output_buffer1_mutex);
-        return output_buffer1;
-    }
-    else
-    {
-        using_first_buffer = true;
-        current_lock = std::unique_lock<std::mutex>(output_buffer2_mutex);
-        return output_buffer2;
-    }
+    return &output_frames;
 }
 
 void GraphicsSynthesizer::get_resolution(int &w, int &h)
@@ -193,6 +151,11 @@ void GraphicsSynthesizer::get_resolution(int &w, int &h)
     reg.get_resolution(w, h);
 }
 
+double GraphicsSynthesizer::get_refresh_rate()
+{
+    return reg.get_refresh_rate();
+}
+
 void GraphicsSynthesizer::get_inner_resolution(int &w, int &h)
 {
     reg.get_inner_resolution(w, h);
@@ -306,7 +269,7 @@ void GraphicsSynthesizer::set_XYZF(uint32_t x, uint32_t y, uint32_t z, uint8_t f
     gs_thread.send_message({ GSCommand::set_xyzf_t, payload });
 }
 
-void GraphicsSynthesizer::load_state(std::ifstream &state)
+void GraphicsSynthesizer::load_state(std::istream &state)
 {
     GSMessagePayload payload;
     payload.load_state_payload = {&state};
@@ -318,7 +281,7 @@ void GraphicsSynthesizer::load_state(std::ifstream &state)
     state.read((char*)&reg, sizeof(reg));
 }
 
-void GraphicsSynthesizer::save_state(std::ofstream &state)
+void GraphicsSynthesizer::save_state(std::ostream &state)
 {
     GSMessagePayload payload;
     payload.save_state_payload = {&state};
@@ -361,3 +324,19 @@ std::tuple<uint128_t, uint32_t>GraphicsSynthesizer::request_gs_download()
     return std::make_tuple(data.payload.data_payload.quad_data, data.payload.data_payload.status);
 }
 
+void GraphicsSynthesizer::set_pixel_jit(bool enabled)
+{
+    gs_thread.set_pixel_jit(enabled);
+}
+
+GSThreadStats GraphicsSynthesizer::get_thread_stats()
+{
+    GSThreadStats stats;
+    GSMessagePayload payload;
+    payload.stats_payload = { &stats };
+    gs_thread.send_message({ GSCommand::stats_t, payload });
+    gs_thread.wake_thread();
+    GSReturnMessage data;
+    gs_thread.wait_for_return(GSReturn::stats_done_t, data);
+    return stats;
+}
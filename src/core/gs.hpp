@@ -14,11 +14,7 @@ class GraphicsSynthesizer
         INTC* intc;
         bool frame_complete;
         int frame_count;
-        uint32_t* output_buffer1;
-        uint32_t* output_buffer2;//double buffered to prevent mutex lock
-        std::mutex output_buffer1_mutex, output_buffer2_mutex;
-        bool using_first_buffer;
-        std::unique_lock<std::mutex> current_lock;
+        GSOutputFrames output_frames;
 
         GS_REGISTERS reg;
 
@@ -30,11 +26,12 @@ class GraphicsSynthesizer
         void reset();
         void start_frame();
         bool is_frame_complete() const;
-        uint32_t* get_framebuffer();
+        GSOutputFrames* get_framebuffer();
         void render_CRT();
-        uint32_t* render_partial_frame(uint16_t& width, uint16_t& height);
+        GSOutputFrames* render_partial_frame(uint16_t& width, uint16_t& height);
         void get_resolution(int& w, int& h);
         void get_inner_resolution(int& w, int& h);
+        double get_refresh_rate();
 
         inline bool stalled() { return reg.CSR.SIGNAL_stall; }
 
@@ -57,13 +54,17 @@ class GraphicsSynthesizer
         void set_XYZ(uint32_t x, uint32_t y, uint32_t z, bool drawing_kick);
         void set_XYZF(uint32_t x, uint32_t y, uint32_t z, uint8_t fog, bool drawing_kick);
 
-        void load_state(std::ifstream& state);
-        void save_state(std::ofstream& state);
+        void load_state(std::istream& state);
+        void save_state(std::ostream& state);
         void send_dump_request();
 
         void send_message(GSMessage message);
         void wake_gs_thread();
 
         std::tuple<uint128_t, uint32_t>request_gs_download();
+
+        void set_pixel_jit(bool enabled);
+        //Waits for the GS thread to drain its queue, then returns and resets its counters
+        GSThreadStats get_thread_stats();
 };
 #endif // GS_HPP
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+#include "gsbench.hpp"
+#include "gsdump.hpp"
+#include "gs.hpp"
+#include "errors.hpp"
+
+using namespace std;
+
+//Waking the GS thread for every message costs more than the messages themselves
+constexpr static int MESSAGES_PER_WAKE = 1024;
+
+bool GSReplayBenchmark::run(const string& name, const GSBenchmarkOptions& options, GSBenchmarkResult& result)
+{
+    //The GS thread carries a lot of state, so keep it off the stack
+    unique_ptr<GraphicsSynthesizer> gs(new GraphicsSynthesizer(nullptr));
+    GSDumpReader reader;
+
+    if (!reader.open(name))
+    {
+        Errors::print_warning("Failed to open gsdump %s", name.c_str());
+        return false;
+    }
+    if (!reader.seek(0, *gs))
+        return false;
+
+    gs->set_pixel_jit(options.pixel_jit);
+
+    //Drain the initial state load and start counting from here
+    gs->get_thread_stats();
+
+    result = {};
+    bool frame_in_flight = false;
+    bool done = false;
+    int unwoken_messages = 0;
+    auto start = chrono::steady_clock::now();
+
+    GSMessage data;
+    while (!done && reader.read_message(data))
+    {
+        switch (data.type)
+        {
+            case render_crt_t:
+                if (options.skip_crt)
+                    gs->send_message(data);
+                else
+                    gs->render_CRT();
+                gs->wake_gs_thread();
+                unwoken_messages = 0;
+
+                //Only wait for the previous frame, so the GS thread always has the next one queued up
+                if (frame_in_flight)
+                    gs->get_framebuffer();
+                frame_in_flight = true;
+
+                result.frames++;
+                if (options.max_frames && result.frames >= options.max_frames)
+                    done = true;
+                break;
+            case request_local_host_tx:
+                gs->request_gs_download();
+                unwoken_messages = 0;
+                break;
+            case gsdump_t:
+                done = true;
+                break;
+            case memdump_t:
+            case save_state_t:
+            case load_state_t:
+                break;
+            default:
+                gs->send_message(data);
+                if (++unwoken_messages >= MESSAGES_PER_WAKE)
+                {
+                    gs->wake_gs_thread();
+                    unwoken_messages = 0;
+                }
+                break;
+        }
+    }
+
+    if (frame_in_flight)
+        gs->get_framebuffer();
+    GSThreadStats stats = gs->get_thread_stats();
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    result.wall_seconds = elapsed.count();
+    result.messages = stats.messages;
+    result.prims = stats.prims;
+    result.pixels = stats.pixels;
+
+    vector<float>& times = stats.frame_times_ms;
+    if (!times.empty())
+    {
+        double total = 0.0;
+        for (float t : times)
+            total += t;
+        result.gs_busy_seconds = total / 1000.0;
+        result.frame_avg_ms = total / times.size();
+
+        sort(times.begin(), times.end());
+        result.frame_p99_ms = times[(times.size() - 1) * 99 / 100];
+        result.frame_max_ms = times.back();
+    }
+    return true;
+}
+
+void GSReplayBenchmark::print(const char* label, const GSBenchmarkResult& result)
+{
+    double seconds = max(result.wall_seconds, 1e-9);
+    printf("[GS Bench] %s: %u frames in %.3f s (%.2f FPS)\n", label, result.frames, result.wall_seconds,
+           result.frames / seconds);
+    printf("[GS Bench]   messages: %llu (%.2f M/s)\n", (unsigned long long)result.messages,
+           result.messages / seconds / 1000000.0);
+    printf("[GS Bench]   prims:    %llu (%.2f K/s)\n", (unsigned long long)result.prims,
+           result.prims / seconds / 1000.0);
+    printf("[GS Bench]   pixels:   %llu (%.2f M/s)\n", (unsigned long long)result.pixels,
+           result.pixels / seconds / 1000000.0);
+    printf("[GS Bench]   GS thread: %.3f s busy, per frame avg %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           result.gs_busy_seconds, result.frame_avg_ms, result.frame_p99_ms, result.frame_max_ms);
+}
+
+void GSReplayBenchmark::print_comparison(const char* label_a, const GSBenchmarkResult& a,
+                                         const char* label_b, const GSBenchmarkResult& b)
+{
+    if (a.pixels != b.pixels || a.prims != b.prims)
+    {
+        printf("[GS Bench] Warning: %s and %s drew different amounts (%llu/%llu prims, %llu/%llu pixels)\n",
+               label_a, label_b, (unsigned long long)a.prims, (unsigned long long)b.prims,
+               (unsigned long long)a.pixels, (unsigned long long)b.pixels);
+    }
+    if (a.gs_busy_seconds > 0.0 && b.gs_busy_seconds > 0.0)
+    {
+        printf("[GS Bench] %s speedup over %s: %.2fx GS thread time, %.2fx wall time\n", label_a, label_b,
+               b.gs_busy_seconds / a.gs_busy_seconds, b.wall_seconds / max(a.wall_seconds, 1e-9));
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef GSBENCH_HPP
+#define GSBENCH_HPP
+#include <cstdint>
+#include <string>
+
+struct GSBenchmarkOptions
+{
+    //Frame boundaries are still replayed, but nothing is written to the output frames
+    bool skip_crt;
+    bool pixel_jit;
+
+    //0 replays the whole dump
+    uint32_t max_frames;
+};
+
+struct GSBenchmarkResult
+{
+    uint32_t frames;
+    uint64_t messages;
+    uint64_t prims;
+    uint64_t pixels;
+
+    double wall_seconds;
+    double gs_busy_seconds;
+
+    float frame_avg_ms;
+    float frame_p99_ms;
+    float frame_max_ms;
+};
+
+/**
+  * Replays a gsdump through a private GS thread as fast as it will go.
+  * The player keeps at most one frame in flight instead of waiting on display, so timings only depend on
+  * the dump and the rasterizer, which makes runs comparable between builds and between pixel paths.
+  */
+class GSReplayBenchmark
+{
+    public:
+        static bool run(const std::string& name, const GSBenchmarkOptions& options, GSBenchmarkResult& result);
+        static void print(const char* label, const GSBenchmarkResult& result);
+        static void print_comparison(const char* label_a, const GSBenchmarkResult& a,
+                                     const char* label_b, const GSBenchmarkResult& b);
+};
+
+#endif // GSBENCH_HPP
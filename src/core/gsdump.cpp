@@ -0,0 +1,736 @@
+#include <cstring>
+#include <sstream>
+#include <libdeflate.h>
+
+#include "gsdump.hpp"
+#include "gs.hpp"
+#include "errors.hpp"
+
+using namespace std;
+
+constexpr static char GSDUMP_MAGIC[8] = {'D', 'O', 'B', 'I', 'E', 'G', 'S', 'D'};
+constexpr static uint32_t GSDUMP_VERSION = 1;
+constexpr static size_t GSDUMP_HEADER_SIZE = 24;
+constexpr static size_t GSDUMP_INDEX_OFFSET_POS = 16;
+constexpr static size_t GSDUMP_BLOCK_HEADER_SIZE = 9;
+
+//Message blocks are flushed once they reach this size
+constexpr static size_t GSDUMP_BLOCK_SIZE = 256 * 1024;
+constexpr static int GSDUMP_COMPRESSION_LEVEL = 3;
+
+static void put_varint(vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(value);
+}
+
+static bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p == end)
+            return false;
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool get_byte(const uint8_t*& p, const uint8_t* end, uint8_t& value)
+{
+    if (p == end)
+        return false;
+    value = *p++;
+    return true;
+}
+
+template <typename T>
+static bool get_varint(const uint8_t*& p, const uint8_t* end, T& value)
+{
+    uint64_t v;
+    if (!get_varint(p, end, v))
+        return false;
+    value = (T)v;
+    return true;
+}
+
+//Only the fields a command actually uses are stored, so most messages shrink from sizeof(GSMessage) to a few bytes
+static void encode_message(vector<uint8_t>& out, const GSMessage& message)
+{
+    const GSMessagePayload& p = message.payload;
+    out.push_back(message.type);
+    switch (message.type)
+    {
+        case write64_t:
+        case write64_privileged_t:
+            put_varint(out, p.write64_payload.addr);
+            put_varint(out, p.write64_payload.value);
+            break;
+        case write32_privileged_t:
+            put_varint(out, p.write32_payload.addr);
+            put_varint(out, p.write32_payload.value);
+            break;
+        case set_rgba_t:
+        {
+            uint32_t q;
+            memcpy(&q, &p.rgba_payload.q, sizeof(q));
+            out.push_back(p.rgba_payload.r);
+            out.push_back(p.rgba_payload.g);
+            out.push_back(p.rgba_payload.b);
+            out.push_back(p.rgba_payload.a);
+            put_varint(out, q);
+            break;
+        }
+        case set_st_t:
+            put_varint(out, p.st_payload.s);
+            put_varint(out, p.st_payload.t);
+            break;
+        case set_uv_t:
+            put_varint(out, p.uv_payload.u);
+            put_varint(out, p.uv_payload.v);
+            break;
+        case set_xyz_t:
+            put_varint(out, p.xyz_payload.x);
+            put_varint(out, p.xyz_payload.y);
+            put_varint(out, p.xyz_payload.z);
+            out.push_back(p.xyz_payload.drawing_kick);
+            break;
+        case set_xyzf_t:
+            put_varint(out, p.xyzf_payload.x);
+            put_varint(out, p.xyzf_payload.y);
+            put_varint(out, p.xyzf_payload.z);
+            out.push_back(p.xyzf_payload.fog);
+            out.push_back(p.xyzf_payload.drawing_kick);
+            break;
+        case set_crt_t:
+            out.push_back(p.crt_payload.interlaced);
+            put_varint(out, (uint32_t)p.crt_payload.mode);
+            out.push_back(p.crt_payload.frame_mode);
+            break;
+        case set_vblank_t:
+            out.push_back(p.vblank_payload.vblank);
+            break;
+        default:
+            //Everything else either has no payload or only carries host pointers
+            break;
+    }
+}
+
+static bool decode_message(const uint8_t*& p, const uint8_t* end, GSMessage& message)
+{
+    uint8_t type, b;
+    if (!get_byte(p, end, type) || type > request_local_host_tx)
+        return false;
+
+    message.type = (GSCommand)type;
+    GSMessagePayload& payload = message.payload;
+    memset(&payload, 0, sizeof(payload));
+    switch (message.type)
+    {
+        case write64_t:
+        case write64_privileged_t:
+            return get_varint(p, end, payload.write64_payload.addr) &&
+                   get_varint(p, end, payload.write64_payload.value);
+        case write32_privileged_t:
+            return get_varint(p, end, payload.write32_payload.addr) &&
+                   get_varint(p, end, payload.write32_payload.value);
+        case set_rgba_t:
+        {
+            uint32_t q;
+            if (!get_byte(p, end, payload.rgba_payload.r) || !get_byte(p, end, payload.rgba_payload.g) ||
+                !get_byte(p, end, payload.rgba_payload.b) || !get_byte(p, end, payload.rgba_payload.a) ||
+                !get_varint(p, end, q))
+                return false;
+            memcpy(&payload.rgba_payload.q, &q, sizeof(q));
+            return true;
+        }
+        case set_st_t:
+            return get_varint(p, end, payload.st_payload.s) && get_varint(p, end, payload.st_payload.t);
+        case set_uv_t:
+            return get_varint(p, end, payload.uv_payload.u) && get_varint(p, end, payload.uv_payload.v);
+        case set_xyz_t:
+            if (!get_varint(p, end, payload.xyz_payload.x) || !get_varint(p, end, payload.xyz_payload.y) ||
+                !get_varint(p, end, payload.xyz_payload.z) || !get_byte(p, end, b))
+                return false;
+            payload.xyz_payload.drawing_kick = b;
+            return true;
+        case set_xyzf_t:
+            if (!get_varint(p, end, payload.xyzf_payload.x) || !get_varint(p, end, payload.xyzf_payload.y) ||
+                !get_varint(p, end, payload.xyzf_payload.z) || !get_byte(p, end, payload.xyzf_payload.fog) ||
+                !get_byte(p, end, b))
+                return false;
+            payload.xyzf_payload.drawing_kick = b;
+            return true;
+        case set_crt_t:
+        {
+            uint32_t mode;
+            if (!get_byte(p, end, b))
+                return false;
+            payload.crt_payload.interlaced = b;
+            if (!get_varint(p, end, mode) || !get_byte(p, end, b))
+                return false;
+            payload.crt_payload.mode = (int)mode;
+            payload.crt_payload.frame_mode = b;
+            return true;
+        }
+        case set_vblank_t:
+            if (!get_byte(p, end, b))
+                return false;
+            payload.vblank_payload.vblank = b;
+            return true;
+        default:
+            return true;
+    }
+}
+
+template <typename T>
+static void write_raw(ostream& out, T value)
+{
+    out.write((char*)&value, sizeof(value));
+}
+
+template <typename T>
+static bool read_raw(istream& in, T& value)
+{
+    in.read((char*)&value, sizeof(value));
+    return in.gcount() == sizeof(value);
+}
+
+GSDumpWriter::GSDumpWriter() : compressor(nullptr), keyframe_interval(DEFAULT_KEYFRAME_INTERVAL), in_frame(false)
+{
+
+}
+
+GSDumpWriter::~GSDumpWriter()
+{
+    close();
+}
+
+bool GSDumpWriter::open(const string& name, uint32_t keyframe_interval)
+{
+    close();
+
+    file.open(name, ios::out | ios::binary | ios::trunc);
+    if (!file.is_open())
+        return false;
+
+    compressor = libdeflate_alloc_compressor(GSDUMP_COMPRESSION_LEVEL);
+    if (!compressor)
+    {
+        file.close();
+        return false;
+    }
+
+    this->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+    in_frame = false;
+    frames.clear();
+    keyframes.clear();
+    block.clear();
+    block.reserve(GSDUMP_BLOCK_SIZE + 64);
+
+    //The index offset stays 0 until close() so that an interrupted recording can still be recovered
+    file.write(GSDUMP_MAGIC, sizeof(GSDUMP_MAGIC));
+    write_raw<uint32_t>(file, GSDUMP_VERSION);
+    write_raw<uint32_t>(file, 0);
+    write_raw<uint64_t>(file, 0);
+    return true;
+}
+
+void GSDumpWriter::close()
+{
+    if (!file.is_open())
+        return;
+
+    flush_block();
+    write_index();
+    file.close();
+
+    libdeflate_free_compressor(compressor);
+    compressor = nullptr;
+}
+
+bool GSDumpWriter::is_open() const
+{
+    return file.is_open();
+}
+
+void GSDumpWriter::write_block(GSDumpBlockType type, const uint8_t* data, size_t size)
+{
+    compressed.resize(libdeflate_deflate_compress_bound(compressor, size));
+    size_t compressed_size = libdeflate_deflate_compress(compressor, data, size,
+                                                         compressed.data(), compressed.size());
+    if (!compressed_size)
+        Errors::die("[GS] gsdump block failed to compress");
+
+    write_raw<uint8_t>(file, type);
+    write_raw<uint32_t>(file, compressed_size);
+    write_raw<uint32_t>(file, size);
+    file.write((char*)compressed.data(), compressed_size);
+}
+
+void GSDumpWriter::flush_block()
+{
+    if (block.empty())
+        return;
+
+    write_block(GSDUMP_MESSAGES, block.data(), block.size());
+    block.clear();
+}
+
+void GSDumpWriter::write_index()
+{
+    uint64_t index_offset = file.tellp();
+
+    write_raw<uint32_t>(file, frames.size());
+    for (GSDumpFrame& frame : frames)
+    {
+        write_raw(file, frame.block_offset);
+        write_raw(file, frame.offset);
+    }
+    write_raw<uint32_t>(file, keyframes.size());
+    for (GSDumpKeyframe& keyframe : keyframes)
+    {
+        write_raw(file, keyframe.frame);
+        write_raw(file, keyframe.block_offset);
+    }
+
+    file.seekp(GSDUMP_INDEX_OFFSET_POS);
+    write_raw(file, index_offset);
+}
+
+void GSDumpWriter::write_message(const GSMessage& message)
+{
+    //A frame starts in the block currently being filled, which will land at the current end of the file
+    if (!in_frame)
+    {
+        frames.push_back({(uint64_t)file.tellp(), (uint32_t)block.size()});
+        in_frame = true;
+    }
+
+    encode_message(block, message);
+
+    if (message.type == render_crt_t)
+        in_frame = false;
+
+    if (block.size() >= GSDUMP_BLOCK_SIZE)
+        flush_block();
+}
+
+bool GSDumpWriter::needs_keyframe() const
+{
+    if (in_frame)
+        return false;
+    return keyframes.empty() || frames.size() - keyframes.back().frame >= keyframe_interval;
+}
+
+void GSDumpWriter::write_keyframe(const string& state)
+{
+    //Flushing here means the frame after a keyframe always starts a fresh message block
+    flush_block();
+    keyframes.push_back({(uint32_t)frames.size(), (uint64_t)file.tellp()});
+    write_block(GSDUMP_STATE, (const uint8_t*)state.data(), state.size());
+}
+
+GSDumpReader::GSDumpReader() : data_end(0), legacy(false), worker_offset(0), worker_stop(false), current_pos(0), current_frame(0)
+{
+    current.end = false;
+}
+
+GSDumpReader::~GSDumpReader()
+{
+    close();
+}
+
+bool GSDumpReader::open(const string& name)
+{
+    close();
+
+    file.open(name, ios::in | ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.seekg(0, ios::end);
+    data_end = file.tellg();
+    file.seekg(0);
+
+    char magic[sizeof(GSDUMP_MAGIC)] = {};
+    file.read(magic, sizeof(magic));
+    if (file.gcount() != sizeof(magic) || memcmp(magic, GSDUMP_MAGIC, sizeof(magic)))
+    {
+        //Raw GSMessage dump from before the container existed; these can only be played from the start
+        printf("[GS] Legacy gsdump, seeking is unavailable\n");
+        legacy = true;
+        file.clear();
+        file.seekg(0);
+        return true;
+    }
+
+    uint32_t version, reserved;
+    uint64_t index_offset;
+    if (!read_raw(file, version) || !read_raw(file, reserved) || !read_raw(file, index_offset))
+    {
+        close();
+        return false;
+    }
+    if (version != GSDUMP_VERSION)
+    {
+        Errors::print_warning("gsdump version %d is not supported", version);
+        close();
+        return false;
+    }
+
+    bool index_ok = false;
+    if (index_offset)
+    {
+        data_end = index_offset;
+        index_ok = read_index(index_offset);
+    }
+    if (!index_ok)
+    {
+        printf("[GS] gsdump has no index, rebuilding it\n");
+        index_ok = build_index();
+    }
+
+    if (!index_ok || keyframes.empty() || keyframes[0].frame != 0)
+    {
+        Errors::print_warning("gsdump is corrupt");
+        close();
+        return false;
+    }
+
+    printf("[GS] Opened gsdump with %d frames and %d keyframes\n", (int)frames.size(), (int)keyframes.size());
+    return true;
+}
+
+void GSDumpReader::close()
+{
+    stop_worker();
+    if (file.is_open())
+        file.close();
+    file.clear();
+
+    legacy = false;
+    frames.clear();
+    keyframes.clear();
+    current.data.clear();
+    current.end = false;
+    current_pos = 0;
+    current_frame = 0;
+}
+
+bool GSDumpReader::is_open() const
+{
+    return file.is_open();
+}
+
+bool GSDumpReader::is_legacy() const
+{
+    return legacy;
+}
+
+uint32_t GSDumpReader::get_frame_count() const
+{
+    return frames.size();
+}
+
+uint32_t GSDumpReader::get_current_frame() const
+{
+    return current_frame;
+}
+
+bool GSDumpReader::read_block(uint64_t& offset, GSDumpBlockType& type, vector<uint8_t>& data,
+                              libdeflate_decompressor* decompressor)
+{
+    if (offset + GSDUMP_BLOCK_HEADER_SIZE > data_end)
+        return false;
+
+    uint8_t block_type;
+    uint32_t compressed_size, size;
+    file.clear();
+    file.seekg(offset);
+    if (!read_raw(file, block_type) || !read_raw(file, compressed_size) || !read_raw(file, size))
+        return false;
+    if (block_type > GSDUMP_STATE || offset + GSDUMP_BLOCK_HEADER_SIZE + compressed_size > data_end)
+        return false;
+
+    vector<uint8_t> compressed(compressed_size);
+    file.read((char*)compressed.data(), compressed_size);
+    if ((uint32_t)file.gcount() != compressed_size)
+        return false;
+
+    data.resize(size);
+    size_t actual;
+    auto res = libdeflate_deflate_decompress(decompressor, compressed.data(), compressed_size,
+                                             data.data(), size, &actual);
+    if (res != LIBDEFLATE_SUCCESS || actual != size)
+        return false;
+
+    type = (GSDumpBlockType)block_type;
+    offset += GSDUMP_BLOCK_HEADER_SIZE + compressed_size;
+    return true;
+}
+
+bool GSDumpReader::read_index(uint64_t index_offset)
+{
+    uint32_t count;
+    file.clear();
+    file.seekg(index_offset);
+
+    if (!read_raw(file, count))
+        return false;
+    frames.resize(count);
+    for (GSDumpFrame& frame : frames)
+    {
+        if (!read_raw(file, frame.block_offset) || !read_raw(file, frame.offset))
+            return false;
+    }
+
+    if (!read_raw(file, count))
+        return false;
+    keyframes.resize(count);
+    for (GSDumpKeyframe& keyframe : keyframes)
+    {
+        if (!read_raw(file, keyframe.frame) || !read_raw(file, keyframe.block_offset))
+            return false;
+        if (keyframe.frame > frames.size())
+            return false;
+    }
+    return true;
+}
+
+bool GSDumpReader::build_index()
+{
+    frames.clear();
+    keyframes.clear();
+
+    libdeflate_decompressor* decompressor = libdeflate_alloc_decompressor();
+    if (!decompressor)
+        return false;
+
+    //Walk every block the same way the writer filled them; anything after the last intact block is dropped
+    uint64_t offset = GSDUMP_HEADER_SIZE;
+    bool in_frame = false;
+    vector<uint8_t> data;
+    GSDumpBlockType type;
+    while (true)
+    {
+        uint64_t block_offset = offset;
+        if (!read_block(offset, type, data, decompressor))
+            break;
+
+        if (type == GSDUMP_STATE)
+        {
+            keyframes.push_back({(uint32_t)frames.size(), block_offset});
+            continue;
+        }
+
+        const uint8_t* start = data.data();
+        const uint8_t* end = start + data.size();
+        const uint8_t* p = start;
+        GSMessage message;
+        while (p != end)
+        {
+            const uint8_t* msg_start = p;
+            if (!decode_message(p, end, message))
+                break;
+            if (!in_frame)
+            {
+                frames.push_back({block_offset, (uint32_t)(msg_start - start)});
+                in_frame = true;
+            }
+            if (message.type == render_crt_t)
+                in_frame = false;
+        }
+    }
+
+    libdeflate_free_decompressor(decompressor);
+    data_end = offset;
+    return true;
+}
+
+void GSDumpReader::start_worker(uint64_t offset)
+{
+    stop_worker();
+    queue.clear();
+    worker_offset = offset;
+    worker_stop = false;
+    worker = thread(&GSDumpReader::worker_loop, this);
+}
+
+void GSDumpReader::stop_worker()
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        lock_guard<mutex> lk(queue_mutex);
+        worker_stop = true;
+    }
+    queue_cv.notify_all();
+    worker.join();
+    queue.clear();
+}
+
+void GSDumpReader::worker_loop()
+{
+    libdeflate_decompressor* decompressor = libdeflate_alloc_decompressor();
+
+    while (true)
+    {
+        Block block;
+        GSDumpBlockType type = GSDUMP_MESSAGES;
+        block.offset = worker_offset;
+        block.end = !decompressor || !read_block(worker_offset, type, block.data, decompressor);
+
+        //Keyframes are only needed when seeking
+        if (!block.end && type == GSDUMP_STATE)
+            continue;
+
+        unique_lock<mutex> lk(queue_mutex);
+        queue_cv.wait(lk, [this] { return worker_stop || queue.size() < MAX_QUEUED_BLOCKS; });
+        if (worker_stop)
+            break;
+
+        queue.push_back(std::move(block));
+        queue_cv.notify_all();
+        if (queue.back().end)
+            break;
+    }
+
+    if (decompressor)
+        libdeflate_free_decompressor(decompressor);
+}
+
+bool GSDumpReader::next_block()
+{
+    if (current.end || !worker.joinable())
+        return false;
+
+    unique_lock<mutex> lk(queue_mutex);
+    queue_cv.wait(lk, [this] { return !queue.empty(); });
+    current = std::move(queue.front());
+    queue.pop_front();
+    queue_cv.notify_all();
+
+    current_pos = 0;
+    return !current.end;
+}
+
+bool GSDumpReader::seek(uint32_t frame, GraphicsSynthesizer& gs)
+{
+    if (!file.is_open())
+        return false;
+
+    if (legacy)
+    {
+        if (frame != 0)
+            return false;
+        file.clear();
+        file.seekg(0);
+        gs.reset();
+        gs.load_state(file);
+        current_frame = 0;
+        return true;
+    }
+
+    stop_worker();
+
+    if (frame > frames.size())
+        frame = frames.size();
+
+    size_t k = keyframes.size() - 1;
+    while (keyframes[k].frame > frame)
+        k--;
+    const GSDumpKeyframe& keyframe = keyframes[k];
+
+    libdeflate_decompressor* decompressor = libdeflate_alloc_decompressor();
+    if (!decompressor)
+        return false;
+
+    uint64_t offset = keyframe.block_offset;
+    GSDumpBlockType type;
+    vector<uint8_t> state;
+    bool ok = read_block(offset, type, state, decompressor) && type == GSDUMP_STATE;
+    libdeflate_free_decompressor(decompressor);
+    if (!ok)
+    {
+        Errors::print_warning("gsdump keyframe for frame %d is corrupt", keyframe.frame);
+        return false;
+    }
+
+    istringstream state_stream(string((char*)state.data(), state.size()));
+    gs.reset();
+    gs.load_state(state_stream);
+
+    current.data.clear();
+    current.end = false;
+    current_frame = keyframe.frame;
+
+    if (keyframe.frame < frames.size())
+    {
+        const GSDumpFrame& start = frames[keyframe.frame];
+        start_worker(start.block_offset);
+        next_block();
+        current_pos = start.offset;
+    }
+    else
+    {
+        start_worker(offset);
+        current_pos = 0;
+    }
+    return true;
+}
+
+bool GSDumpReader::read_message(GSMessage& message)
+{
+    if (legacy)
+    {
+        file.read((char*)&message, sizeof(message));
+        if (file.gcount() != sizeof(message))
+            return false;
+    }
+    else
+    {
+        while (current_pos >= current.data.size())
+        {
+            if (!next_block())
+                return false;
+        }
+
+        const uint8_t* start = current.data.data();
+        const uint8_t* p = start + current_pos;
+        if (!decode_message(p, start + current.data.size(), message))
+        {
+            Errors::print_warning("gsdump message block at %llu is corrupt", (unsigned long long)current.offset);
+            current.end = true;
+            return false;
+        }
+        current_pos = p - start;
+    }
+
+    switch (message.type)
+    {
+        case render_crt_t:
+            current_frame++;
+            //fallthrough
+        case memdump_t:
+            message.payload.render_payload.frames = nullptr;
+            break;
+        case save_state_t:
+            message.payload.save_state_payload.state = nullptr;
+            break;
+        case load_state_t:
+            message.payload.load_state_payload.state = nullptr;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
@@ -0,0 +1,142 @@
+#ifndef GSDUMP_HPP
+#define GSDUMP_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "gsthread.hpp"
+
+class GraphicsSynthesizer;
+
+/**
+  * gsdump container
+  *
+  * Header: "DOBIEGSD", u32 version, u32 reserved, u64 index offset (0 if the recording was never closed)
+  *
+  * The rest of the file is a sequence of blocks, each a u8 type, u32 compressed size, u32 raw size and
+  * raw deflate data.
+  *   - Message blocks hold variable-length encoded GSMessages. A message never straddles two blocks.
+  *   - State blocks hold a GS snapshot: the GS thread's state followed by the GS_REGISTERS for the main thread.
+  *     The first block is always a state block, and another one is written every keyframe interval.
+  *
+  * Index: u32 frame count, per frame {u64 block offset, u32 offset into the raw block},
+  *        u32 keyframe count, per keyframe {u32 frame, u64 block offset}
+  *
+  * A frame ends with its render_crt_t message.
+  * Dumps written before this container existed (raw GSMessage structs) can still be replayed linearly.
+  */
+
+struct GSDumpFrame
+{
+    uint64_t block_offset;
+    uint32_t offset;
+};
+
+struct GSDumpKeyframe
+{
+    uint32_t frame;
+    uint64_t block_offset;
+};
+
+enum GSDumpBlockType : uint8_t
+{
+    GSDUMP_MESSAGES,
+    GSDUMP_STATE
+};
+
+class GSDumpWriter
+{
+    private:
+        std::ofstream file;
+        std::vector<uint8_t> block;
+        std::vector<uint8_t> compressed;
+        struct libdeflate_compressor* compressor;
+
+        std::vector<GSDumpFrame> frames;
+        std::vector<GSDumpKeyframe> keyframes;
+        uint32_t keyframe_interval;
+        bool in_frame;
+
+        void write_block(GSDumpBlockType type, const uint8_t* data, size_t size);
+        void flush_block();
+        void write_index();
+    public:
+        constexpr static uint32_t DEFAULT_KEYFRAME_INTERVAL = 300;
+
+        GSDumpWriter();
+        ~GSDumpWriter();
+
+        bool open(const std::string& name, uint32_t keyframe_interval = DEFAULT_KEYFRAME_INTERVAL);
+        void close();
+        bool is_open() const;
+
+        void write_message(const GSMessage& message);
+
+        //True between frames once keyframe_interval frames have passed since the last keyframe
+        bool needs_keyframe() const;
+        void write_keyframe(const std::string& state);
+};
+
+class GSDumpReader
+{
+    private:
+        struct Block
+        {
+            uint64_t offset;
+            std::vector<uint8_t> data;
+            bool end;
+        };
+
+        constexpr static size_t MAX_QUEUED_BLOCKS = 8;
+
+        std::ifstream file;
+        uint64_t data_end;
+        bool legacy;
+        std::vector<GSDumpFrame> frames;
+        std::vector<GSDumpKeyframe> keyframes;
+
+        //Blocks are read and inflated ahead of playback on a worker thread
+        std::thread worker;
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        std::deque<Block> queue;
+        uint64_t worker_offset;
+        bool worker_stop;
+
+        Block current;
+        size_t current_pos;
+        uint32_t current_frame;
+
+        bool read_block(uint64_t& offset, GSDumpBlockType& type, std::vector<uint8_t>& data,
+                        struct libdeflate_decompressor* decompressor);
+        bool read_index(uint64_t index_offset);
+        bool build_index();
+        void start_worker(uint64_t offset);
+        void stop_worker();
+        void worker_loop();
+        bool next_block();
+    public:
+        GSDumpReader();
+        ~GSDumpReader();
+
+        bool open(const std::string& name);
+        void close();
+        bool is_open() const;
+        bool is_legacy() const;
+
+        uint32_t get_frame_count() const;
+        uint32_t get_current_frame() const;
+
+        //Loads the closest keyframe at or before frame into the GS and continues reading from there.
+        //The caller replays up to the frame it wants; get_current_frame says where playback is.
+        bool seek(uint32_t frame, GraphicsSynthesizer& gs);
+
+        //Pointer payloads (output frames, state streams) are cleared, as they only meant something to the recorder
+        bool read_message(GSMessage& message);
+};
+
+#endif // GSDUMP_HPP
@@ -333,6 +333,20 @@ void GS_REGISTERS::get_resolution(int &w, int &h)
     h = 480;
 }
 
+double GS_REGISTERS::get_refresh_rate()
+{
+    //Fields per second for the video mode chosen through SetGsCrt
+    switch (CRT_mode)
+    {
+        case 0x2:
+            return 59.94;
+        case 0x3:
+            return 50.0;
+        default:
+            return 60.0;
+    }
+}
+
 void GS_REGISTERS::get_inner_resolution(int &w, int &h)
 {
     DISPLAY &current_display = DISPLAY1;
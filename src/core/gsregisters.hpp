@@ -103,6 +103,7 @@ struct GS_REGISTERS
     void set_CRT(bool interlaced, int mode, bool frame_mode);
     void get_resolution(int &w, int &h);
     void get_inner_resolution(int &w, int &h);
+    double get_refresh_rate();
     void set_VBLANK(bool is_VBLANK);
     bool assert_FINISH();
     bool assert_VSYNC();
@@ -2,10 +2,16 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <chrono>
 #include <cmath>
 #include <fstream>
+#include <sstream>
+#include <emmintrin.h>
 
 #include "gsthread.hpp"
+#include "gsdump.hpp"
+#include "profiler.hpp"
+#include "jitcommon/jitsymbols.hpp"
 #include "gsmem.hpp"
 #include "errors.hpp"
 
@@ -147,6 +153,10 @@ GraphicsSynthesizerThread::GraphicsSynthesizerThread()
     jit_draw_pixel_heap.flush_all_blocks();
     jit_tex_lookup_heap.flush_all_blocks();
 
+    pixel_jit_enabled = true;
+    use_pixel_jit = true;
+    collect_stats = false;
+
     thread = std::thread(&GraphicsSynthesizerThread::event_loop, this);
 }
 
@@ -217,6 +227,11 @@ void GraphicsSynthesizerThread::wake_thread()
     notifier.notify_one();
 }
 
+void GraphicsSynthesizerThread::set_pixel_jit(bool enabled)
+{
+    pixel_jit_enabled = enabled;
+}
+
 void GraphicsSynthesizerThread::reset_fifos()
 {
     if (!message_queue)
@@ -250,8 +265,11 @@ void GraphicsSynthesizerThread::event_loop()
 
     reset();
 
-    bool gsdump_recording = false;
-    ofstream gsdump_file;
+    GSDumpWriter gsdump;
+
+    //Busy time is only counted between waking up and going back to sleep
+    auto busy_start = chrono::steady_clock::now();
+    chrono::duration<float, milli> frame_busy(0);
 
     try
     {
@@ -261,8 +279,15 @@ void GraphicsSynthesizerThread::event_loop()
 
             if (message_queue->pop(data))
             {
-                if (gsdump_recording)
-                    gsdump_file.write((char*)&data, sizeof(data));
+                stats.messages++;
+                if (gsdump.is_open())
+                    gsdump.write_message(data);
+
+                //Anything other than more transfer data may look at local memory, so settle the transfer buffer first
+                if (data.type != request_local_host_tx)
+                    readback_size = readback_pos = 0;
+                if (hwreg_staged && (data.type != write64_t || data.payload.write64_payload.addr != 0x54))
+                    flush_HWREG_staging();
 
                 switch (data.type)
                 {
@@ -323,15 +348,24 @@ void GraphicsSynthesizerThread::event_loop()
                     }
                     case render_crt_t:
                     {
+                        //No output frames means the frame boundary is still wanted but the CRT output isn't
                         auto p = data.payload.render_payload;
-
-                        while (!p.target_mutex->try_lock())
+                        if (p.frames)
                         {
-                            printf("[GS_t] buffer lock failed!\n");
-                            std::this_thread::yield();
+                            int width, height;
+                            render_CRT(p.frames->get_back());
+                            reg.get_inner_resolution(width, height);
+                            p.frames->publish(width, height);
                         }
-                        std::lock_guard<std::mutex> lock(*p.target_mutex, std::adopt_lock);
-                        render_CRT(p.target);
+
+                        auto now = chrono::steady_clock::now();
+                        Profiler::add_gs_time(chrono::duration_cast<chrono::nanoseconds>(now - busy_start).count(), 0);
+                        frame_busy += now - busy_start;
+                        busy_start = now;
+                        if (collect_stats)
+                            stats.frame_times_ms.push_back(frame_busy.count());
+                        frame_busy = frame_busy.zero();
+
                         GSReturnMessagePayload return_payload;
                         return_payload.no_payload = { 0 };
                         return_queue->push({ GSReturn::render_complete_t,return_payload });
@@ -355,15 +389,9 @@ void GraphicsSynthesizerThread::event_loop()
                     case memdump_t:
                     {
                         auto p = data.payload.render_payload;
-
-                        while (!p.target_mutex->try_lock())
-                        {
-                            printf("[GS_t] buffer lock failed!\n");
-                            std::this_thread::yield();
-                        }
-                        std::lock_guard<std::mutex> lock(*p.target_mutex, std::adopt_lock);
                         uint16_t width, height;
-                        memdump(p.target, width, height);
+                        memdump(p.frames->get_back(), width, height);
+                        p.frames->publish(width, height);
                         GSReturnMessagePayload return_payload;
                         return_payload.xy_payload = { width, height };
                         return_queue->push({ GSReturn::gsdump_render_partial_done_t,return_payload });
@@ -398,24 +426,40 @@ void GraphicsSynthesizerThread::event_loop()
                     case gsdump_t:
                     {
                         printf("gs dump! ");
-                        if (!gsdump_recording)
+                        if (!gsdump.is_open())
                         {
                             printf("(start)\n");
-                            gsdump_file.open("gsdump.gsd", ios::out | ios::binary);
-                            if (!gsdump_file.is_open())
+                            if (!gsdump.open("gsdump.gsd"))
                                 Errors::die("gs dump file failed to open");
-                            gsdump_recording = true;
-                            save_state(&gsdump_file);
-                            gsdump_file.write((char*)&reg, sizeof(reg));//this is for the emuthread's gs faker
                         }
                         else
                         {
                             printf("(end)\n");
-                            gsdump_file.close();
-                            gsdump_recording = false;
+                            gsdump.close();
                         }
                         break;
                     }
+                    case stats_t:
+                    {
+                        //Hand over the counters and start a fresh measurement. The request itself isn't counted.
+                        stats.messages--;
+                        *data.payload.stats_payload.stats = stats;
+                        stats.messages = 0;
+                        stats.prims = 0;
+                        stats.pixels = 0;
+                        stats.frame_times_ms.clear();
+                        collect_stats = true;
+                        frame_busy = frame_busy.zero();
+                        busy_start = chrono::steady_clock::now();
+
+                        GSReturnMessagePayload return_payload;
+                        return_payload.no_payload = { 0 };
+                        return_queue->push({ GSReturn::stats_done_t, return_payload });
+                        std::unique_lock<std::mutex> lk(data_mutex);
+                        recieve_data = true;
+                        notifier.notify_one();
+                        break;
+                    }
                     case request_local_host_tx:
                     {
                         GSReturnMessagePayload return_payload;
@@ -430,13 +474,28 @@ void GraphicsSynthesizerThread::event_loop()
                     default:
                         Errors::die("corrupted command sent to GS thread");
                 }
+
+                //Snapshot the GS between frames so replay can seek without starting from the beginning
+                if (gsdump.is_open() && gsdump.needs_keyframe())
+                {
+                    ostringstream state;
+                    save_state(&state);
+                    state.write((char*)&reg, sizeof(reg));//this is for the emuthread's gs faker
+                    gsdump.write_keyframe(state.str());
+                }
             }
             else
             {
                 printf("GS Thread: No messages waiting, going to sleep\n");
+                auto sleep_start = chrono::steady_clock::now();
+                frame_busy += sleep_start - busy_start;
                 std::unique_lock<std::mutex> lk(data_mutex);
                 notifier.wait(lk, [this] {return send_data;});
                 send_data = false;
+                auto wake = chrono::steady_clock::now();
+                Profiler::add_gs_time(chrono::duration_cast<chrono::nanoseconds>(sleep_start - busy_start).count(),
+                                      chrono::duration_cast<chrono::nanoseconds>(wake - sleep_start).count());
+                busy_start = wake;
             }
         }
     }
@@ -458,6 +517,10 @@ void GraphicsSynthesizerThread::reset()
         local_mem = new uint8_t[1024 * 1024 * 4];
 
     pixels_transferred = 0;
+    hwreg_staged = 0;
+    hwreg_band_size = 0;
+    readback_size = 0;
+    readback_pos = 0;
     num_vertices = 0;
     frame_count = 0;
     reg.deinterlace_method = BOB_DEINTERLACE;
@@ -474,11 +537,17 @@ void GraphicsSynthesizerThread::reset()
     PRIM.reset();
     PRMODE.reset();
 
+    stats.messages = 0;
+    stats.prims = 0;
+    stats.pixels = 0;
+    stats.frame_times_ms.clear();
+
     jit_draw_pixel_func = nullptr;
     jit_tex_lookup_func = nullptr;
     jit_draw_pixel_prologue = nullptr;
     jit_tex_lookup_prologue = nullptr;
 
+    Profiler::add_jit_flush(Profiler::JIT_GS);
     jit_tex_lookup_heap.flush_all_blocks();
     jit_draw_pixel_heap.flush_all_blocks();
 
@@ -528,23 +597,176 @@ uint16_t convert_color_down(uint32_t col)
     return (r | (g << 5) | (b << 10) | (a << 15));
 }
 
-uint32_t GraphicsSynthesizerThread::get_CRT_color(DISPFB &dispfb, uint32_t x, uint32_t y)
+//Reads one scanline of a display framebuffer as RGBA32.
+//Each block the line passes through is addressed once, then its row is read out with the column table.
+void GraphicsSynthesizerThread::read_CRT_row(DISPFB &dispfb, uint32_t x, uint32_t y, int width, uint32_t* out)
 {
+    uint32_t block = dispfb.frame_base / 64;
+    uint32_t buffer_width = dispfb.width / 64;
+    int i = 0;
     switch (dispfb.format)
     {
         case 0x0:
-            return read_PSMCT32_block(dispfb.frame_base * 4, dispfb.width, x, y);
-        case 0x1://PSMCT24
-            return (read_PSMCT32_block(dispfb.frame_base * 4, dispfb.width, x, y) & 0xFFFFFF) | (1 << 31);
+        case 0x1:
+        {
+            const uint8_t* column = columnTable32[y & 0x7];
+            while (i < width)
+            {
+                uint32_t block_x = (x + i) & ~0x7;
+                uint32_t* data = (uint32_t*)&local_mem[addr_PSMCT32(block, buffer_width, block_x, y & ~0x7)];
+                for (uint32_t col = (x + i) & 0x7; col < 8 && i < width; col++, i++)
+                    out[i] = data[column[col]];
+            }
+
+            if (dispfb.format == 0x1)
+            {
+                //PSMCT24 has no alpha, so treat it as fully opaque
+                __m128i rgb_mask = _mm_set1_epi32(0xFFFFFF);
+                __m128i alpha = _mm_set1_epi32((int)0x80000000);
+                for (i = 0; i + 4 <= width; i += 4)
+                {
+                    __m128i color = _mm_loadu_si128((__m128i*)&out[i]);
+                    color = _mm_or_si128(_mm_and_si128(color, rgb_mask), alpha);
+                    _mm_storeu_si128((__m128i*)&out[i], color);
+                }
+                for (; i < width; i++)
+                    out[i] = (out[i] & 0xFFFFFF) | (1 << 31);
+            }
+            break;
+        }
         case 0x2:
-            return convert_color_up(read_PSMCT16_block(dispfb.frame_base * 4, dispfb.width, x, y));
         case 0xA:
-            return convert_color_up(read_PSMCT16S_block(dispfb.frame_base * 4, dispfb.width, x, y));
+        {
+            //Gather the raw 16-bit pixels into the upper half of the output, then expand them in place
+            uint16_t* raw = (uint16_t*)&out[width] - width;
+            const uint8_t* column = columnTable16[y & 0x7];
+            while (i < width)
+            {
+                uint32_t block_x = (x + i) & ~0xF;
+                uint32_t addr;
+                if (dispfb.format == 0x2)
+                    addr = addr_PSMCT16(block, buffer_width, block_x, y & ~0x7);
+                else
+                    addr = addr_PSMCT16S(block, buffer_width, block_x, y & ~0x7);
+                uint16_t* data = (uint16_t*)&local_mem[addr];
+                for (uint32_t col = (x + i) & 0xF; col < 16 && i < width; col++, i++)
+                    raw[i] = data[column[col]];
+            }
+
+            __m128i five_bits = _mm_set1_epi32(0x1F);
+            __m128i zero = _mm_setzero_si128();
+            for (i = 0; i + 4 <= width; i += 4)
+            {
+                __m128i color = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)&raw[i]), zero);
+                __m128i r = _mm_slli_epi32(_mm_and_si128(color, five_bits), 3);
+                __m128i g = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(color, 5), five_bits), 11);
+                __m128i b = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(color, 10), five_bits), 19);
+                __m128i a = _mm_slli_epi32(_mm_srli_epi32(color, 15), 31);
+                color = _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, a));
+                _mm_storeu_si128((__m128i*)&out[i], color);
+            }
+            for (; i < width; i++)
+                out[i] = convert_color_up(raw[i]);
+            break;
+        }
         default:
             Errors::die("Unknown framebuffer format (%x)", dispfb.format);
     }
 }
 
+//Blends the two read circuits together and forces the result to be opaque
+static void merge_CRT_row(const uint32_t* row1, const uint32_t* row2, uint32_t* out, int width,
+                          bool use_circuit1, bool use_ALP, uint8_t ALP)
+{
+    __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    int x = 0;
+
+    //If Circuit 1 is disabled, we can skip alpha blending on Circuit 2
+    //Some games (like Devil May Cry) will use Circuit 2 with an ALP of 255, making it effectively blank.
+    //However we think that on real hardware it will either skip the blending or duplicate Circuit 2 in the Circuit 1 output
+    //which effectively means output2 is outputted at full alpha
+    //Downhill Domination also has a dark screen if you do not follow this behaviour.  ALP 128 only circuit 2
+    if (!use_circuit1)
+    {
+        for (; x + 4 <= width; x += 4)
+        {
+            __m128i color = _mm_loadu_si128((__m128i*)&row2[x]);
+            _mm_storeu_si128((__m128i*)&out[x], _mm_or_si128(color, opaque));
+        }
+        for (; x < width; x++)
+            out[x] = row2[x] | 0xFF000000;
+        return;
+    }
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i max_alpha = _mm_set1_epi16(0xFF);
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i color1 = _mm_loadu_si128((__m128i*)&row1[x]);
+        __m128i color2 = _mm_loadu_si128((__m128i*)&row2[x]);
+
+        //Alpha for each pixel, broadcast to the four 16-bit channel lanes
+        __m128i alpha_lo, alpha_hi;
+        if (use_ALP)
+            alpha_lo = alpha_hi = _mm_set1_epi16(ALP);
+        else
+        {
+            __m128i alpha = _mm_slli_epi32(_mm_srli_epi32(color1, 24), 1);
+            alpha = _mm_min_epi16(alpha, _mm_set1_epi32(0xFF));
+            alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+            alpha_lo = _mm_unpacklo_epi32(alpha, alpha);
+            alpha_hi = _mm_unpackhi_epi32(alpha, alpha);
+        }
+
+        __m128i lo = _mm_add_epi16(
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(color1, zero), alpha_lo),
+                    _mm_mullo_epi16(_mm_unpacklo_epi8(color2, zero), _mm_sub_epi16(max_alpha, alpha_lo)));
+        __m128i hi = _mm_add_epi16(
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(color1, zero), alpha_hi),
+                    _mm_mullo_epi16(_mm_unpackhi_epi8(color2, zero), _mm_sub_epi16(max_alpha, alpha_hi)));
+        __m128i color = _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+        _mm_storeu_si128((__m128i*)&out[x], _mm_or_si128(color, opaque));
+    }
+
+    for (; x < width; x++)
+    {
+        uint32_t alpha = use_ALP ? ALP : (row1[x] >> 24) * 2;
+        if (alpha > 0xFF)
+            alpha = 0xFF;
+
+        uint32_t color = 0xFF000000;
+        for (int shift = 0; shift < 24; shift += 8)
+        {
+            uint32_t c1 = (row1[x] >> shift) & 0xFF;
+            uint32_t c2 = (row2[x] >> shift) & 0xFF;
+            color |= (((c1 * alpha) + (c2 * (0xFF - alpha))) >> 8) << shift;
+        }
+        out[x] = color;
+    }
+}
+
+//Averages two scanlines channel by channel, rounding down. The result is opaque.
+static void average_CRT_row(const uint32_t* row1, const uint32_t* row2, uint32_t* out, int width)
+{
+    __m128i low_bits = _mm_set1_epi8(0x7F);
+    __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i a = _mm_loadu_si128((__m128i*)&row1[x]);
+        __m128i b = _mm_loadu_si128((__m128i*)&row2[x]);
+        __m128i half_diff = _mm_and_si128(_mm_srli_epi16(_mm_xor_si128(a, b), 1), low_bits);
+        __m128i color = _mm_add_epi8(_mm_and_si128(a, b), half_diff);
+        _mm_storeu_si128((__m128i*)&out[x], _mm_or_si128(color, opaque));
+    }
+
+    for (; x < width; x++)
+    {
+        uint32_t a = row1[x], b = row2[x];
+        out[x] = ((a & b) + (((a ^ b) >> 1) & 0x7F7F7F7F)) | 0xFF000000;
+    }
+}
+
 void GraphicsSynthesizerThread::render_CRT(uint32_t* target)
 {
     int width;
@@ -602,6 +824,11 @@ void GraphicsSynthesizerThread::render_CRT(uint32_t* target)
         }
     }
 
+    uint32_t row1[2048];
+    uint32_t row2[2048];
+    uint32_t final_row[2048];
+    width = min(width, 2048);
+
     for (int y = start_scanline; y <= height; y += y_increment)
     {
         if (reg.SMODE2.interlaced)
@@ -610,167 +837,63 @@ void GraphicsSynthesizerThread::render_CRT(uint32_t* target)
             if (y == 0)
                 continue;
         }
-        for (int x = 0; x < width; x++)
-        {
-            int pixel_x = x;
-            int pixel_y = y;
-
-            uint32_t scaled_x1 = reg.DISPFB1.x + x;
-            uint32_t scaled_x2 = reg.DISPFB2.x + x;
-            uint32_t scaled_y1 = reg.DISPFB1.y + fb_y;
-            uint32_t scaled_y2 = reg.DISPFB2.y + fb_y;
-
-            uint32_t output1 = reg.PMODE.circuit1 ? get_CRT_color(reg.DISPFB1, scaled_x1, scaled_y1) : 0;
-            uint32_t output2 = reg.PMODE.circuit2 ? get_CRT_color(reg.DISPFB2, scaled_x2, scaled_y2) : reg.BGCOLOR;
-
-            if (reg.PMODE.blend_with_bg)
-                output2 = reg.BGCOLOR;
-
-            uint32_t r, g, b;
-            uint32_t r1, g1, b1, r2, g2, b2;
-            uint32_t final_color;
-
-            //If Circuit 1 is disabled, we can skip alpha blending on Circuit 2
-            //Some games (like Devil May Cry) will use Circuit 2 with an ALP of 255, making it effectively blank.
-            //However we think that on real hardware it will either skip the blending or duplicate Circuit 2 in the Circuit 1 output
-            //which effectively means output2 is outputted at full alpha
-            //Downhill Domination also has a dark screen if you do not follow this behaviour.  ALP 128 only circuit 2
-            if (reg.PMODE.circuit1)
-            {
-                uint32_t alpha;
-
-                if (reg.PMODE.use_ALP)
-                    alpha = reg.PMODE.ALP;
-                else
-                    alpha = (output1 >> 24) * 2;
-
-                if (alpha > 0xFF)
-                    alpha = 0xFF;
 
-                r1 = output1 & 0xFF; r2 = output2 & 0xFF;
-                g1 = (output1 >> 8) & 0xFF; g2 = (output2 >> 8) & 0xFF;
-                b1 = (output1 >> 16) & 0xFF; b2 = (output2 >> 16) & 0xFF;
+        if (reg.PMODE.circuit1)
+            read_CRT_row(reg.DISPFB1, reg.DISPFB1.x, reg.DISPFB1.y + fb_y, width, row1);
 
-                r = ((r1 * alpha) + (r2 * (0xFF - alpha))) >> 8;
-                if (r > 0xFF)
-                    r = 0xFF;
+        if (reg.PMODE.circuit2 && !reg.PMODE.blend_with_bg)
+            read_CRT_row(reg.DISPFB2, reg.DISPFB2.x, reg.DISPFB2.y + fb_y, width, row2);
+        else
+            std::fill(row2, row2 + width, reg.BGCOLOR);
 
-                g = ((g1 * alpha) + (g2 * (0xFF - alpha))) >> 8;
-                if (g > 0xFF)
-                    g = 0xFF;
+        merge_CRT_row(row1, row2, final_row, width, reg.PMODE.circuit1, reg.PMODE.use_ALP, reg.PMODE.ALP);
 
-                b = ((b1 * alpha) + (b2 * (0xFF - alpha))) >> 8;
-                if (b > 0xFF)
-                    b = 0xFF;
-            }
-            else
-            {
-                r = output2 & 0xFF;
-                g = (output2 >> 8) & 0xFF;
-                b = (output2 >> 16) & 0xFF;
-            }
-
-            final_color = 0xFF000000 | r | (g << 8) | (b << 16);
+        uint32_t* line = &target[y * width];
+        uint32_t* screen_line = &screen_buffer[y * width];
+        if (!reg.SMODE2.interlaced)
+        {
+            memcpy(line, final_row, width * sizeof(uint32_t));
+            fb_y += frame_line_increment;
+            continue;
+        }
 
-            if (reg.SMODE2.interlaced)
-            {
-                switch (reg.deinterlace_method)
+        //Weave (no deinterlacing), merge field and blend scanline keep the other field from the previous frame
+        //in screen_buffer and show it alongside the new one. Bob doubles up the current field instead.
+        switch (reg.deinterlace_method)
+        {
+            case MERGE_FIELD_DEINTERLACE:
+                if (!reg.CSR.is_odd_frame)
+                    average_CRT_row(final_row, screen_line + width, screen_line, width);
+                else
+                    average_CRT_row(final_row, screen_line - width, screen_line, width);
+                memcpy(line, screen_line, width * sizeof(uint32_t));
+                break;
+            case BLEND_SCANLINE_DEINTERLACE:
+                average_CRT_row(final_row, screen_line, screen_line, width);
+                memcpy(line, screen_line, width * sizeof(uint32_t));
+                break;
+            case BOB_DEINTERLACE:
+                if (reg.SMODE2.frame_mode)
                 {
-                    case MERGE_FIELD_DEINTERLACE:
-                    {
-                        if (!reg.CSR.is_odd_frame)
-                        {
-                            screen_buffer[pixel_x + (pixel_y * width)] = final_color;
-
-                            r1 = r; r2 = screen_buffer[pixel_x + ((pixel_y + 1) * width)] & 0xFF;
-                            g1 = g; g2 = (screen_buffer[pixel_x + ((pixel_y + 1) * width)] >> 8) & 0xFF;
-                            b1 = b; b2 = (screen_buffer[pixel_x + ((pixel_y + 1) * width)] >> 16) & 0xFF;
-
-                            r = (r1 + r2) >> 1;
-                            g = (g1 + g2) >> 1;
-                            b = (b1 + b2) >> 1;
-
-                            screen_buffer[pixel_x + (pixel_y * width)] = 0xFF000000 | r | (g << 8) | (b << 16);
-                        }
-                        else
-                        {
-                            screen_buffer[pixel_x + (pixel_y * width)] = final_color;
-
-                            r1 = r; r2 = screen_buffer[pixel_x + ((pixel_y - 1) * width)] & 0xFF;
-                            g1 = g; g2 = (screen_buffer[pixel_x + ((pixel_y - 1) * width)] >> 8) & 0xFF;
-                            b1 = b; b2 = (screen_buffer[pixel_x + ((pixel_y - 1) * width)] >> 16) & 0xFF;
-
-                            r = (r1 + r2) >> 1;
-                            g = (g1 + g2) >> 1;
-                            b = (b1 + b2) >> 1;
-
-                            screen_buffer[pixel_x + (pixel_y * width)] = 0xFF000000 | r | (g << 8) | (b << 16);
-                        }
-
-                        target[pixel_x + (pixel_y * width)] = screen_buffer[pixel_x + (pixel_y * width)];
-
-                        if (!reg.CSR.is_odd_frame)
-                            target[pixel_x + ((pixel_y + 1) * width)] = screen_buffer[pixel_x + ((pixel_y + 1) * width)];
-                        else if (pixel_y > 0)
-                            target[pixel_x + ((pixel_y - 1) * width)] = screen_buffer[pixel_x + ((pixel_y - 1) * width)];
-                        break;
-                    }
-                    case BLEND_SCANLINE_DEINTERLACE:
-                    {
-                        r1 = r; r2 = screen_buffer[pixel_x + ((pixel_y)* width)] & 0xFF;
-                        g1 = g; g2 = (screen_buffer[pixel_x + ((pixel_y)* width)] >> 8) & 0xFF;
-                        b1 = b; b2 = (screen_buffer[pixel_x + ((pixel_y)* width)] >> 16) & 0xFF;
-
-                        r = (r1 + r2) >> 1;
-                        g = (g1 + g2) >> 1;
-                        b = (b1 + b2) >> 1;
-
-                        final_color = 0xFF000000 | r | (g << 8) | (b << 16);
-
-                        screen_buffer[pixel_x + (pixel_y * width)] = final_color;
-                        target[pixel_x + (pixel_y * width)] = final_color;
-
-                        if (!reg.CSR.is_odd_frame)
-                            target[pixel_x + ((pixel_y + 1) * width)] = screen_buffer[pixel_x + ((pixel_y + 1) * width)];
-                        else if (pixel_y > 0)
-                            target[pixel_x + ((pixel_y - 1) * width)] = screen_buffer[pixel_x + ((pixel_y - 1) * width)];
-                        break;
-                    }
-                    case BOB_DEINTERLACE:
-                    {
-                        if (reg.SMODE2.frame_mode)
-                        {
-                            pixel_y *= 2;
-                            target[pixel_x + (pixel_y * width)] = final_color;
-                            target[pixel_x + ((pixel_y + 1)* width)] = final_color;
-                        }
-                        else
-                        {
-                            target[pixel_x + (pixel_y * width)] = final_color;
-                        }
-                        break;
-                    }
-                    default: //No Deinterlacing
-                    {
-                        screen_buffer[pixel_x + (pixel_y * width)] = final_color;
-
-                        target[pixel_x + (pixel_y * width)] = final_color;
-
-                        if (reg.SMODE2.interlaced)
-                        {
-                            if (!reg.CSR.is_odd_frame)
-                                target[pixel_x + ((pixel_y + 1) * width)] = screen_buffer[pixel_x + ((pixel_y + 1) * width)];
-                            else if (pixel_y > 0)
-                                target[pixel_x + ((pixel_y - 1) * width)] = screen_buffer[pixel_x + ((pixel_y - 1) * width)];
-                        }
-                        break;
-                    }
+                    line = &target[y * 2 * width];
+                    memcpy(line, final_row, width * sizeof(uint32_t));
+                    memcpy(line + width, final_row, width * sizeof(uint32_t));
                 }
-            }
-            else
-            {
-                target[pixel_x + (pixel_y * width)] = final_color;
-            }
+                else
+                    memcpy(line, final_row, width * sizeof(uint32_t));
+                break;
+            default:
+                memcpy(screen_line, final_row, width * sizeof(uint32_t));
+                memcpy(line, final_row, width * sizeof(uint32_t));
+                break;
+        }
+
+        if (reg.deinterlace_method != BOB_DEINTERLACE)
+        {
+            if (!reg.CSR.is_odd_frame)
+                memcpy(line + width, screen_line + width, width * sizeof(uint32_t));
+            else if (y > 0)
+                memcpy(line - width, screen_line - width, width * sizeof(uint32_t));
         }
         fb_y += frame_line_increment;
     }
@@ -1296,101 +1419,700 @@ uint16_t GraphicsSynthesizerThread::read_PSMCT16_block(uint32_t base, uint32_t w
     return *(uint16_t*)&local_mem[addr];
 }
 
-uint16_t GraphicsSynthesizerThread::read_PSMCT16S_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+uint16_t GraphicsSynthesizerThread::read_PSMCT16S_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+{
+    uint32_t addr = addr_PSMCT16S(base / 256, width / 64, x, y);
+    return *(uint16_t*)&local_mem[addr];
+}
+
+uint16_t GraphicsSynthesizerThread::read_PSMCT16Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+{
+    uint32_t addr = addr_PSMCT16Z(base / 256, width / 64, x, y);
+    return *(uint16_t*)&local_mem[addr];
+}
+
+uint16_t GraphicsSynthesizerThread::read_PSMCT16SZ_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+{
+    uint32_t addr = addr_PSMCT16SZ(base / 256, width / 64, x, y);
+    return *(uint16_t*)&local_mem[addr];
+}
+
+uint8_t GraphicsSynthesizerThread::read_PSMCT8_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+{
+    uint32_t addr = addr_PSMCT8(base / 256, width / 64, x, y);
+    return local_mem[addr];
+}
+
+uint8_t GraphicsSynthesizerThread::read_PSMCT4_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+{
+    uint32_t addr = addr_PSMCT4(base / 256, width / 64, x, y);
+    return (local_mem[addr >> 1] >> ((addr & 1) << 2)) & 0x0f;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT32_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
+{
+    uint32_t addr = addr_PSMCT32(base / 256, width / 64, x, y);
+    *(uint32_t*)&local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT32Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
+{
+    uint32_t addr = addr_PSMCT32Z(base / 256, width / 64, x, y);
+    *(uint32_t*)&local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT24_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
+{
+    uint32_t addr = addr_PSMCT32(base / 256, width / 64, x, y);
+    uint32_t old_mem = *(uint32_t*)&local_mem[addr];
+    value &= 0xFFFFFF;
+    *(uint32_t*)&local_mem[addr] = (old_mem & 0xFF000000) | value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT24Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
+{
+    uint32_t addr = addr_PSMCT32Z(base / 256, width / 64, x, y);
+    uint32_t old_mem = *(uint32_t*)&local_mem[addr];
+    value &= 0xFFFFFF;
+    *(uint32_t*)&local_mem[addr] = (old_mem & 0xFF000000) | value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT16_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+{
+    uint32_t addr = addr_PSMCT16(base / 256, width / 64, x, y);
+    *(uint16_t*)&local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT16S_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+{
+    uint32_t addr = addr_PSMCT16S(base / 256, width / 64, x, y);
+    *(uint16_t*)&local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT16Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+{
+    uint32_t addr = addr_PSMCT16Z(base / 256, width / 64, x, y);
+    *(uint16_t*)&local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT16SZ_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+{
+    uint32_t addr = addr_PSMCT16SZ(base / 256, width / 64, x, y);
+    *(uint16_t*)&local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT8_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint8_t value)
+{
+    uint32_t addr = addr_PSMCT8(base / 256, width / 64, x, y);
+    local_mem[addr] = value;
+}
+
+void GraphicsSynthesizerThread::write_PSMCT4_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint8_t value)
+{
+    uint32_t addr = addr_PSMCT4(base / 256, width / 64, x, y);
+    int shift = (addr & 1) << 2;
+    addr >>= 1;
+
+    local_mem[addr] = (uint8_t)((local_mem[addr] & (0xf0 >> shift)) | ((value & 0x0f) << shift));
+}
+
+/**
+  * Bulk transfer kernels
+  * Host-side image data is linear, with pixels packed at the bit depth of the transfer format.
+  * Rectangles are split into their block-aligned interior, which is (un)swizzled a whole 256-byte block at a time
+  * with a single address lookup, and the unaligned edges, which go through the per-pixel routines above.
+  */
+
+static int transfer_bpp(uint8_t format)
+{
+    switch (format)
+    {
+        case 0x00: //PSMCT32
+        case 0x30: //PSMZ32
+            return 32;
+        case 0x01: //PSMCT24
+        case 0x31: //PSMZ24
+            return 24;
+        case 0x02: //PSMCT16
+        case 0x0A: //PSMCT16S
+        case 0x32: //PSMZ16
+        case 0x3A: //PSMZ16S
+            return 16;
+        case 0x13: //PSMT8
+        case 0x1B: //PSMT8H
+            return 8;
+        case 0x14: //PSMT4
+        case 0x24: //PSMT4HL
+        case 0x2C: //PSMT4HH
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static void transfer_block_size(uint8_t format, uint32_t& width, uint32_t& height)
+{
+    switch (format)
+    {
+        case 0x02:
+        case 0x0A:
+        case 0x32:
+        case 0x3A:
+            width = 16;
+            height = 8;
+            break;
+        case 0x13:
+            width = 16;
+            height = 16;
+            break;
+        case 0x14:
+            width = 32;
+            height = 16;
+            break;
+        default:
+            //Everything else, including PSMT8H/PSMT4HL/PSMT4HH, uses the PSMCT32 layout
+            width = 8;
+            height = 8;
+            break;
+    }
+}
+
+//Returns the offset in local memory of the start of the block holding (x, y)
+static uint32_t transfer_block_addr(uint8_t format, uint32_t base, uint32_t width, uint32_t x, uint32_t y)
+{
+    switch (format)
+    {
+        case 0x02:
+            return addr_PSMCT16(base / 256, width / 64, x, y);
+        case 0x0A:
+            return addr_PSMCT16S(base / 256, width / 64, x, y);
+        case 0x13:
+            return addr_PSMCT8(base / 256, width / 64, x, y);
+        case 0x14:
+            return addr_PSMCT4(base / 256, width / 64, x, y) >> 1;
+        case 0x30:
+        case 0x31:
+            return addr_PSMCT32Z(base / 256, width / 64, x, y);
+        case 0x32:
+            return addr_PSMCT16Z(base / 256, width / 64, x, y);
+        case 0x3A:
+            return addr_PSMCT16SZ(base / 256, width / 64, x, y);
+        default:
+            return addr_PSMCT32(base / 256, width / 64, x, y);
+    }
+}
+
+static inline uint32_t read_linear_pixel(const uint8_t* row, uint32_t x, int bpp)
+{
+    switch (bpp)
+    {
+        case 32:
+            return *(uint32_t*)&row[x * 4];
+        case 24:
+            return row[x * 3] | (row[x * 3 + 1] << 8) | (row[x * 3 + 2] << 16);
+        case 16:
+            return *(uint16_t*)&row[x * 2];
+        case 8:
+            return row[x];
+        default:
+            return (row[x >> 1] >> ((x & 1) << 2)) & 0xF;
+    }
+}
+
+static inline void write_linear_pixel(uint8_t* row, uint32_t x, int bpp, uint32_t value)
+{
+    switch (bpp)
+    {
+        case 32:
+            *(uint32_t*)&row[x * 4] = value;
+            break;
+        case 24:
+            row[x * 3] = (uint8_t)value;
+            row[x * 3 + 1] = (uint8_t)(value >> 8);
+            row[x * 3 + 2] = (uint8_t)(value >> 16);
+            break;
+        case 16:
+            *(uint16_t*)&row[x * 2] = (uint16_t)value;
+            break;
+        case 8:
+            row[x] = (uint8_t)value;
+            break;
+        default:
+        {
+            int shift = (x & 1) << 2;
+            row[x >> 1] = (uint8_t)((row[x >> 1] & (0xF0 >> shift)) | ((value & 0xF) << shift));
+            break;
+        }
+    }
+}
+
+//PSMCT32 layout. mask/shift select the bits of each word that belong to the format (e.g. PSMT8H is the upper byte).
+template <int bpp, uint32_t mask, int shift>
+static void swizzle_block32(uint8_t* block, const uint8_t* src, uint32_t pitch)
+{
+    uint32_t* dest = (uint32_t*)block;
+    for (int y = 0; y < 8; y++, src += pitch)
+    {
+        for (int x = 0; x < 8; x++)
+        {
+            uint32_t& pixel = dest[columnTable32[y][x]];
+            pixel = (pixel & ~mask) | ((read_linear_pixel(src, x, bpp) << shift) & mask);
+        }
+    }
+}
+
+template <int bpp, uint32_t mask, int shift>
+static void unswizzle_block32(const uint8_t* block, uint8_t* dest, uint32_t pitch)
+{
+    const uint32_t* src = (const uint32_t*)block;
+    for (int y = 0; y < 8; y++, dest += pitch)
+    {
+        for (int x = 0; x < 8; x++)
+            write_linear_pixel(dest, x, bpp, (src[columnTable32[y][x]] & mask) >> shift);
+    }
+}
+
+static void swizzle_block16(uint8_t* block, const uint8_t* src, uint32_t pitch)
+{
+    uint16_t* dest = (uint16_t*)block;
+    for (int y = 0; y < 8; y++, src += pitch)
+    {
+        for (int x = 0; x < 16; x++)
+            dest[columnTable16[y][x]] = *(uint16_t*)&src[x * 2];
+    }
+}
+
+static void unswizzle_block16(const uint8_t* block, uint8_t* dest, uint32_t pitch)
+{
+    const uint16_t* src = (const uint16_t*)block;
+    for (int y = 0; y < 8; y++, dest += pitch)
+    {
+        for (int x = 0; x < 16; x++)
+            *(uint16_t*)&dest[x * 2] = src[columnTable16[y][x]];
+    }
+}
+
+static void swizzle_block8(uint8_t* block, const uint8_t* src, uint32_t pitch)
+{
+    for (int y = 0; y < 16; y++, src += pitch)
+    {
+        for (int x = 0; x < 16; x++)
+            block[columnTable8[y][x]] = src[x];
+    }
+}
+
+static void unswizzle_block8(const uint8_t* block, uint8_t* dest, uint32_t pitch)
+{
+    for (int y = 0; y < 16; y++, dest += pitch)
+    {
+        for (int x = 0; x < 16; x++)
+            dest[x] = block[columnTable8[y][x]];
+    }
+}
+
+static void swizzle_block4(uint8_t* block, const uint8_t* src, uint32_t pitch)
+{
+    for (int y = 0; y < 16; y++, src += pitch)
+    {
+        for (int x = 0; x < 32; x++)
+        {
+            uint32_t nibble = columnTable4[y][x];
+            int shift = (nibble & 1) << 2;
+            uint8_t& pair = block[nibble >> 1];
+            pair = (uint8_t)((pair & (0xF0 >> shift)) | (read_linear_pixel(src, x, 4) << shift));
+        }
+    }
+}
+
+static void unswizzle_block4(const uint8_t* block, uint8_t* dest, uint32_t pitch)
+{
+    for (int y = 0; y < 16; y++, dest += pitch)
+    {
+        for (int x = 0; x < 32; x++)
+        {
+            uint32_t nibble = columnTable4[y][x];
+            write_linear_pixel(dest, x, 4, block[nibble >> 1] >> ((nibble & 1) << 2));
+        }
+    }
+}
+
+static void swizzle_block(uint8_t format, uint8_t* block, const uint8_t* src, uint32_t pitch)
+{
+    switch (format)
+    {
+        case 0x00:
+        case 0x30:
+            swizzle_block32<32, 0xFFFFFFFF, 0>(block, src, pitch);
+            break;
+        case 0x01:
+        case 0x31:
+            swizzle_block32<24, 0x00FFFFFF, 0>(block, src, pitch);
+            break;
+        case 0x1B:
+            swizzle_block32<8, 0xFF000000, 24>(block, src, pitch);
+            break;
+        case 0x24:
+            swizzle_block32<4, 0x0F000000, 24>(block, src, pitch);
+            break;
+        case 0x2C:
+            swizzle_block32<4, 0xF0000000, 28>(block, src, pitch);
+            break;
+        case 0x02:
+        case 0x0A:
+        case 0x32:
+        case 0x3A:
+            swizzle_block16(block, src, pitch);
+            break;
+        case 0x13:
+            swizzle_block8(block, src, pitch);
+            break;
+        case 0x14:
+            swizzle_block4(block, src, pitch);
+            break;
+    }
+}
+
+static void unswizzle_block(uint8_t format, const uint8_t* block, uint8_t* dest, uint32_t pitch)
+{
+    switch (format)
+    {
+        case 0x00:
+        case 0x30:
+            unswizzle_block32<32, 0xFFFFFFFF, 0>(block, dest, pitch);
+            break;
+        case 0x01:
+        case 0x31:
+            unswizzle_block32<24, 0x00FFFFFF, 0>(block, dest, pitch);
+            break;
+        case 0x1B:
+            unswizzle_block32<8, 0xFF000000, 24>(block, dest, pitch);
+            break;
+        case 0x24:
+            unswizzle_block32<4, 0x0F000000, 24>(block, dest, pitch);
+            break;
+        case 0x2C:
+            unswizzle_block32<4, 0xF0000000, 28>(block, dest, pitch);
+            break;
+        case 0x02:
+        case 0x0A:
+        case 0x32:
+        case 0x3A:
+            unswizzle_block16(block, dest, pitch);
+            break;
+        case 0x13:
+            unswizzle_block8(block, dest, pitch);
+            break;
+        case 0x14:
+            unswizzle_block4(block, dest, pitch);
+            break;
+    }
+}
+
+//Conservative range of local memory touched by a rectangle, used to detect overlapping local-to-local copies
+static void transfer_mem_range(uint8_t format, uint32_t base, uint32_t width, uint32_t x, uint32_t y,
+                               uint32_t w, uint32_t h, uint32_t& start, uint32_t& end)
+{
+    uint32_t page_w = 64, page_h = 32;
+    switch (transfer_bpp(format))
+    {
+        case 16:
+            page_h = 64;
+            break;
+        case 8:
+            page_w = 128;
+            page_h = 64;
+            break;
+        case 4:
+            page_w = 128;
+            page_h = 128;
+            break;
+    }
+
+    //Blocks of an unaligned base can spill into the page after the last one
+    uint32_t pages_per_row = width / page_w;
+    start = (base / 8192) + (y / page_h) * pages_per_row + (x / page_w);
+    end = (base / 8192) + ((y + h - 1) / page_h) * pages_per_row + ((x + w - 1) / page_w) + 2;
+    start *= 8192;
+    end *= 8192;
+}
+
+void GraphicsSynthesizerThread::write_transfer_pixel(uint8_t format, uint32_t base, uint32_t width,
+                                                     uint32_t x, uint32_t y, uint32_t value)
+{
+    switch (format)
+    {
+        case 0x00:
+            write_PSMCT32_block(base, width, x, y, value);
+            break;
+        case 0x01:
+            write_PSMCT24_block(base, width, x, y, value);
+            break;
+        case 0x02:
+            write_PSMCT16_block(base, width, x, y, (uint16_t)value);
+            break;
+        case 0x0A:
+            write_PSMCT16S_block(base, width, x, y, (uint16_t)value);
+            break;
+        case 0x13:
+            write_PSMCT8_block(base, width, x, y, (uint8_t)value);
+            break;
+        case 0x14:
+            write_PSMCT4_block(base, width, x, y, (uint8_t)value);
+            break;
+        case 0x1B:
+            value = (value << 24) | (read_PSMCT32_block(base, width, x, y) & 0x00FFFFFF);
+            write_PSMCT32_block(base, width, x, y, value);
+            break;
+        case 0x24:
+            value = ((value & 0xF) << 24) | (read_PSMCT32_block(base, width, x, y) & 0xF0FFFFFF);
+            write_PSMCT32_block(base, width, x, y, value);
+            break;
+        case 0x2C:
+            value = ((value & 0xF) << 28) | (read_PSMCT32_block(base, width, x, y) & 0x0FFFFFFF);
+            write_PSMCT32_block(base, width, x, y, value);
+            break;
+        case 0x30:
+            write_PSMCT32Z_block(base, width, x, y, value);
+            break;
+        case 0x31:
+            write_PSMCT24Z_block(base, width, x, y, value);
+            break;
+        case 0x32:
+            write_PSMCT16Z_block(base, width, x, y, (uint16_t)value);
+            break;
+        case 0x3A:
+            write_PSMCT16SZ_block(base, width, x, y, (uint16_t)value);
+            break;
+    }
+}
+
+uint32_t GraphicsSynthesizerThread::read_transfer_pixel(uint8_t format, uint32_t base, uint32_t width,
+                                                        uint32_t x, uint32_t y)
+{
+    switch (format)
+    {
+        case 0x00:
+            return read_PSMCT32_block(base, width, x, y);
+        case 0x01:
+            return read_PSMCT32_block(base, width, x, y) & 0xFFFFFF;
+        case 0x02:
+            return read_PSMCT16_block(base, width, x, y);
+        case 0x0A:
+            return read_PSMCT16S_block(base, width, x, y);
+        case 0x13:
+            return read_PSMCT8_block(base, width, x, y);
+        case 0x14:
+            return read_PSMCT4_block(base, width, x, y);
+        case 0x1B:
+            return read_PSMCT32_block(base, width, x, y) >> 24;
+        case 0x24:
+            return (read_PSMCT32_block(base, width, x, y) >> 24) & 0xF;
+        case 0x2C:
+            return read_PSMCT32_block(base, width, x, y) >> 28;
+        case 0x30:
+            return read_PSMCT32Z_block(base, width, x, y);
+        case 0x31:
+            return read_PSMCT32Z_block(base, width, x, y) & 0xFFFFFF;
+        case 0x32:
+            return read_PSMCT16Z_block(base, width, x, y);
+        case 0x3A:
+            return read_PSMCT16SZ_block(base, width, x, y);
+        default:
+            return 0;
+    }
+}
+
+void GraphicsSynthesizerThread::host_to_local_rect(uint8_t format, uint32_t base, uint32_t width,
+                                                   uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                                                   const uint8_t* src, uint32_t pitch)
 {
-    uint32_t addr = addr_PSMCT16S(base / 256, width / 64, x, y);
-    return *(uint16_t*)&local_mem[addr];
-}
+    int bpp = transfer_bpp(format);
+    uint32_t block_w, block_h;
+    transfer_block_size(format, block_w, block_h);
 
-uint16_t GraphicsSynthesizerThread::read_PSMCT16Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
-{
-    uint32_t addr = addr_PSMCT16Z(base / 256, width / 64, x, y);
-    return *(uint16_t*)&local_mem[addr];
-}
+    //Block-aligned interior of the rectangle
+    uint32_t x0 = (x + block_w - 1) & ~(block_w - 1);
+    uint32_t x1 = (x + w) & ~(block_w - 1);
+    uint32_t y0 = (y + block_h - 1) & ~(block_h - 1);
+    uint32_t y1 = (y + h) & ~(block_h - 1);
 
-uint16_t GraphicsSynthesizerThread::read_PSMCT16SZ_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
-{
-    uint32_t addr = addr_PSMCT16SZ(base / 256, width / 64, x, y);
-    return *(uint16_t*)&local_mem[addr];
-}
+    //4-bit data must start on a byte boundary to be handled a block at a time
+    if (x0 >= x1 || y0 >= y1 || (bpp == 4 && (x & 1)))
+        x0 = x1 = y0 = y1 = 0;
 
-uint8_t GraphicsSynthesizerThread::read_PSMCT8_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
-{
-    uint32_t addr = addr_PSMCT8(base / 256, width / 64, x, y);
-    return local_mem[addr];
-}
+    for (uint32_t block_y = y0; block_y < y1; block_y += block_h)
+    {
+        const uint8_t* row = src + (block_y - y) * pitch;
+        for (uint32_t block_x = x0; block_x < x1; block_x += block_w)
+        {
+            uint8_t* block = &local_mem[transfer_block_addr(format, base, width, block_x, block_y)];
+            swizzle_block(format, block, row + ((block_x - x) * bpp) / 8, pitch);
+        }
+    }
 
-uint8_t GraphicsSynthesizerThread::read_PSMCT4_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y)
-{
-    uint32_t addr = addr_PSMCT4(base / 256, width / 64, x, y);
-    return (local_mem[addr >> 1] >> ((addr & 1) << 2)) & 0x0f;
+    for (uint32_t i = 0; i < h; i++)
+    {
+        const uint8_t* row = src + i * pitch;
+        bool interior_row = (y + i) >= y0 && (y + i) < y1;
+        for (uint32_t j = 0; j < w; j++)
+        {
+            if (interior_row && (x + j) >= x0 && (x + j) < x1)
+            {
+                j = x1 - x - 1;
+                continue;
+            }
+            write_transfer_pixel(format, base, width, x + j, y + i, read_linear_pixel(row, j, bpp));
+        }
+    }
 }
 
-void GraphicsSynthesizerThread::write_PSMCT32_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
+void GraphicsSynthesizerThread::local_to_host_rect(uint8_t format, uint32_t base, uint32_t width,
+                                                   uint32_t x, uint32_t y, uint32_t w, uint32_t h,
+                                                   uint8_t* dest, uint32_t pitch)
 {
-    uint32_t addr = addr_PSMCT32(base / 256, width / 64, x, y);
-    *(uint32_t*)&local_mem[addr] = value;
-}
+    int bpp = transfer_bpp(format);
+    uint32_t block_w, block_h;
+    transfer_block_size(format, block_w, block_h);
 
-void GraphicsSynthesizerThread::write_PSMCT32Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
-{
-    uint32_t addr = addr_PSMCT32Z(base / 256, width / 64, x, y);
-    *(uint32_t*)&local_mem[addr] = value;
-}
+    uint32_t x0 = (x + block_w - 1) & ~(block_w - 1);
+    uint32_t x1 = (x + w) & ~(block_w - 1);
+    uint32_t y0 = (y + block_h - 1) & ~(block_h - 1);
+    uint32_t y1 = (y + h) & ~(block_h - 1);
 
-void GraphicsSynthesizerThread::write_PSMCT24_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
-{
-    uint32_t addr = addr_PSMCT32(base / 256, width / 64, x, y);
-    uint32_t old_mem = *(uint32_t*)&local_mem[addr];
-    value &= 0xFFFFFF;
-    *(uint32_t*)&local_mem[addr] = (old_mem & 0xFF000000) | value;
-}
+    if (x0 >= x1 || y0 >= y1 || (bpp == 4 && (x & 1)))
+        x0 = x1 = y0 = y1 = 0;
 
-void GraphicsSynthesizerThread::write_PSMCT24Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value)
-{
-    uint32_t addr = addr_PSMCT32Z(base / 256, width / 64, x, y);
-    uint32_t old_mem = *(uint32_t*)&local_mem[addr];
-    value &= 0xFFFFFF;
-    *(uint32_t*)&local_mem[addr] = (old_mem & 0xFF000000) | value;
-}
+    for (uint32_t block_y = y0; block_y < y1; block_y += block_h)
+    {
+        uint8_t* row = dest + (block_y - y) * pitch;
+        for (uint32_t block_x = x0; block_x < x1; block_x += block_w)
+        {
+            const uint8_t* block = &local_mem[transfer_block_addr(format, base, width, block_x, block_y)];
+            unswizzle_block(format, block, row + ((block_x - x) * bpp) / 8, pitch);
+        }
+    }
 
-void GraphicsSynthesizerThread::write_PSMCT16_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
-{
-    uint32_t addr = addr_PSMCT16(base / 256, width / 64, x, y);
-    *(uint16_t*)&local_mem[addr] = value;
+    for (uint32_t i = 0; i < h; i++)
+    {
+        uint8_t* row = dest + i * pitch;
+        bool interior_row = (y + i) >= y0 && (y + i) < y1;
+        for (uint32_t j = 0; j < w; j++)
+        {
+            if (interior_row && (x + j) >= x0 && (x + j) < x1)
+            {
+                j = x1 - x - 1;
+                continue;
+            }
+            write_linear_pixel(row, j, bpp, read_transfer_pixel(format, base, width, x + j, y + i));
+        }
+    }
 }
 
-void GraphicsSynthesizerThread::write_PSMCT16S_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+//Returns the size in bytes of one row of the current transfer if whole rows can go through the bulk kernels, else 0.
+//Rows must fill a whole number of doublewords and not wrap horizontally, and the transfer must be at the start of a row.
+uint32_t GraphicsSynthesizerThread::get_bulk_row_size(uint8_t format, uint16_t x)
 {
-    uint32_t addr = addr_PSMCT16S(base / 256, width / 64, x, y);
-    *(uint16_t*)&local_mem[addr] = value;
+    uint32_t row_bits = TRXREG.width * transfer_bpp(format);
+    if (!row_bits || (row_bits & 0x3F) || x + TRXREG.width > 2048)
+        return 0;
+    if (pixels_transferred % TRXREG.width || PSMCT24_unpacked_count)
+        return 0;
+    if (pixels_transferred >= TRXREG.width * TRXREG.height)
+        return 0;
+    return row_bits / 8;
 }
 
-void GraphicsSynthesizerThread::write_PSMCT16Z_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+//The HWREG staging buffer holds the rows up to the next block boundary, which are swizzled together once complete
+void GraphicsSynthesizerThread::stage_HWREG(uint64_t data)
 {
-    uint32_t addr = addr_PSMCT16Z(base / 256, width / 64, x, y);
-    *(uint16_t*)&local_mem[addr] = value;
+    uint8_t format = BITBLTBUF.dest_format;
+    uint32_t row_size = TRXREG.width * transfer_bpp(format) / 8;
+    if (!hwreg_staged)
+    {
+        uint32_t block_w, block_h;
+        transfer_block_size(format, block_w, block_h);
+        uint32_t rows_left = TRXREG.height - pixels_transferred / TRXREG.width;
+        uint32_t rows = min(block_h - (TRXPOS.int_dest_y & (block_h - 1)), rows_left);
+        hwreg_band_size = rows * row_size;
+    }
+
+    *(uint64_t*)&transfer_buffer[hwreg_staged] = data;
+    hwreg_staged += 8;
+    if (hwreg_staged < hwreg_band_size)
+        return;
+
+    uint32_t rows = hwreg_band_size / row_size;
+    host_to_local_rect(format, BITBLTBUF.dest_base, BITBLTBUF.dest_width, TRXPOS.dest_x, TRXPOS.int_dest_y,
+                       TRXREG.width, rows, transfer_buffer, row_size);
+
+    hwreg_staged = 0;
+    pixels_transferred += rows * TRXREG.width;
+    TRXPOS.int_dest_x = TRXPOS.dest_x;
+    TRXPOS.int_dest_y = (uint16_t)((TRXPOS.int_dest_y + rows) % 2048);
 }
 
-void GraphicsSynthesizerThread::write_PSMCT16SZ_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint16_t value)
+//Called when something other than HWREG data arrives in the middle of a band.
+//The staged data is written out a pixel at a time so that local memory is up to date.
+void GraphicsSynthesizerThread::flush_HWREG_staging()
 {
-    uint32_t addr = addr_PSMCT16SZ(base / 256, width / 64, x, y);
-    *(uint16_t*)&local_mem[addr] = value;
+    uint32_t staged = hwreg_staged;
+    hwreg_staged = 0;
+    for (uint32_t i = 0; i < staged; i += 8)
+        write_HWREG_pixels(*(uint64_t*)&transfer_buffer[i]);
 }
 
-void GraphicsSynthesizerThread::write_PSMCT8_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint8_t value)
+bool GraphicsSynthesizerThread::fill_readback_buffer()
 {
-    uint32_t addr = addr_PSMCT8(base / 256, width / 64, x, y);
-    local_mem[addr] = value;
+    uint8_t format = BITBLTBUF.source_format;
+    uint32_t row_size = get_bulk_row_size(format, TRXPOS.source_x);
+    if (!row_size)
+        return false;
+
+    uint32_t block_w, block_h;
+    transfer_block_size(format, block_w, block_h);
+    uint32_t rows_left = TRXREG.height - pixels_transferred / TRXREG.width;
+    uint32_t rows = min(block_h - (TRXPOS.int_source_y & (block_h - 1)), rows_left);
+
+    local_to_host_rect(format, BITBLTBUF.source_base, BITBLTBUF.source_width, TRXPOS.source_x, TRXPOS.int_source_y,
+                       TRXREG.width, rows, transfer_buffer, row_size);
+    readback_size = rows * row_size;
+    readback_pos = 0;
+    readback_first_pixel = pixels_transferred;
+    readback_y = TRXPOS.int_source_y;
+    return true;
 }
 
-void GraphicsSynthesizerThread::write_PSMCT4_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint8_t value)
+uint64_t GraphicsSynthesizerThread::read_readback_buffer()
 {
-    uint32_t addr = addr_PSMCT4(base / 256, width / 64, x, y);
-    int shift = (addr & 1) << 2;
-    addr >>= 1;
+    uint64_t data = *(uint64_t*)&transfer_buffer[readback_pos];
+    readback_pos += 8;
 
-    local_mem[addr] = (uint8_t)((local_mem[addr] & (0xf0 >> shift)) | ((value & 0x0f) << shift));
+    //Keep the transfer position in sync with what has been sent, so that the per-pixel path can take over at any point
+    int bpp = transfer_bpp(BITBLTBUF.source_format);
+    uint32_t row_size = TRXREG.width * bpp / 8;
+    uint32_t rows = readback_pos / row_size;
+    uint32_t offset = readback_pos % row_size;
+    uint32_t pixels = (offset * 8) / bpp;
+
+    pixels_transferred = readback_first_pixel + rows * TRXREG.width + pixels;
+    TRXPOS.int_source_x = (uint16_t)(TRXPOS.source_x + pixels);
+    TRXPOS.int_source_y = (uint16_t)((readback_y + rows) % 2048);
+
+    if (bpp == 24)
+    {
+        //A PSMCT24 pixel may straddle two doublewords
+        uint32_t partial = offset % 3;
+        PSMCT24_color = 0;
+        PSMCT24_unpacked_count = 0;
+        if (partial)
+        {
+            uint8_t* pixel = &transfer_buffer[readback_pos - offset + pixels * 3];
+            PSMCT24_color = read_linear_pixel(pixel, 0, 24) >> (partial * 8);
+            PSMCT24_unpacked_count = 24 - partial * 8;
+            TRXPOS.int_source_x++;
+        }
+    }
+    return data;
 }
 
 //The "vertex kick" is the name given to the process of placing a vertex in the vertex queue.
@@ -1480,11 +2202,16 @@ void GraphicsSynthesizerThread::render_primitive()
     if ((current_ctx->frame.format & 0x30) == 0x30)
         current_ctx->zbuf.format &= ~0x30;
 
+    stats.prims++;
 #ifdef GS_JIT
-    jit_draw_pixel_func = get_jitted_draw_pixel(draw_pixel_state);
-    //No need to recompile tex_lookup if texture mapping is disabled. TEX0 can contain bad data
-    if(current_PRMODE->texture_mapping)
-        jit_tex_lookup_func = get_jitted_tex_lookup(tex_lookup_state);
+    use_pixel_jit = pixel_jit_enabled;
+    if (use_pixel_jit)
+    {
+        jit_draw_pixel_func = get_jitted_draw_pixel(draw_pixel_state);
+        //No need to recompile tex_lookup if texture mapping is disabled. TEX0 can contain bad data
+        if(current_PRMODE->texture_mapping)
+            jit_tex_lookup_func = get_jitted_tex_lookup(tex_lookup_state);
+    }
 #endif
     switch (prim_type)
     {
@@ -1623,8 +2350,36 @@ uint32_t GraphicsSynthesizerThread::lookup_frame_color(int32_t x, int32_t y)
     return frame_color;
 }
 
+inline void GraphicsSynthesizerThread::shade_pixel(int32_t x, int32_t y, uint32_t z, RGBAQ_REG& color)
+{
+#ifdef GS_JIT
+    if (use_pixel_jit)
+    {
+        if (collect_stats)
+            stats.pixels++;
+        jit_draw_pixel_prologue(x, y, z, color);
+        return;
+    }
+#endif
+    draw_pixel(x, y, z, color);
+}
+
+inline void GraphicsSynthesizerThread::shade_texel(int16_t u, int16_t v, TexLookupInfo& info)
+{
+#ifdef GS_JIT
+    if (use_pixel_jit)
+    {
+        jit_tex_lookup_prologue(u, v, &info);
+        return;
+    }
+#endif
+    tex_lookup(u, v, info);
+}
+
 void GraphicsSynthesizerThread::draw_pixel(int32_t x, int32_t y, uint32_t z, RGBAQ_REG& color)
 {
+    if (collect_stats)
+        stats.pixels++;
     frame_color_looked_up = false;
     x >>= 4;
     y >>= 4;
@@ -1974,8 +2729,9 @@ void GraphicsSynthesizerThread::recompile_draw_pixel_prologue()
     emitter_dp.POP(REG_64::RBP);
     emitter_dp.RET();
 
-    jit_draw_pixel_prologue = (GSDrawPixelPrologue)jit_draw_pixel_heap.
-            insert_block(~0ULL, &jit_draw_pixel_block)->code_start;
+    GSPixelJitBlockRecord* record = jit_draw_pixel_heap.insert_block(~0ULL, &jit_draw_pixel_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "GS_draw_pixel_prologue");
+    jit_draw_pixel_prologue = (GSDrawPixelPrologue)record->code_start;
 }
 
 void GraphicsSynthesizerThread::render_point()
@@ -2458,22 +3214,13 @@ void GraphicsSynthesizerThread::render_half_triangle(float x0, float x1, int y0,
                     u = (uint32_t) vtx.u;
                     v = (uint32_t) vtx.v;
                 }
-#ifdef GS_JIT
-                jit_tex_lookup_prologue(u, v, &tex_info);
-                jit_draw_pixel_prologue(x * 16, y * 16, (uint32_t)vtx.z, tex_info.tex_color);
-#else
-                tex_lookup(u, v, tex_info);
-                draw_pixel(x * 16, y * 16, (uint32_t)vtx.z, tex_info.tex_color);
-#endif
+                shade_texel(u, v, tex_info);
+                shade_pixel(x * 16, y * 16, (uint32_t)vtx.z, tex_info.tex_color);
 
             }
             else
             {
-#ifdef GS_JIT
-                jit_draw_pixel_prologue(x * 16, y * 16, (uint32_t)vtx.z, tex_info.vtx_color);
-#else
-                draw_pixel(x * 16, y * 16, (uint32_t)vtx.z, tex_info.vtx_color);
-#endif
+                shade_pixel(x * 16, y * 16, (uint32_t)vtx.z, tex_info.vtx_color);
             }
 
             vtx += x_step;                       // get values for the adjacent pixel
@@ -2685,21 +3432,12 @@ void GraphicsSynthesizerThread::render_triangle()
                                     u = (uint32_t) temp_u;
                                     v = (uint32_t) temp_v;
                                 }
-#ifdef GS_JIT
-                                jit_tex_lookup_prologue(u, v, &tex_info);
-                                jit_draw_pixel_prologue(x, y, (uint32_t)z, tex_info.tex_color);
-#else
-                                tex_lookup(u, v, tex_info);
-                                draw_pixel(x, y, (uint32_t)z, tex_info.tex_color);
-#endif
+                                shade_texel(u, v, tex_info);
+                                shade_pixel(x, y, (uint32_t)z, tex_info.tex_color);
                             }
                             else
                             {
-#ifdef GS_JIT
-                                jit_draw_pixel_prologue(x, y, (uint32_t)z, tex_info.vtx_color);
-#else
-                                draw_pixel(x, y, (uint32_t)z, tex_info.vtx_color);
-#endif
+                                shade_pixel(x, y, (uint32_t)z, tex_info.vtx_color);
                             }
                         }
                         else
@@ -2778,34 +3516,18 @@ void GraphicsSynthesizerThread::render_sprite()
                 {
                     pix_v = (pix_t * tex_info.tex_height) * 16.0;
                     pix_u = (pix_s * tex_info.tex_width) * 16.0;
-#ifdef GS_JIT
-                    jit_tex_lookup_prologue(pix_u, pix_v, &tex_info);
-#else
-                    tex_lookup(pix_u, pix_v, tex_info);
-#endif
+                    shade_texel(pix_u, pix_v, tex_info);
                 }
                 else
                 {
-#ifdef GS_JIT
-                    jit_tex_lookup_prologue(pix_u >> 16, pix_v >> 16, &tex_info);
-#else
-                    tex_lookup(pix_u >> 16, pix_v >> 16, tex_info);
-#endif
+                    shade_texel(pix_u >> 16, pix_v >> 16, tex_info);
                 }
 
-#ifdef GS_JIT
-                jit_draw_pixel_prologue(x, y, v2.z, tex_info.tex_color);
-#else
-                draw_pixel(x, y, v2.z, tex_info.tex_color);
-#endif
+                shade_pixel(x, y, v2.z, tex_info.tex_color);
             }
             else
             {
-#ifdef GS_JIT
-                jit_draw_pixel_prologue(x, y, v2.z, tex_info.vtx_color);
-#else
-                draw_pixel(x, y, v2.z, tex_info.vtx_color);
-#endif
+                shade_pixel(x, y, v2.z, tex_info.vtx_color);
             }
             pix_s += pix_s_step;
             pix_u += pix_u_step;
@@ -2817,8 +3539,6 @@ void GraphicsSynthesizerThread::render_sprite()
 
 void GraphicsSynthesizerThread::write_HWREG(uint64_t data)
 {
-    int ppd = 0; //pixels per doubleword (64-bits)
-
     //Invalid transfer if no height/width has been set
     if (TRXREG.width == 0 || TRXREG.height == 0)
     {
@@ -2827,6 +3547,27 @@ void GraphicsSynthesizerThread::write_HWREG(uint64_t data)
         return;
     }
 
+    //Whole rows are staged and swizzled in bulk. PSMCT4 picks nibbles by destination X, so it needs an even start.
+    uint8_t format = BITBLTBUF.dest_format;
+    if (hwreg_staged || (get_bulk_row_size(format, TRXPOS.dest_x) && !(format == 0x14 && (TRXPOS.dest_x & 1))))
+        stage_HWREG(data);
+    else
+        write_HWREG_pixels(data);
+
+    int max_pixels = TRXREG.width * TRXREG.height;
+    if (pixels_transferred >= max_pixels)
+    {
+        //Deactivate the transmisssion
+        printf("[GS_t] HWREG transfer ended\n");
+        TRXDIR = 3;
+        pixels_transferred = 0;
+    }
+}
+
+void GraphicsSynthesizerThread::write_HWREG_pixels(uint64_t data)
+{
+    int ppd = 0; //pixels per doubleword (64-bits)
+
     switch (BITBLTBUF.dest_format)
     {
         //PSMCT32
@@ -2865,10 +3606,22 @@ void GraphicsSynthesizerThread::write_HWREG(uint64_t data)
         case 0x2C:
             ppd = 16;
             break;
+        //PSMZ32
+        case 0x30:
+            ppd = 2;
+            break;
         //PSMCT24Z
         case 0x31:
             ppd = 3;
             break;
+        //PSMZ16
+        case 0x32:
+            ppd = 4;
+            break;
+        //PSMZ16S
+        case 0x3A:
+            ppd = 4;
+            break;
         default:
             Errors::print_warning("[GS_t] Unrecognized BITBLTBUF dest format $%02X\n", BITBLTBUF.dest_format);
             return;
@@ -2974,9 +3727,24 @@ void GraphicsSynthesizerThread::write_HWREG(uint64_t data)
                 TRXPOS.int_dest_x++;
             }
                 break;
+            case 0x30:
+                write_PSMCT32Z_block(BITBLTBUF.dest_base, BITBLTBUF.dest_width, TRXPOS.int_dest_x, TRXPOS.int_dest_y, (data >> (i * 32)) & 0xFFFFFFFF);
+                pixels_transferred++;
+                TRXPOS.int_dest_x++;
+                break;
             case 0x31:
                 unpack_PSMCT24(data, i, true);
                 break;
+            case 0x32:
+                write_PSMCT16Z_block(BITBLTBUF.dest_base, BITBLTBUF.dest_width, TRXPOS.int_dest_x, TRXPOS.int_dest_y, (data >> (i * 16)) & 0xFFFF);
+                pixels_transferred++;
+                TRXPOS.int_dest_x++;
+                break;
+            case 0x3A:
+                write_PSMCT16SZ_block(BITBLTBUF.dest_base, BITBLTBUF.dest_width, TRXPOS.int_dest_x, TRXPOS.int_dest_y, (data >> (i * 16)) & 0xFFFF);
+                pixels_transferred++;
+                TRXPOS.int_dest_x++;
+                break;
         }
         if (pixels_transferred % TRXREG.width == 0)
         {
@@ -2988,15 +3756,6 @@ void GraphicsSynthesizerThread::write_HWREG(uint64_t data)
         TRXPOS.int_dest_x %= 2048;
         TRXPOS.int_dest_y %= 2048;
     }
-
-    int max_pixels = TRXREG.width * TRXREG.height;
-    if (pixels_transferred >= max_pixels)
-    {
-        //Deactivate the transmisssion
-        printf("[GS_t] HWREG transfer ended\n");
-        TRXDIR = 3;
-        pixels_transferred = 0;
-    }
 }
 
 uint128_t GraphicsSynthesizerThread::local_to_host()
@@ -3046,6 +3805,14 @@ uint128_t GraphicsSynthesizerThread::local_to_host()
         case 0x1B:
             ppd = 8;
             break;
+        //PSMT4HL
+        case 0x24:
+            ppd = 16;
+            break;
+        //PSMT4HH
+        case 0x2C:
+            ppd = 16;
+            break;
         //PSMZ32
         case 0x30:
             ppd = 2;
@@ -3054,6 +3821,14 @@ uint128_t GraphicsSynthesizerThread::local_to_host()
         case 0x31:
             ppd = 1; //Does it all in one go
             break;
+        //PSMZ16
+        case 0x32:
+            ppd = 4;
+            break;
+        //PSMZ16S
+        case 0x3A:
+            ppd = 4;
+            break;
         default:
             Errors::print_warning("[GS_t] GS Download Unrecognized BITBLTBUF source format $%02X\n", BITBLTBUF.source_format);
             return return_data;
@@ -3061,6 +3836,13 @@ uint128_t GraphicsSynthesizerThread::local_to_host()
     uint64_t data = 0;
     for (int datapart = 0; datapart < 2; datapart++)
     {
+        //Serve whole rows out of the readback buffer when possible
+        if (readback_pos < readback_size || fill_readback_buffer())
+        {
+            return_data._u64[datapart] = read_readback_buffer();
+            continue;
+        }
+
         for (int i = 0; i < ppd; i++)
         {
             switch (BITBLTBUF.source_format)
@@ -3104,6 +3886,18 @@ uint128_t GraphicsSynthesizerThread::local_to_host()
                     pixels_transferred++;
                     TRXPOS.int_source_x++;
                     break;
+                case 0x24:
+                    data |= (uint64_t)((read_PSMCT32_block(BITBLTBUF.source_base, BITBLTBUF.source_width,
+                        TRXPOS.int_source_x, TRXPOS.int_source_y) >> 24) & 0xF) << (i * 4);
+                    pixels_transferred++;
+                    TRXPOS.int_source_x++;
+                    break;
+                case 0x2C:
+                    data |= (uint64_t)((read_PSMCT32_block(BITBLTBUF.source_base, BITBLTBUF.source_width,
+                        TRXPOS.int_source_x, TRXPOS.int_source_y) >> 28) & 0xF) << (i * 4);
+                    pixels_transferred++;
+                    TRXPOS.int_source_x++;
+                    break;
                 case 0x30:
                     data |= (uint64_t)(read_PSMCT32Z_block(BITBLTBUF.source_base, BITBLTBUF.source_width,
                         TRXPOS.int_source_x, TRXPOS.int_source_y) & 0xFFFFFFFF) << (i * 32);
@@ -3113,6 +3907,18 @@ uint128_t GraphicsSynthesizerThread::local_to_host()
                 case 0x31:
                     data = pack_PSMCT24(true);
                     break;
+                case 0x32:
+                    data |= (uint64_t)(read_PSMCT16Z_block(BITBLTBUF.source_base, BITBLTBUF.source_width,
+                        TRXPOS.int_source_x, TRXPOS.int_source_y) & 0xFFFF) << (i * 16);
+                    pixels_transferred++;
+                    TRXPOS.int_source_x++;
+                    break;
+                case 0x3A:
+                    data |= (uint64_t)(read_PSMCT16SZ_block(BITBLTBUF.source_base, BITBLTBUF.source_width,
+                        TRXPOS.int_source_x, TRXPOS.int_source_y) & 0xFFFF) << (i * 16);
+                    pixels_transferred++;
+                    TRXPOS.int_source_x++;
+                    break;
                 default:
                     Errors::print_warning("[GS_t] GS Download Unrecognized BITBLTBUF source format $%02X\n", BITBLTBUF.source_format);
                     return return_data;
@@ -3235,12 +4041,60 @@ uint64_t GraphicsSynthesizerThread::pack_PSMCT24(bool z_format)
     return output_color;
 }
 
+//Copies the whole rectangle through the transfer buffer a band at a time.
+//Only usable when the copy order can't matter, i.e. same format, no wrapping and no overlap.
+bool GraphicsSynthesizerThread::local_to_local_bulk()
+{
+    uint8_t format = BITBLTBUF.source_format;
+    if (format != BITBLTBUF.dest_format)
+        return false;
+
+    switch (format)
+    {
+        case 0x00:
+        case 0x01:
+        case 0x02:
+        case 0x0A:
+        case 0x13:
+        case 0x14:
+        case 0x30:
+        case 0x31:
+            break;
+        default:
+            return false;
+    }
+
+    uint32_t width = TRXREG.width;
+    uint32_t height = TRXREG.height;
+    if (TRXPOS.source_x + width > 2048 || TRXPOS.dest_x + width > 2048 ||
+        TRXPOS.source_y + height > 2048 || TRXPOS.dest_y + height > 2048)
+        return false;
+
+    uint32_t source_start, source_end, dest_start, dest_end;
+    transfer_mem_range(format, BITBLTBUF.source_base, BITBLTBUF.source_width, TRXPOS.source_x, TRXPOS.source_y,
+                       width, height, source_start, source_end);
+    transfer_mem_range(format, BITBLTBUF.dest_base, BITBLTBUF.dest_width, TRXPOS.dest_x, TRXPOS.dest_y,
+                       width, height, dest_start, dest_end);
+    if (source_end > 1024 * 1024 * 4 || dest_end > 1024 * 1024 * 4)
+        return false;
+    if (source_start < dest_end && dest_start < source_end)
+        return false;
+
+    uint32_t row_size = (width * transfer_bpp(format) + 7) / 8;
+    uint32_t band_rows = sizeof(transfer_buffer) / row_size;
+    for (uint32_t y = 0; y < height; y += band_rows)
+    {
+        uint32_t rows = min(band_rows, height - y);
+        local_to_host_rect(format, BITBLTBUF.source_base, BITBLTBUF.source_width,
+                           TRXPOS.source_x, TRXPOS.source_y + y, width, rows, transfer_buffer, row_size);
+        host_to_local_rect(format, BITBLTBUF.dest_base, BITBLTBUF.dest_width,
+                           TRXPOS.dest_x, TRXPOS.dest_y + y, width, rows, transfer_buffer, row_size);
+    }
+    return true;
+}
+
 void GraphicsSynthesizerThread::local_to_local()
 {
-    printf("[GS_t] Local to local transfer\n");
-    printf("(%d, %d) -> (%d, %d)\n", TRXPOS.source_x, TRXPOS.source_y, TRXPOS.dest_x, TRXPOS.dest_y);
-    printf("Trans order: %d\n", TRXPOS.trans_order);
-    printf("Source: $%08X Dest: $%08X\n", BITBLTBUF.source_base, BITBLTBUF.dest_base);
     int max_pixels = TRXREG.width * TRXREG.height;
 
     uint16_t dest_start_x = 0, src_start_x = 0;
@@ -3254,6 +4108,13 @@ void GraphicsSynthesizerThread::local_to_local()
         return;
     }
 
+    if (local_to_local_bulk())
+    {
+        pixels_transferred = 0;
+        TRXDIR = 3;
+        return;
+    }
+
     switch (TRXPOS.trans_order)
     {
         case 0x00:
@@ -3874,8 +4735,9 @@ void GraphicsSynthesizerThread::recompile_tex_lookup_prologue()
     emitter_tex.POP(REG_64::RBP);
     emitter_tex.RET();
 
-    jit_tex_lookup_prologue = (GSTexLookupPrologue)jit_tex_lookup_heap.
-            insert_block(~0ULL, &jit_tex_lookup_block)->code_start;
+    GSTextureJitBlockRecord* record = jit_tex_lookup_heap.insert_block(~0ULL, &jit_tex_lookup_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "GS_tex_lookup_prologue");
+    jit_tex_lookup_prologue = (GSTexLookupPrologue)record->code_start;
 }
 
 void GraphicsSynthesizerThread::clut_lookup(uint8_t entry, RGBAQ_REG &tex_color)
@@ -4095,7 +4957,9 @@ uint8_t* GraphicsSynthesizerThread::get_jitted_draw_pixel(uint64_t state)
     if (!found_block)
     {
         printf("[GS_t] RECOMPILING DRAW PIXEL %llX\n", state);
+        uint64_t compile_start = Profiler::timestamp();
         found_block = recompile_draw_pixel(state);
+        Profiler::add_jit_compile(Profiler::JIT_GS, compile_start);
     }
     return (uint8_t*)found_block->code_start;
 }
@@ -4106,7 +4970,9 @@ uint8_t* GraphicsSynthesizerThread::get_jitted_tex_lookup(uint64_t state)
     if (!found_block)
     {
         printf("[GS_t] RECOMPILING TEX LOOKUP %llX\n", state);
+        uint64_t compile_start = Profiler::timestamp();
         found_block = recompile_tex_lookup(state);
+        Profiler::add_jit_compile(Profiler::JIT_GS, compile_start);
     }
     return (uint8_t*)found_block->code_start;
 }
@@ -4365,7 +5231,9 @@ GSPixelJitBlockRecord* GraphicsSynthesizerThread::recompile_draw_pixel(uint64_t
 
     emitter_dp.set_jump_dest(do_not_update_rgba);
     jit_epilogue_draw_pixel();
-    return jit_draw_pixel_heap.insert_block(state, &jit_draw_pixel_block);
+    GSPixelJitBlockRecord* record = jit_draw_pixel_heap.insert_block(state, &jit_draw_pixel_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "GS_draw_pixel_%016llX", (unsigned long long)state);
+    return record;
 }
 
 void GraphicsSynthesizerThread::recompile_alpha_test()
@@ -5120,7 +5988,9 @@ GSTextureJitBlockRecord* GraphicsSynthesizerThread::recompile_tex_lookup(uint64_
     emitter_tex.POP(RBP);
     emitter_tex.RET();
 
-    return jit_tex_lookup_heap.insert_block(state, &jit_tex_lookup_block);
+    GSTextureJitBlockRecord* record = jit_tex_lookup_heap.insert_block(state, &jit_tex_lookup_block);
+    JitSymbols::add_block(record->code_start, record->code_end, "GS_tex_lookup_%016llX", (unsigned long long)state);
+    return record;
 }
 
 void GraphicsSynthesizerThread::recompile_clut_lookup()
@@ -5219,7 +6089,7 @@ void GraphicsSynthesizerThread::recompile_convert_16bit_tex(REG_64 color, REG_64
     emitter_tex.MOV32_REG(temp2, color);
 }
 
-void GraphicsSynthesizerThread::load_state(ifstream *state)
+void GraphicsSynthesizerThread::load_state(istream *state)
 {
     state->read((char*)local_mem, 1024 * 1024 * 4);
     state->read((char*)&IMR, sizeof(IMR));
@@ -5270,7 +6140,7 @@ void GraphicsSynthesizerThread::load_state(ifstream *state)
     state->read((char*)&num_vertices, sizeof(num_vertices));
 }
 
-void GraphicsSynthesizerThread::save_state(ofstream *state)
+void GraphicsSynthesizerThread::save_state(ostream *state)
 {
     state->write((char*)local_mem, 1024 * 1024 * 4);
     state->write((char*)&IMR, sizeof(IMR));
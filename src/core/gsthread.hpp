@@ -1,10 +1,12 @@
 #ifndef GSTHREAD_HPP
 #define GSTHREAD_HPP
 #include <cstdint>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <cstdint>
+#include <iosfwd>
+#include <vector>
 #include "gscontext.hpp"
 #include "gsregisters.hpp"
 #include "circularFIFO.hpp"
@@ -28,13 +30,61 @@ struct SwizzleTable
     uint32_t data[XS*YS*ZS];
 };
 
+//Frames produced by the GS thread for display, triple buffered so neither side ever waits on the other.
+//The GS thread owns the back buffer and the consumer owns the front buffer. Finished frames are traded through
+//the ready slot, which is flagged until the consumer picks it up. Frames the consumer doesn't get to are dropped.
+struct GSOutputFrames
+{
+    static const int FRAME_COUNT = 3;
+    static const int NEW_FRAME = 0x4;
+
+    uint32_t* buffers[FRAME_COUNT];
+    uint16_t width[FRAME_COUNT];
+    uint16_t height[FRAME_COUNT];
+    int back;
+    int front;
+    std::atomic<int> ready;
+
+    //GS thread
+    uint32_t* get_back() { return buffers[back]; }
+    void publish(uint16_t w, uint16_t h)
+    {
+        width[back] = w;
+        height[back] = h;
+        back = ready.exchange(back | NEW_FRAME, std::memory_order_acq_rel) & ~NEW_FRAME;
+    }
+
+    //Consumer - returns false if no frame has been published since the last call
+    bool acquire()
+    {
+        if (!(ready.load(std::memory_order_relaxed) & NEW_FRAME))
+            return false;
+        front = ready.exchange(front, std::memory_order_acq_rel) & ~NEW_FRAME;
+        return true;
+    }
+    uint32_t* get_front() { return buffers[front]; }
+    uint16_t get_front_width() { return width[front]; }
+    uint16_t get_front_height() { return height[front]; }
+};
+
 //Commands sent from the main thread to the GS thread.
 enum GSCommand:uint8_t 
 {
     write64_t, write64_privileged_t, write32_privileged_t,
     set_rgba_t, set_st_t, set_uv_t, set_xyz_t, set_xyzf_t, set_crt_t,
     render_crt_t, assert_finish_t, assert_vsync_t, set_vblank_t, memdump_t, die_t,
-    save_state_t, load_state_t, gsdump_t, request_local_host_tx,
+    save_state_t, load_state_t, gsdump_t, request_local_host_tx, stats_t,
+};
+
+//Counters kept by the GS thread, read back with a stats_t message
+struct GSThreadStats
+{
+    uint64_t messages;
+    uint64_t prims;
+    uint64_t pixels;
+
+    //Time spent processing messages for each frame, excluding time asleep waiting for work
+    std::vector<float> frame_times_ms;
 };
 
 union GSMessagePayload 
@@ -85,17 +135,20 @@ union GSMessagePayload
     } vblank_payload;
     struct 
     {
-        uint32_t* target;
-        std::mutex* target_mutex;
+        GSOutputFrames* frames;
     } render_payload;
     struct
     {
-        std::ofstream* state;
+        std::ostream* state;
     } save_state_payload;
     struct
     {
-        std::ifstream* state;
+        std::istream* state;
     } load_state_payload;
+    struct
+    {
+        GSThreadStats* stats;
+    } stats_payload;
     struct 
     {
         uint8_t BLANK; 
@@ -117,6 +170,7 @@ enum GSReturn :uint8_t
     load_state_done_t,
     gsdump_render_partial_done_t,
     local_host_transfer,
+    stats_done_t,
 };
 
 union GSReturnMessagePayload
@@ -385,6 +439,15 @@ class GraphicsSynthesizerThread
         GSTexLookupPrologue jit_tex_lookup_prologue;
         GSDrawPixelPrologue jit_draw_pixel_prologue;
 
+        //The pixel path can be switched at runtime for A/B comparisons; it's latched once per primitive
+        std::atomic_bool pixel_jit_enabled;
+        bool use_pixel_jit;
+
+        GSThreadStats stats;
+
+        //Set by the first stats_t request, so frame times and pixels are only counted when a benchmark asks for them
+        bool collect_stats;
+
         uint8_t prim_type;
         uint16_t FOG;
         PRMODE_REG PRIM, PRMODE;
@@ -418,6 +481,14 @@ class GraphicsSynthesizerThread
         uint32_t PSMCT24_color;
         int PSMCT24_unpacked_count;
 
+        //Linear image data for bulk transfers. HWREG uploads are staged here until a band of blocks is complete,
+        //and local->host downloads unswizzle a band at a time and hand it out a doubleword per request.
+        uint8_t transfer_buffer[2048 * 16 * 4];
+        uint32_t hwreg_staged, hwreg_band_size;
+        uint32_t readback_size, readback_pos;
+        int readback_first_pixel;
+        uint16_t readback_y;
+
         GS_REGISTERS reg;
 
         Vertex current_vtx;
@@ -463,6 +534,20 @@ class GraphicsSynthesizerThread
         void write_PSMCT8_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint8_t value);
         void write_PSMCT4_block(uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint8_t value);
 
+        //Bulk transfer routines
+        void write_transfer_pixel(uint8_t format, uint32_t base, uint32_t width, uint32_t x, uint32_t y, uint32_t value);
+        uint32_t read_transfer_pixel(uint8_t format, uint32_t base, uint32_t width, uint32_t x, uint32_t y);
+        void host_to_local_rect(uint8_t format, uint32_t base, uint32_t width, uint32_t x, uint32_t y,
+                                uint32_t w, uint32_t h, const uint8_t* src, uint32_t pitch);
+        void local_to_host_rect(uint8_t format, uint32_t base, uint32_t width, uint32_t x, uint32_t y,
+                                uint32_t w, uint32_t h, uint8_t* dest, uint32_t pitch);
+        uint32_t get_bulk_row_size(uint8_t format, uint16_t x);
+        void stage_HWREG(uint64_t data);
+        void flush_HWREG_staging();
+        bool fill_readback_buffer();
+        uint64_t read_readback_buffer();
+        bool local_to_local_bulk();
+
         uint8_t get_16bit_alpha(uint16_t color);
         int16_t multiply_tex_color(int16_t tex_color, int16_t frag_color);
         void calculate_LOD(TexLookupInfo& info);
@@ -493,6 +578,8 @@ class GraphicsSynthesizerThread
         void vertex_kick(bool drawing_kick);
         bool depth_test(int32_t x, int32_t y, uint32_t z);
         void draw_pixel(int32_t x, int32_t y, uint32_t z, RGBAQ_REG& color);
+        void shade_pixel(int32_t x, int32_t y, uint32_t z, RGBAQ_REG& color);
+        void shade_texel(int16_t u, int16_t v, TexLookupInfo& info);
         uint32_t lookup_frame_color(int32_t x, int32_t y);
         void render_primitive();
         void render_point();
@@ -503,6 +590,7 @@ class GraphicsSynthesizerThread
                 float step_x0, float step_x1, float scx1, float scx2, TexLookupInfo& tex_info);
         void render_sprite();
         void write_HWREG(uint64_t data);
+        void write_HWREG_pixels(uint64_t data);
         uint128_t local_to_host();
         void unpack_PSMCT24(uint64_t data, int offset, bool z_format);
         uint64_t pack_PSMCT24(bool z_format);
@@ -513,7 +601,7 @@ class GraphicsSynthesizerThread
         void reset();
         void memdump(uint32_t* target, uint16_t& width, uint16_t& height);
 
-        uint32_t get_CRT_color(DISPFB& dispfb, uint32_t x, uint32_t y);
+        void read_CRT_row(DISPFB& dispfb, uint32_t x, uint32_t y, int width, uint32_t* out);
         void render_CRT(uint32_t* target);
 
         void write64(uint32_t addr, uint64_t value);
@@ -524,8 +612,8 @@ class GraphicsSynthesizerThread
         void set_XYZ(uint32_t x, uint32_t y, uint32_t z, bool drawing_kick);
         void set_XYZF(uint32_t x, uint32_t y, uint32_t z, uint8_t fog, bool drawing_kick);
 
-        void load_state(std::ifstream* state);
-        void save_state(std::ofstream* state);
+        void load_state(std::istream* state);
+        void save_state(std::ostream* state);
     public:
         GraphicsSynthesizerThread();
         ~GraphicsSynthesizerThread();
@@ -536,5 +624,6 @@ class GraphicsSynthesizerThread
         void wait_for_return(GSReturn type, GSReturnMessage &data);
         void reset_fifos();
         void exit();
+        void set_pixel_jit(bool enabled);
 };
 #endif // GSTHREAD_HPP
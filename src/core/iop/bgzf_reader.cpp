@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdio>
+#include <libdeflate.h>
+#include "bgzf_reader.hpp"
+
+BGZF_Reader::BGZF_Reader()
+{
+
+}
+
+BGZF_Reader::~BGZF_Reader()
+{
+    close();
+}
+
+//Walks the member headers to build the block index. Only the headers and trailers are read.
+bool BGZF_Reader::open_file(const char* path)
+{
+    file.open(path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+
+    uint64_t file_len = file.tellg();
+    uint64_t offset = 0;
+    uint64_t uncompressed = 0;
+    while (offset < file_len)
+    {
+        //ID1, ID2, CM, FLG, MTIME, XFL, OS, XLEN
+        uint8_t header[12];
+        file.seekg(offset);
+        file.read((char*)header, sizeof(header));
+        if (file.gcount() != sizeof(header) || header[0] != 0x1F || header[1] != 0x8B || header[2] != 8 ||
+            !(header[3] & 0x4))
+        {
+            printf("[CDVD] Not a BGZF file\n");
+            return false;
+        }
+
+        //The total member size is in the BC subfield of the extra field
+        uint16_t xlen = header[10] | (header[11] << 8);
+        std::vector<uint8_t> extra(xlen);
+        file.read((char*)extra.data(), xlen);
+        uint32_t length = 0;
+        for (size_t i = 0; i + 4 <= extra.size(); )
+        {
+            uint16_t sub_len = extra[i + 2] | (extra[i + 3] << 8);
+            if (extra[i] == 'B' && extra[i + 1] == 'C' && sub_len == 2 && i + 6 <= extra.size())
+                length = (extra[i + 4] | (extra[i + 5] << 8)) + 1;
+            i += 4 + sub_len;
+        }
+        if (file.gcount() != xlen || !length || offset + length > file_len)
+        {
+            printf("[CDVD] Corrupt BGZF block at offset $%llx\n", (unsigned long long)offset);
+            return false;
+        }
+
+        //ISIZE is the last word of the member
+        uint8_t isize_bytes[4];
+        file.seekg(offset + length - 4);
+        file.read((char*)isize_bytes, sizeof(isize_bytes));
+        uint32_t isize = isize_bytes[0] | (isize_bytes[1] << 8) | (isize_bytes[2] << 16) | (isize_bytes[3] << 24);
+        if (isize > MAX_BLOCK_SIZE)
+        {
+            printf("[CDVD] Corrupt BGZF block at offset $%llx\n", (unsigned long long)offset);
+            return false;
+        }
+
+        //Skip empty members, such as the end-of-file marker
+        if (isize)
+        {
+            members.push_back({offset, length});
+            block_starts.push_back(uncompressed);
+        }
+        offset += length;
+        uncompressed += isize;
+    }
+
+    if (members.empty())
+    {
+        printf("[CDVD] BGZF file is empty\n");
+        return false;
+    }
+
+    block_starts.push_back(uncompressed);
+    size = uncompressed;
+    num_blocks = (uint32_t)members.size();
+    max_block_size = MAX_BLOCK_SIZE;
+    return true;
+}
+
+void BGZF_Reader::close_file()
+{
+    if (file.is_open())
+        file.close();
+    members.clear();
+    block_starts.clear();
+}
+
+uint32_t BGZF_Reader::get_block_at(uint64_t offset)
+{
+    return (uint32_t)(std::upper_bound(block_starts.begin(), block_starts.end(), offset) - block_starts.begin() - 1);
+}
+
+uint64_t BGZF_Reader::get_block_start(uint32_t block)
+{
+    return block_starts[block];
+}
+
+int64_t BGZF_Reader::decode_block(uint32_t block, uint8_t* dst, BlockDecoder& block_decoder)
+{
+    const Member& member = members[block];
+    block_decoder.raw.resize(member.length);
+    {
+        std::lock_guard<std::mutex> lock(file_mutex);
+        file.seekg(member.offset);
+        file.read((char*)block_decoder.raw.data(), member.length);
+        if (file.gcount() != member.length)
+        {
+            printf("[CDVD] Failed to read BGZF block %d\n", block);
+            file.clear();
+            return -1;
+        }
+    }
+
+    size_t read;
+    auto res = libdeflate_gzip_decompress(block_decoder.inflate, block_decoder.raw.data(), member.length, dst,
+                                          max_block_size, &read);
+    if (res != LIBDEFLATE_SUCCESS)
+    {
+        printf("[CDVD] Failed to decompress BGZF block %d: %d\n", block, res);
+        return -1;
+    }
+    return read;
+}
@@ -0,0 +1,39 @@
+#ifndef BGZF_READER_HPP
+#define BGZF_READER_HPP
+#include <fstream>
+#include <vector>
+#include "compressed_container.hpp"
+
+/**
+  * Blocked gzip, as written by bgzip: a series of gzip members that each hold at most 64 KB of data, with the size
+  * of every member recorded in its header. It's still an ordinary .gz file, but blocks can be found without
+  * decompressing what comes before them.
+  */
+class BGZF_Reader : public CompressedContainer
+{
+    private:
+        constexpr static uint32_t MAX_BLOCK_SIZE = 64 * 1024;
+
+        struct Member
+        {
+            uint64_t offset;
+            uint32_t length;
+        };
+
+        std::ifstream file;
+        std::vector<Member> members;
+
+        //Uncompressed offset of each block, with an extra entry for the end of the image
+        std::vector<uint64_t> block_starts;
+    protected:
+        bool open_file(const char* path) override;
+        void close_file() override;
+        uint32_t get_block_at(uint64_t offset) override;
+        uint64_t get_block_start(uint32_t block) override;
+        int64_t decode_block(uint32_t block, uint8_t* dst, BlockDecoder& block_decoder) override;
+    public:
+        BGZF_Reader();
+        ~BGZF_Reader();
+};
+
+#endif // BGZF_READER_HPP
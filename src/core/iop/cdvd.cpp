@@ -1,7 +1,9 @@
 #include <cstring>
 #include <ctime>
 #include <string>
+#include "bgzf_reader.hpp"
 #include "cdvd.hpp"
+#include "cso_reader.hpp"
 #include "iop_dma.hpp"
 
 #include "../emulator.hpp"
@@ -24,7 +26,9 @@ uint32_t CDVD_Drive::get_block_timing(bool mode_DVD)
     return (IOP_CLOCK * block_size) / (speed * (mode_DVD ? PSX_DVD_READSPEED : PSX_CD_READSPEED));
 }
 
-CDVD_Drive::CDVD_Drive(Emulator* e, IOP_DMA* dma) : e(e), dma(dma), container(CDVD_CONTAINER::ISO)
+CDVD_Drive::CDVD_Drive(Emulator* e, IOP_DMA* dma) :
+    e(e), dma(dma), container(CDVD_CONTAINER::ISO),
+    read_ahead([this](uint64_t offset, uint8_t* dst, size_t size) { return read_disc(offset, dst, size); })
 {
 
 }
@@ -48,16 +52,24 @@ bool CDVD_Drive::container_open(const char* file_path)
         file_size = cdvd_file.tellg();
         return true;
     }
-    else if (container == CDVD_CONTAINER::CISO)
+    
+    if (container == CDVD_CONTAINER::CISO)
+        compressed_file.reset(new CSO_Reader());
+    else if (container == CDVD_CONTAINER::ZSO)
+        compressed_file.reset(new ZSO_Reader());
+    else if (container == CDVD_CONTAINER::BGZF)
+        compressed_file.reset(new BGZF_Reader());
+    else
+        return false;
+
+    if (!compressed_file->open(file_path))
     {
-        if (!cso_file.open(file_path))
-            return false;
-        
-        file_size = cso_file.get_size();
-        return true;
+        compressed_file.reset();
+        return false;
     }
-    
-    return false;
+
+    file_size = compressed_file->get_size();
+    return true;
 }
 
 void CDVD_Drive::container_close()
@@ -67,9 +79,9 @@ void CDVD_Drive::container_close()
         if (cdvd_file.is_open())
             cdvd_file.close();
     }
-    else if (container == CDVD_CONTAINER::CISO)
+    else
     {
-        cso_file.close();
+        compressed_file.reset();
     }
 }
 
@@ -79,9 +91,9 @@ bool CDVD_Drive::container_isopen()
     {
         return cdvd_file.is_open();
     }
-    else if (container == CDVD_CONTAINER::CISO)
+    else if (compressed_file)
     {
-        return cso_file.isopen();
+        return compressed_file->isopen();
     }
     
     return false;
@@ -93,9 +105,9 @@ void CDVD_Drive::container_seek(std::ios::streamoff ofs, std::ios::seekdir whenc
     {
         cdvd_file.seekg(ofs, whence);
     }
-    else if (container == CDVD_CONTAINER::CISO)
+    else if (compressed_file)
     {
-        cso_file.seek((int64_t)ofs, whence);
+        compressed_file->seek((int64_t)ofs, whence);
     }
 }
 
@@ -105,9 +117,9 @@ uint64_t CDVD_Drive::container_tell()
     {
         return cdvd_file.tellg();
     }
-    else if (container == CDVD_CONTAINER::CISO)
+    else if (compressed_file)
     {
-        return cso_file.tell();
+        return compressed_file->tell();
     }
     
     return 0;
@@ -120,17 +132,35 @@ size_t CDVD_Drive::container_read(void* dst, size_t size)
         cdvd_file.read((char*)dst, size);
         return cdvd_file.gcount();
     }
-    else if (container == CDVD_CONTAINER::CISO)
+    else if (compressed_file)
     {
-        return cso_file.read((uint8_t*)dst, size);
+        return compressed_file->read((uint8_t*)dst, size);
     }
     
     return 0;
 }
 
+//Called from the read-ahead worker
+size_t CDVD_Drive::read_disc(uint64_t offset, uint8_t* dst, size_t size)
+{
+    std::lock_guard<std::mutex> lock(container_mutex);
+    if (!container_isopen())
+        return 0;
+    container_seek(offset);
+    return container_read(dst, size);
+}
+
+//Bytes a read command takes from the disc image per sector
+uint64_t CDVD_Drive::get_stream_sector_size()
+{
+    if (N_command == 0x06 && block_size != 2340)
+        return block_size;
+    return 2048;
+}
 
 void CDVD_Drive::reset()
 {
+    read_ahead.stop();
     speed = 4;
     current_sector = 0;
     cycle_count = 0;
@@ -311,6 +341,9 @@ void CDVD_Drive::handle_N_command()
 
 bool CDVD_Drive::load_disc(const char *name, CDVD_CONTAINER a_container)
 {
+    read_ahead.stop();
+    std::lock_guard<std::mutex> lock(container_mutex);
+    container_close();
     container = a_container;
     if (!container_open(name))
         return false;
@@ -344,6 +377,7 @@ bool CDVD_Drive::load_disc(const char *name, CDVD_CONTAINER a_container)
 
 uint8_t* CDVD_Drive::read_file(string name, uint32_t& file_size)
 {
+    std::lock_guard<std::mutex> lock(container_mutex);
     uint8_t* root_extent = new uint8_t[root_len];
     container_seek(root_location);
     container_read(root_extent, root_len);
@@ -735,7 +769,11 @@ void CDVD_Drive::start_seek()
     if (seek_to > block_count)
         Errors::die("[CDVD] Invalid sector read $%08X (max size: $%08X)", seek_to, block_count);
 
-    container_seek((uint64_t)seek_to * 2048);
+    //Start fetching now, so the data is ready by the time the emulated seek is done
+    uint64_t stream_length = 0;
+    if (N_command == 0x06 || N_command == 0x08)
+        stream_length = sectors_left * get_stream_sector_size();
+    read_ahead.start((uint64_t)seek_to * 2048, stream_length);
 
     add_event(cycles_to_seek);
 }
@@ -849,7 +887,7 @@ void CDVD_Drive::read_CD_sector()
             fill_CDROM_sector();
             break;
         default:
-            container_read(read_buffer, block_size);
+            read_ahead.read(read_buffer, block_size);
             break;
     }
     //container_read(read_buffer, block_size);
@@ -878,7 +916,7 @@ void CDVD_Drive::fill_CDROM_sector()
     temp_buffer[0xD] = itob(seconds);
     temp_buffer[0xE] = itob(fragments);
     temp_buffer[0xF] = 1;
-    container_read(&temp_buffer[0x10 + 0x8], 2048);
+    read_ahead.read(&temp_buffer[0x10 + 0x8], 2048);
 
     memcpy(read_buffer, temp_buffer + 0xC, 2340);
 }
@@ -915,7 +953,7 @@ void CDVD_Drive::read_DVD_sector()
     read_buffer[9] = 0;
     read_buffer[10] = 0;
     read_buffer[11] = 0;
-    container_read(&read_buffer[12], 2048);
+    read_ahead.read(&read_buffer[12], 2048);
     read_buffer[2060] = 0;
     read_buffer[2061] = 0;
     read_buffer[2062] = 0;
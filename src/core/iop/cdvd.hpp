@@ -1,8 +1,11 @@
 #ifndef CDVD_HPP
 #define CDVD_HPP
 
-#include "cso_reader.hpp"
+#include "cdvd_readahead.hpp"
+#include "compressed_container.hpp"
 #include <fstream>
+#include <memory>
+#include <mutex>
 
 class Emulator;
 class IOP_DMA;
@@ -10,7 +13,9 @@ class IOP_DMA;
 enum CDVD_CONTAINER
 {
     ISO,
-    CISO
+    CISO,
+    ZSO,
+    BGZF
 };
 
 enum CDVD_STATUS
@@ -53,7 +58,12 @@ class CDVD_Drive
         IOP_DMA* dma;
         CDVD_CONTAINER container;
         std::ifstream cdvd_file;
-        CSO_Reader cso_file;
+        std::unique_ptr<CompressedContainer> compressed_file;
+
+        //Held by anything that moves the container's read position, as the read-ahead worker shares it
+        std::mutex container_mutex;
+        CDVD_ReadAhead read_ahead;
+
         uint64_t file_size;
         int read_bytes_left;
         int speed;
@@ -99,6 +109,8 @@ class CDVD_Drive
         void container_seek(std::ios::streamoff ofs, std::ios::seekdir whence = std::ios::beg);
         uint64_t container_tell();
         size_t container_read(void* dst, size_t size);
+        size_t read_disc(uint64_t offset, uint8_t* dst, size_t size);
+        uint64_t get_stream_sector_size();
 
         void start_seek();
         void prepare_S_outdata(int amount);
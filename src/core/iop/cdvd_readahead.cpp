@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cstring>
+#include "cdvd_readahead.hpp"
+
+CDVD_ReadAhead::CDVD_ReadAhead(ReadFunc read_func) :
+    read_func(read_func), quit(false), buffer(BUFFER_SIZE), read_pos(0), fill_pos(0), stream_end(0),
+    end_of_disc(false), generation(0)
+{
+
+}
+
+CDVD_ReadAhead::~CDVD_ReadAhead()
+{
+    if (!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    notifier.notify_all();
+    thread.join();
+}
+
+void CDVD_ReadAhead::start(uint64_t offset, uint64_t length)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        read_pos = offset;
+        fill_pos = offset;
+        stream_end = offset + length;
+        end_of_disc = false;
+    }
+
+    //The worker is only spun up once a disc is actually read from
+    if (!thread.joinable())
+        thread = std::thread(&CDVD_ReadAhead::worker_loop, this);
+    notifier.notify_all();
+}
+
+//Drops whatever is buffered. Anything still being read in the background is discarded once it completes.
+void CDVD_ReadAhead::stop()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    generation++;
+    fill_pos = read_pos;
+    stream_end = read_pos;
+}
+
+void CDVD_ReadAhead::read(uint8_t* dst, size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t end = read_pos + size;
+    if (end > stream_end)
+    {
+        stream_end = end;
+        notifier.notify_all();
+    }
+
+    notifier.wait(lock, [&] { return fill_pos >= end || end_of_disc; });
+
+    //Past the end of the disc image there's nothing to read, so hand back zeroes
+    size_t available = std::min((uint64_t)size, fill_pos - read_pos);
+    size_t start = read_pos % BUFFER_SIZE;
+    size_t first = std::min(available, BUFFER_SIZE - start);
+    memcpy(dst, &buffer[start], first);
+    memcpy(dst + first, &buffer[0], available - first);
+    memset(dst + available, 0, size - available);
+
+    read_pos += available;
+    notifier.notify_all();
+}
+
+uint64_t CDVD_ReadAhead::tell()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return read_pos;
+}
+
+void CDVD_ReadAhead::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        notifier.wait(lock, [this] {
+            return quit || (!end_of_disc && fill_pos < stream_end && fill_pos - read_pos < BUFFER_SIZE);
+        });
+        if (quit)
+            return;
+
+        //Only ever read into free space up to the end of the ring, so the drive never sees a partial chunk
+        size_t start = fill_pos % BUFFER_SIZE;
+        size_t size = std::min({(uint64_t)CHUNK_SIZE, stream_end - fill_pos, BUFFER_SIZE - (fill_pos - read_pos)});
+        size = std::min(size, BUFFER_SIZE - start);
+        uint64_t offset = fill_pos;
+        uint32_t read_generation = generation;
+
+        lock.unlock();
+        size_t bytes = read_func(offset, &buffer[start], size);
+        lock.lock();
+
+        if (read_generation != generation)
+            continue;
+
+        fill_pos += bytes;
+        if (bytes < size)
+            end_of_disc = true;
+        notifier.notify_all();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef CDVD_READAHEAD_HPP
+#define CDVD_READAHEAD_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+  * Streams disc data on a worker thread ahead of the emulated drive.
+  * A read command starts a stream as soon as it's issued, so host I/O overlaps with the emulated seek and transfer
+  * time. The drive then consumes the stream in order and only blocks when the host hasn't caught up yet.
+  */
+class CDVD_ReadAhead
+{
+    public:
+        //Reads up to size bytes at offset and returns how many were read
+        typedef std::function<size_t(uint64_t offset, uint8_t* dst, size_t size)> ReadFunc;
+    private:
+        constexpr static size_t BUFFER_SIZE = 512 * 1024;
+        constexpr static size_t CHUNK_SIZE = 64 * 1024;
+
+        ReadFunc read_func;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable notifier;
+        bool quit;
+
+        //Absolute disc offsets. Data in [read_pos, fill_pos) is in the buffer, and the worker stops at stream_end.
+        std::vector<uint8_t> buffer;
+        uint64_t read_pos;
+        uint64_t fill_pos;
+        uint64_t stream_end;
+        bool end_of_disc;
+
+        //Bumped on every restart, so a read that was in flight for an old stream gets thrown away
+        uint32_t generation;
+
+        void worker_loop();
+    public:
+        CDVD_ReadAhead(ReadFunc read_func);
+        ~CDVD_ReadAhead();
+
+        //length is only a hint of how much will be read, reading past it keeps the stream going
+        void start(uint64_t offset, uint64_t length);
+        void stop();
+
+        void read(uint8_t* dst, size_t size);
+        uint64_t tell();
+};
+
+#endif // CDVD_READAHEAD_HPP
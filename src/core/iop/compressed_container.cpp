@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <libdeflate.h>
+#include "compressed_container.hpp"
+
+#include "../errors.hpp"
+
+BlockDecoder::BlockDecoder()
+{
+    inflate = libdeflate_alloc_decompressor();
+    if (!inflate)
+        Errors::die("[CDVD] Failed to allocate decompressor");
+}
+
+BlockDecoder::~BlockDecoder()
+{
+    libdeflate_free_decompressor(inflate);
+}
+
+CompressedContainer::CompressedContainer() :
+    quit(false), prefetch_pos(0), prefetch_end(0), prefetch_blocks(0), opened(false), virtptr(0),
+    size(0), num_blocks(0), max_block_size(0)
+{
+
+}
+
+//Derived classes must close() in their own destructor, as the prefetcher calls into them
+CompressedContainer::~CompressedContainer()
+{
+    stop_prefetch();
+}
+
+bool CompressedContainer::open(const char* path)
+{
+    close();
+    if (!open_file(path))
+    {
+        close_file();
+        return false;
+    }
+
+    size_t slot_count = std::max((size_t)16, CACHE_SIZE / max_block_size);
+    cache_data.resize(slot_count * max_block_size);
+    slots.resize(slot_count);
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        slots[i].mapped = false;
+        slots[i].ready = true;
+        slots[i].lru_pos = lru.insert(lru.end(), (int)i);
+    }
+
+    prefetch_blocks = (uint32_t)std::max((size_t)2, PREFETCH_SIZE / max_block_size);
+    prefetch_pos = 0;
+    prefetch_end = 0;
+    virtptr = 0;
+    opened = true;
+    return true;
+}
+
+void CompressedContainer::close()
+{
+    stop_prefetch();
+
+    slot_of_block.clear();
+    slots.clear();
+    lru.clear();
+    std::vector<uint8_t>().swap(cache_data);
+
+    close_file();
+    opened = false;
+    virtptr = 0;
+    size = 0;
+    num_blocks = 0;
+    max_block_size = 0;
+}
+
+uint64_t CompressedContainer::get_size()
+{
+    return size;
+}
+
+bool CompressedContainer::isopen()
+{
+    return opened;
+}
+
+void CompressedContainer::seek(int64_t ofs, std::ios::seekdir whence)
+{
+    if (whence == std::ios::beg)
+    {
+        if ((uint64_t)ofs < size)
+            virtptr = (uint64_t)ofs;
+    }
+    else if (whence == std::ios::cur)
+    {
+        if (virtptr + ofs < size)
+            virtptr = virtptr + ofs;
+    }
+    else if (whence == std::ios::end)
+    {
+        if (size - ofs < size)
+            virtptr = size - ofs;
+    }
+}
+
+uint64_t CompressedContainer::tell()
+{
+    return virtptr;
+}
+
+uint64_t CompressedContainer::read(uint8_t* dst, uint64_t length)
+{
+    if (!opened || virtptr >= size)
+        return 0;
+    length = std::min(length, size - virtptr);
+    if (!length)
+        return 0;
+
+    std::unique_lock<std::mutex> lock(cache_mutex);
+
+    //Start on whatever follows this read right away, so it decodes while we work through this one
+    request_prefetch(get_block_at(virtptr + length - 1));
+
+    uint64_t total_read = 0;
+    while (length)
+    {
+        uint32_t block = get_block_at(virtptr);
+        int slot = find_block(block, lock);
+        if (slot == NO_SLOT)
+            slot = load_block(block, decoder, lock);
+        if (slot == NO_SLOT)
+            break;
+        touch(slot);
+
+        uint64_t block_start = get_block_start(block);
+        uint64_t block_end = std::min(get_block_start(block + 1), size);
+        uint64_t chunk = std::min(length, block_end - virtptr);
+        memcpy(dst, slot_data(slot) + (virtptr - block_start), chunk);
+
+        dst += chunk;
+        virtptr += chunk;
+        total_read += chunk;
+        length -= chunk;
+    }
+
+    return total_read;
+}
+
+uint8_t* CompressedContainer::slot_data(int slot)
+{
+    return &cache_data[(size_t)slot * max_block_size];
+}
+
+//Returns the slot holding a block, waiting if another thread is still decoding it
+int CompressedContainer::find_block(uint32_t block, std::unique_lock<std::mutex>& lock)
+{
+    while (true)
+    {
+        auto it = slot_of_block.find(block);
+        if (it == slot_of_block.end())
+            return NO_SLOT;
+        if (slots[it->second].ready)
+            return it->second;
+        notifier.wait(lock);
+    }
+}
+
+//Decodes a block that isn't cached into the least recently used slot. The cache lock is dropped while decoding.
+int CompressedContainer::load_block(uint32_t block, BlockDecoder& block_decoder, std::unique_lock<std::mutex>& lock)
+{
+    //Only slots that aren't being decoded into can be evicted
+    int slot = NO_SLOT;
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it)
+    {
+        if (slots[*it].ready)
+        {
+            slot = *it;
+            break;
+        }
+    }
+    if (slot == NO_SLOT)
+        Errors::die("[CDVD] No block cache slot free to decode block %u into", block);
+
+    if (slots[slot].mapped)
+        slot_of_block.erase(slots[slot].block);
+    slots[slot].block = block;
+    slots[slot].mapped = true;
+    slots[slot].ready = false;
+    slot_of_block[block] = slot;
+    touch(slot);
+
+    lock.unlock();
+    int64_t decoded = decode_block(block, slot_data(slot), block_decoder);
+    lock.lock();
+
+    slots[slot].ready = true;
+    uint64_t expected = std::min(get_block_start(block + 1), size) - get_block_start(block);
+    if (decoded < 0 || (uint64_t)decoded < expected)
+    {
+        if (decoded >= 0)
+            printf("[CDVD] Block %u decoded to less than its size\n", block);
+        slot_of_block.erase(block);
+        slots[slot].mapped = false;
+        lru.splice(lru.end(), lru, slots[slot].lru_pos);
+        slot = NO_SLOT;
+    }
+
+    notifier.notify_all();
+    return slot;
+}
+
+void CompressedContainer::touch(int slot)
+{
+    lru.splice(lru.begin(), lru, slots[slot].lru_pos);
+}
+
+void CompressedContainer::request_prefetch(uint32_t last_block)
+{
+    uint32_t start = last_block + 1;
+    uint32_t end = std::min(num_blocks, start + prefetch_blocks);
+
+    //Anything outside the new window is either already read or was left behind by a seek
+    if (prefetch_pos < start || prefetch_pos > end)
+        prefetch_pos = start;
+    prefetch_end = end;
+
+    if (!prefetch_thread.joinable())
+        prefetch_thread = std::thread(&CompressedContainer::prefetch_loop, this);
+    notifier.notify_all();
+}
+
+void CompressedContainer::stop_prefetch()
+{
+    if (!prefetch_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        quit = true;
+    }
+    notifier.notify_all();
+    prefetch_thread.join();
+    quit = false;
+}
+
+void CompressedContainer::prefetch_loop()
+{
+    BlockDecoder prefetch_decoder;
+    std::unique_lock<std::mutex> lock(cache_mutex);
+    while (true)
+    {
+        notifier.wait(lock, [this] { return quit || prefetch_pos < prefetch_end; });
+        if (quit)
+            return;
+
+        uint32_t block = prefetch_pos++;
+        if (slot_of_block.count(block))
+            continue;
+        load_block(block, prefetch_decoder, lock);
+    }
+}
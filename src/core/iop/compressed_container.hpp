@@ -0,0 +1,105 @@
+#ifndef COMPRESSED_CONTAINER_HPP
+#define COMPRESSED_CONTAINER_HPP
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct libdeflate_decompressor;
+
+//Per-thread scratch state for decoding blocks, as the prefetcher decodes alongside the reader
+struct BlockDecoder
+{
+    std::vector<uint8_t> raw;
+    libdeflate_decompressor* inflate;
+
+    BlockDecoder();
+    ~BlockDecoder();
+};
+
+/**
+  * Base for disc images stored as independently compressed blocks.
+  * Formats only have to describe their block layout and decode a single block. Decoded blocks are kept in an LRU
+  * cache, and a worker thread decodes the blocks following the last read so sequential reads rarely wait on
+  * decompression.
+  */
+class CompressedContainer
+{
+    private:
+        constexpr static size_t CACHE_SIZE = 8 * 1024 * 1024;
+        constexpr static size_t PREFETCH_SIZE = 256 * 1024;
+        constexpr static int NO_SLOT = -1;
+
+        struct CacheSlot
+        {
+            uint32_t block;
+            bool mapped;
+
+            //Cleared while a thread is decoding into the slot, which also keeps it from being evicted
+            bool ready;
+            std::list<int>::iterator lru_pos;
+        };
+
+        std::vector<uint8_t> cache_data;
+        std::vector<CacheSlot> slots;
+        std::unordered_map<uint32_t, int> slot_of_block;
+
+        //Most recently used at the front
+        std::list<int> lru;
+
+        std::thread prefetch_thread;
+        std::mutex cache_mutex;
+        std::condition_variable notifier;
+        bool quit;
+        uint32_t prefetch_pos;
+        uint32_t prefetch_end;
+        uint32_t prefetch_blocks;
+
+        bool opened;
+        uint64_t virtptr;
+        BlockDecoder decoder;
+
+        uint8_t* slot_data(int slot);
+        int find_block(uint32_t block, std::unique_lock<std::mutex>& lock);
+        int load_block(uint32_t block, BlockDecoder& block_decoder, std::unique_lock<std::mutex>& lock);
+        void touch(int slot);
+        void request_prefetch(uint32_t last_block);
+        void stop_prefetch();
+        void prefetch_loop();
+    protected:
+        //Guards the underlying file, which the reader and prefetcher share
+        std::mutex file_mutex;
+
+        uint64_t size;
+        uint32_t num_blocks;
+        uint32_t max_block_size;
+
+        //Must fill in size, num_blocks and max_block_size
+        virtual bool open_file(const char* path) = 0;
+        virtual void close_file() = 0;
+
+        virtual uint32_t get_block_at(uint64_t offset) = 0;
+        virtual uint64_t get_block_start(uint32_t block) = 0;
+
+        //Decodes a block into dst, which holds max_block_size bytes, and returns the decoded size or -1 on error.
+        //Called from both the reader and the prefetcher, so it must lock file_mutex around file access.
+        virtual int64_t decode_block(uint32_t block, uint8_t* dst, BlockDecoder& block_decoder) = 0;
+    public:
+        CompressedContainer();
+        virtual ~CompressedContainer();
+
+        bool open(const char* path);
+        void close();
+
+        uint64_t get_size();
+        bool isopen();
+        void seek(int64_t ofs, std::ios::seekdir whence);
+        uint64_t tell();
+        uint64_t read(uint8_t* dst, uint64_t length);
+};
+
+#endif // COMPRESSED_CONTAINER_HPP
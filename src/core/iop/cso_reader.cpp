@@ -1,5 +1,5 @@
 /*
-CSO (v0, v1) decoder implementation
+CSO (v0, v1) and ZSO decoder implementation
  copyleft 2019 a dinosaur
 
 Based off reference by unknownbrackets:
@@ -8,8 +8,8 @@ Based off reference by unknownbrackets:
 
 #include "cso_reader.hpp"
 #include <libdeflate.h>
+#include <algorithm>
 #include <cstring>
-#include <cassert>
 
 constexpr uint32_t FOURCC(const char chars[4])
 {
@@ -43,12 +43,13 @@ struct CSO_Header
 #define IDX_COMPRESS_BIT (0x80000000)
 
 
-CSO_Reader::CSO_Reader() :
-    m_size(0), m_shift(0), m_blocksize(0), m_version(0), m_virtptr(0),
+CSO_Reader::CSO_Reader() : CSO_Reader("CISO", "CSO") {}
+
+CSO_Reader::CSO_Reader(const char* magic, const char* format) :
+    m_magic(magic), m_format(format),
+    m_shift(0), m_blocksize(0), m_version(0),
     m_indices(nullptr),
-    m_framesize(0), m_curframe(0xFFFFFFFF),
-    m_frame(nullptr), m_readbuf(nullptr),
-    m_inflate(nullptr) {}
+    m_framesize(0) {}
 
 CSO_Reader::~CSO_Reader()
 {
@@ -61,11 +62,6 @@ uint8_t CSO_Reader::get_version()
     return m_version;
 }
 
-uint64_t CSO_Reader::get_size()
-{
-    return m_size;
-}
-
 uint32_t CSO_Reader::get_blocksize()
 {
     return m_blocksize;
@@ -73,129 +69,65 @@ uint32_t CSO_Reader::get_blocksize()
 
 uint32_t CSO_Reader::get_numblocks()
 {
-    return (uint32_t)(m_size / m_blocksize);
+    return num_blocks;
 }
 
 
-bool CSO_Reader::isopen()
+uint32_t CSO_Reader::get_block_at(uint64_t offset)
 {
-    return m_file.is_open();
-}
-
-void CSO_Reader::seek(int64_t ofs, std::ios::seekdir whence)
-{
-    if (whence == std::ios::beg)
-    {
-        if ((uint64_t)ofs < m_size)
-            m_virtptr = (uint64_t)ofs;
-    }
-    else
-    if (whence == std::ios::cur)
-    {
-        if (m_virtptr + ofs < m_size)
-            m_virtptr = m_virtptr + ofs;
-    }
-    else
-    if (whence == std::ios::end)
-    {
-        if (m_size - ofs < m_size)
-            m_virtptr = m_size - ofs;
-    }
+    return (uint32_t)(offset / m_blocksize);
 }
 
-uint64_t CSO_Reader::tell()
+uint64_t CSO_Reader::get_block_start(uint32_t block)
 {
-    return m_virtptr;
+    return (uint64_t)block * m_blocksize;
 }
 
-bool CSO_Reader::read_block_internal(uint32_t block)
+int64_t CSO_Reader::decode_block(uint32_t block, uint8_t* dst, BlockDecoder& block_decoder)
 {
-    // if this block was decoded last time we don't need to do it again
-    if (block == m_curframe)
-        return true;
-    
     uint32_t index = m_indices[block];
     uint64_t ofs = (uint64_t)(index & ~IDX_COMPRESS_BIT) << m_shift;
     uint64_t len = ((uint64_t)(m_indices[block + 1] & ~IDX_COMPRESS_BIT) << m_shift) - ofs;
     
-    if (index & IDX_COMPRESS_BIT) // if uncompressed
+    block_decoder.raw.resize(len);
     {
+        std::lock_guard<std::mutex> lock(file_mutex);
         m_file.seekg(ofs, std::ios::beg);
-        m_file.read((char*)m_frame, len);
+        m_file.read((char*)block_decoder.raw.data(), len);
         if ((uint64_t)m_file.gcount() != len)
         {
-            fprintf(stderr, "read error reading (uncompressed) block %d\n", block);
-            m_curframe = 0xFFFFFFFF;
-            return false;
+            fprintf(stderr, "read error reading block %d\n", block);
+            m_file.clear();
+            return -1;
         }
     }
-    else // compressed
+    
+    if (index & IDX_COMPRESS_BIT) // if uncompressed
     {
-        m_file.seekg(ofs, std::ios::beg);
-        m_file.read((char*)m_readbuf, len);
-        if ((uint64_t)m_file.gcount() != len)
-        {
-            fprintf(stderr, "read error reading (compressed) block %d\n", block);
-            return false;
-        }
-        
-        size_t read;
-        auto res = libdeflate_deflate_decompress(m_inflate, m_readbuf, len, m_frame, m_framesize, &read);
-        if (res != LIBDEFLATE_SUCCESS)
-        {
-            fprintf(stderr, "libdeflate error on block %d: %d\n", block, res);
-            m_curframe = 0xFFFFFFFF;
-            return false;
-        }
-        
-        if (read < m_blocksize)
-        {
-            fprintf(stderr, "compressed sector %d decoded to less than the blocksize\n", block);
-            m_curframe = 0xFFFFFFFF;
-            return false;
-        }
+        // the stored block may be padded out to the index alignment
+        len = std::min(len, (uint64_t)m_blocksize);
+        memcpy(dst, block_decoder.raw.data(), len);
+        return len;
     }
     
-    m_curframe = block;
-    return true;
+    return decompress(block_decoder.raw.data(), len, dst, block_decoder);
 }
 
-uint64_t CSO_Reader::read(uint8_t* dst, uint64_t size)
+int64_t CSO_Reader::decompress(const uint8_t* src, uint64_t len, uint8_t* dst, BlockDecoder& block_decoder)
 {
-    assert(size);
-    assert(m_virtptr + size <= m_size);
-    
-    const uint64_t start = m_virtptr;
-    const uint64_t end = start + size;
-    const auto start_block = (uint32_t)(start / m_blocksize);
-    const auto end_block = (uint32_t)(end / m_blocksize);
-    
-    uint64_t total_read = 0;
-    for (uint32_t i = start_block; i <= end_block; ++i)
+    size_t read;
+    auto res = libdeflate_deflate_decompress(block_decoder.inflate, src, len, dst, max_block_size, &read);
+    if (res != LIBDEFLATE_SUCCESS)
     {
-        if (!read_block_internal(i))
-            return total_read;
-        
-        const uint64_t local_ofs = start - (uint64_t)start_block * m_blocksize;
-        uint64_t readlen = m_blocksize;
-        if (i == start_block)
-            readlen -= local_ofs;
-        if (i == end_block)
-            readlen -= m_blocksize - (end - (uint64_t)end_block * m_blocksize);
-
-        memcpy(dst, m_frame + local_ofs, readlen);
-        total_read += readlen;
-        m_virtptr += readlen;
-        dst += readlen;
+        fprintf(stderr, "libdeflate error: %d\n", res);
+        return -1;
     }
-    
-    return total_read;
+    return read;
 }
 
 
-bool CSO_Reader::open(const char* path)
+bool CSO_Reader::open_file(const char* path)
 {
-    close();
     m_file = std::ifstream(path, std::ios::binary | std::ios::ate);
     if (!m_file.is_open())
     {
@@ -215,14 +147,14 @@ bool CSO_Reader::open(const char* path)
     m_file.read((char*)header.reserved, 2 * sizeof(uint8_t));
     
     // validate header
-    if (header.magic != FOURCC("CISO"))
+    if (header.magic != FOURCC(m_magic))
     {
-        fprintf(stderr, "file is not a CSO!\n");
+        fprintf(stderr, "file is not a %s!\n", m_format);
         return false;
     }
     if (header.version > 1)
     {
-        fprintf(stderr, "unsupported CSO version or corrupt file\n");
+        fprintf(stderr, "unsupported %s version or corrupt file\n", m_format);
         return false;
     }
     
@@ -240,8 +172,7 @@ bool CSO_Reader::open(const char* path)
     m_file.read((char*)m_indices, num_entries * sizeof(uint32_t));
     if ((uint32_t)m_file.gcount() != num_entries * sizeof(uint32_t))
     {
-        fprintf(stderr, "failed to read CSO indices\n");
-        close();
+        fprintf(stderr, "failed to read %s indices\n", m_format);
         return false;
     }
     
@@ -249,8 +180,7 @@ bool CSO_Reader::open(const char* path)
     uint32_t lastidx = m_indices[0];
     if ((lastidx & ~IDX_COMPRESS_BIT) << header.index_shift < 0x18)
     {
-        fprintf(stderr, "CSO indices are corrupted (starts within header)\n");
-        close();
+        fprintf(stderr, "%s indices are corrupted (starts within header)\n", m_format);
         return false;
     }
     
@@ -260,8 +190,7 @@ bool CSO_Reader::open(const char* path)
         uint32_t lastpos = (lastidx & ~IDX_COMPRESS_BIT) << header.index_shift;
         if (lastpos > file_len)
         {
-            fprintf(stderr, "CSO indices are corrupted (outside file)\n");
-            close();
+            fprintf(stderr, "%s indices are corrupted (outside file)\n", m_format);
             return false;
         }
         
@@ -270,56 +199,36 @@ bool CSO_Reader::open(const char* path)
         uint32_t len = pos - lastpos;
         if (len <= 0)
         {
-            fprintf(stderr, "CSO indices are corrupted (out of order)\n");
-            close();
+            fprintf(stderr, "%s indices are corrupted (out of order)\n", m_format);
             return false;
         }
         else if (len > framesize)
         {
-            fprintf(stderr, "CSO indices are corrupted (index too large)\n");
-            close();
+            fprintf(stderr, "%s indices are corrupted (index too large)\n", m_format);
             return false;
         }
         else if ((lastidx & IDX_COMPRESS_BIT) && len < header.block_len)
         {
-            fprintf(stderr, "CSO indices are corrupted (uncompressed index smaller than block size)\n");
-            close();
+            fprintf(stderr, "%s indices are corrupted (uncompressed index smaller than block size)\n", m_format);
             return false;
         }
         lastidx = idx;
     }
     
     m_version = header.version;
-    m_size = header.raw_len;
     m_shift = header.index_shift;
     m_blocksize = header.block_len;
     m_framesize = framesize;
-    m_frame = new uint8_t[m_framesize];
-    m_readbuf = new uint8_t[m_framesize];
     
-    // setup libdeflate
-    m_inflate = libdeflate_alloc_decompressor();
-    if (!m_inflate)
-    {
-        fprintf(stderr, "failed to allocate decompressor\n");
-        close();
-        return false;
-    }
+    size = header.raw_len;
+    num_blocks = num_entries - 1;
+    max_block_size = m_framesize;
     
     return true;
 }
 
-void CSO_Reader::close()
+void CSO_Reader::close_file()
 {
-    libdeflate_free_decompressor(m_inflate);
-    m_inflate = nullptr;
-    
-    delete[] m_readbuf;
-    m_readbuf = nullptr;
-
-    delete[] m_frame;
-    m_frame = nullptr;
-    
     delete[] m_indices;
     m_indices = nullptr;
 
@@ -327,10 +236,90 @@ void CSO_Reader::close()
         m_file.close();
     
     m_version = 0;
-    m_virtptr = 0;
-    m_size = 0;
     m_shift = 0;
     m_blocksize = 0;
     m_framesize = 0;
-    m_curframe = 0xFFFFFFFF;
+}
+
+
+// LZ4 block format: https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// Stops once size bytes are decoded, as LZ4 blocks have no end marker and stored blocks may be padded.
+static int64_t lz4_decompress(const uint8_t* src, uint64_t len, uint8_t* dst, uint64_t size)
+{
+    const uint8_t* ip = src;
+    const uint8_t* iend = src + len;
+    uint8_t* op = dst;
+    uint8_t* oend = dst + size;
+    
+    auto read_length = [&](uint64_t& length) {
+        uint8_t byte;
+        do
+        {
+            if (ip >= iend)
+                return false;
+            byte = *ip++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    };
+    
+    while (ip < iend)
+    {
+        uint8_t token = *ip++;
+        
+        uint64_t literals = token >> 4;
+        if (literals == 15 && !read_length(literals))
+            return -1;
+        if (literals > (uint64_t)(iend - ip) || literals > (uint64_t)(oend - op))
+            return -1;
+        memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+        
+        // the last sequence is literals only
+        if (ip == iend || op == oend)
+            break;
+        
+        if (iend - ip < 2)
+            return -1;
+        uint64_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (!offset || offset > (uint64_t)(op - dst))
+            return -1;
+        
+        uint64_t match_len = token & 0xF;
+        if (match_len == 15 && !read_length(match_len))
+            return -1;
+        match_len += 4;
+        if (match_len > (uint64_t)(oend - op))
+            return -1;
+        
+        const uint8_t* match = op - offset;
+        if (offset >= match_len)
+            memcpy(op, match, match_len);
+        else
+        {
+            // overlapping matches repeat the last offset bytes
+            for (uint64_t i = 0; i < match_len; ++i)
+                op[i] = match[i];
+        }
+        op += match_len;
+    }
+    
+    return op - dst;
+}
+
+ZSO_Reader::ZSO_Reader() : CSO_Reader("ZISO", "ZSO") {}
+
+ZSO_Reader::~ZSO_Reader()
+{
+    close();
+}
+
+int64_t ZSO_Reader::decompress(const uint8_t* src, uint64_t len, uint8_t* dst, BlockDecoder& block_decoder)
+{
+    int64_t read = lz4_decompress(src, len, dst, m_blocksize);
+    if (read < 0)
+        fprintf(stderr, "corrupt LZ4 data\n");
+    return read;
 }
@@ -3,44 +3,51 @@
 
 #include <fstream>
 #include <cstdint>
+#include "compressed_container.hpp"
 
-class CSO_Reader
+class CSO_Reader : public CompressedContainer
 {
 protected:
+    const char* m_magic;
+    const char* m_format;
+
     std::ifstream m_file;
-    uint64_t m_size;
     uint32_t m_shift;
     uint32_t m_blocksize;
     uint8_t m_version;
-    uint64_t m_virtptr;
     
     uint32_t* m_indices;
     
     uint32_t m_framesize;
-    uint32_t m_curframe;
-    uint8_t* m_frame;
-    uint8_t* m_readbuf;
-    
-    struct libdeflate_decompressor* m_inflate;
     
-    bool read_block_internal(uint32_t block);
+    CSO_Reader(const char* magic, const char* format);
+
+    virtual int64_t decompress(const uint8_t* src, uint64_t len, uint8_t* dst, BlockDecoder& block_decoder);
+
+    bool open_file(const char* path) override;
+    void close_file() override;
+    uint32_t get_block_at(uint64_t offset) override;
+    uint64_t get_block_start(uint32_t block) override;
+    int64_t decode_block(uint32_t block, uint8_t* dst, BlockDecoder& block_decoder) override;
     
 public:
     CSO_Reader();
     ~CSO_Reader();
     
     uint8_t get_version();
-    uint64_t get_size();
     uint32_t get_blocksize();
     uint32_t get_numblocks();
-    
-    bool isopen();
-    void seek(int64_t ofs, std::ios::seekdir whence);
-    uint64_t tell();
-    uint64_t read(uint8_t* dst, uint64_t size);
-    
-    bool open(const char* path);
-    void close();
+};
+
+// ZSO shares the CSO layout, but compresses blocks with LZ4, which decodes several times faster than deflate
+class ZSO_Reader : public CSO_Reader
+{
+protected:
+    int64_t decompress(const uint8_t* src, uint64_t len, uint8_t* dst, BlockDecoder& block_decoder) override;
+
+public:
+    ZSO_Reader();
+    ~ZSO_Reader();
 };
 
 #endif//CSO_READER_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdio>
 #include "cdvd.hpp"
 #include "iop_dma.hpp"
@@ -25,6 +26,7 @@ void IOP_DMA::reset(uint8_t* RAM)
     this->RAM = RAM;
     active_channel = nullptr;
     queued_channels.clear();
+    stall_cycles = 0;
     for (int i = 0; i < 16; i++)
     {
         channels[i].addr = 0;
@@ -33,6 +35,7 @@ void IOP_DMA::reset(uint8_t* RAM)
         channels[i].control.busy = false;
         channels[i].control.sync_mode = 0;
         channels[i].dma_req = false;
+        channels[i].delay = 0;
         channels[i].index = i;
 
         DPCR.enable[i] = false;
@@ -52,15 +55,35 @@ void IOP_DMA::reset(uint8_t* RAM)
 
 void IOP_DMA::run(int cycles)
 {
-    while (cycles--)
+    while (cycles > 0)
     {
+        if (stall_cycles > 0)
+        {
+            int wait = std::min(cycles, stall_cycles);
+            stall_cycles -= wait;
+            cycles -= wait;
+            continue;
+        }
+
         if (!active_channel)
             break;
 
         (this->*active_channel->func)();
+        cycles--;
     }
 }
 
+/**
+ * The last word of a transfer is always moved on its own, so that the transfer ends (and the channel frees the
+ * engine) on the same cycle as it would have word by word.
+ */
+int IOP_DMA::bulk_words(uint32_t words_left)
+{
+    if (words_left <= 1)
+        return 1;
+    return std::min(words_left - 1, (uint32_t)MAX_BULK_WORDS);
+}
+
 void IOP_DMA::process_CDVD()
 {
     uint32_t count = channels[IOP_CDVD].word_count * channels[IOP_CDVD].block_size * 4;
@@ -79,36 +102,38 @@ void IOP_DMA::process_CDVD()
 void IOP_DMA::process_SPU()
 {
     bool write_to_spu = channels[IOP_SPU].control.direction_from;
+    e->sync_spu();
     if (spu->running_ADMA())
     {
         if (!write_to_spu)
             Errors::die("[IOP_DMA] SPU doing ADMA read!");
-        spu->write_ADMA(RAM + channels[IOP_SPU].addr);
+        //ADMA moves a word per cycle until the SPU's input buffer is full
+        int words = bulk_words(channels[IOP_SPU].size);
+        words = spu->write_ADMA(words);
+        e->update_spu_block();
         //printf("[IOP DMA] SPU transfer: $%08X\n", channels[IOP_SPU].size * 2);
-        channels[IOP_SPU].size--;
-        channels[IOP_SPU].addr += 4;
+        channels[IOP_SPU].size -= words;
+        channels[IOP_SPU].addr += words * 4;
+        stall_cycles = channels[IOP_SPU].size ? words - 1 : 0;
     }
     else
     {
-        if (channels[IOP_SPU].delay <= 0)
+        //Wait out the startup delay, then move a word every 4 cycles
+        if (channels[IOP_SPU].delay > 0)
         {
-            //Normal DMA transfer
-            if (write_to_spu)
-            {
-                uint32_t value = *(uint32_t*)&RAM[channels[IOP_SPU].addr];
-                spu->write_DMA(value);
-            }
-            else
-            {
-                uint32_t value = spu->read_DMA();
-                *(uint32_t*)&RAM[channels[IOP_SPU].addr] = value;
-            }
-            channels[IOP_SPU].size--;
-            channels[IOP_SPU].addr += 4;
-            channels[IOP_SPU].delay = 3;
+            channels[IOP_SPU].delay--;
+            return;
         }
+
+        int words = bulk_words(channels[IOP_SPU].size);
+        uint32_t* data = (uint32_t*)&RAM[channels[IOP_SPU].addr];
+        if (write_to_spu)
+            spu->write_DMA(data, words);
         else
-            channels[IOP_SPU].delay--;
+            spu->read_DMA(data, words);
+        channels[IOP_SPU].size -= words;
+        channels[IOP_SPU].addr += words * 4;
+        stall_cycles = channels[IOP_SPU].size ? words * 4 - 1 : 0;
     }
 
     if (!channels[IOP_SPU].size)
@@ -116,6 +141,8 @@ void IOP_DMA::process_SPU()
         channels[IOP_SPU].word_count = 0;
         transfer_end(IOP_SPU);
         spu->finish_DMA();
+        //Headers may have changed under a voice that is about to hit IRQA
+        e->update_spu_block();
         return;
     }
 }
@@ -123,36 +150,38 @@ void IOP_DMA::process_SPU()
 void IOP_DMA::process_SPU2()
 {
     bool write_to_spu = channels[IOP_SPU2].control.direction_from;
+    e->sync_spu();
     if (spu2->running_ADMA())
     {
         if (!write_to_spu)
             Errors::die("[IOP_DMA] SPU2 doing ADMA read!");
-        //Transfer 512 bytes of data (128 words) at once
-        spu2->write_ADMA(RAM + channels[IOP_SPU2].addr);
-        channels[IOP_SPU2].size--;
-        channels[IOP_SPU2].addr += 4;
+        //ADMA moves a word per cycle until the SPU's input buffer is full
+        int words = bulk_words(channels[IOP_SPU2].size);
+        words = spu2->write_ADMA(words);
+        e->update_spu_block();
+        //printf("[IOP DMA] SPU2 transfer: $%08X\n", channels[IOP_SPU2].size * 2);
+        channels[IOP_SPU2].size -= words;
+        channels[IOP_SPU2].addr += words * 4;
+        stall_cycles = channels[IOP_SPU2].size ? words - 1 : 0;
     }
     else
     {
-        if (channels[IOP_SPU2].delay <= 0)
+        //Wait out the startup delay, then move a word every 4 cycles
+        if (channels[IOP_SPU2].delay > 0)
         {
-            //Normal DMA transfer
-            if (write_to_spu)
-            {
-                uint32_t value = *(uint32_t*)&RAM[channels[IOP_SPU2].addr];
-                spu2->write_DMA(value);
-            }
-            else
-            {
-                uint32_t value = spu2->read_DMA();
-                *(uint32_t*)&RAM[channels[IOP_SPU2].addr] = value;
-            }
-            channels[IOP_SPU2].size--;
-            channels[IOP_SPU2].addr += 4;
-            channels[IOP_SPU2].delay = 3;
+            channels[IOP_SPU2].delay--;
+            return;
         }
+
+        int words = bulk_words(channels[IOP_SPU2].size);
+        uint32_t* data = (uint32_t*)&RAM[channels[IOP_SPU2].addr];
+        if (write_to_spu)
+            spu2->write_DMA(data, words);
         else
-            channels[IOP_SPU2].delay--;
+            spu2->read_DMA(data, words);
+        channels[IOP_SPU2].size -= words;
+        channels[IOP_SPU2].addr += words * 4;
+        stall_cycles = channels[IOP_SPU2].size ? words * 4 - 1 : 0;
     }
 
     if (!channels[IOP_SPU2].size)
@@ -160,6 +189,7 @@ void IOP_DMA::process_SPU2()
         channels[IOP_SPU2].word_count = 0;
         transfer_end(IOP_SPU2);
         spu2->finish_DMA();
+        e->update_spu_block();
         return;
     }
 }
@@ -169,11 +199,15 @@ void IOP_DMA::process_SIF0()
     static int junk_words = 0;
     if (channels[IOP_SIF0].word_count)
     {
-        uint32_t data = *(uint32_t*)&RAM[channels[IOP_SIF0].addr];
-        sif->write_SIF0(data);
-
-        channels[IOP_SIF0].addr += 4;
-        channels[IOP_SIF0].word_count--;
+        //Only move what fits, as the request would be dropped as soon as the FIFO filled up
+        int words = std::min(bulk_words(channels[IOP_SIF0].word_count),
+                             SubsystemInterface::MAX_FIFO_SIZE - sif->get_SIF0_size());
+        words = std::max(words, 1);
+        sif->write_SIF0((uint32_t*)&RAM[channels[IOP_SIF0].addr], words);
+
+        channels[IOP_SIF0].addr += words * 4;
+        channels[IOP_SIF0].word_count -= words;
+        stall_cycles = words - 1;
         if (!channels[IOP_SIF0].word_count)
         {
             sif->send_SIF0_junk(junk_words);
@@ -221,11 +255,14 @@ void IOP_DMA::process_SIF1()
 {
     if (channels[IOP_SIF1].word_count)
     {
-        uint32_t data = sif->read_SIF1();
-
-        *(uint32_t*)&RAM[channels[IOP_SIF1].addr] = data;
-        channels[IOP_SIF1].addr += 4;
-        channels[IOP_SIF1].word_count--;
+        //The request is dropped as soon as the FIFO runs dry, so never read past what's in it
+        int words = std::min(bulk_words(channels[IOP_SIF1].word_count), sif->get_SIF1_size());
+        words = std::max(words, 1);
+        sif->read_SIF1((uint32_t*)&RAM[channels[IOP_SIF1].addr], words);
+
+        channels[IOP_SIF1].addr += words * 4;
+        channels[IOP_SIF1].word_count -= words;
+        stall_cycles = words - 1;
         if (!channels[IOP_SIF1].word_count && channels[IOP_SIF1].tag_end)
             transfer_end(IOP_SIF1);
     }
@@ -85,11 +85,16 @@ class IOP_DMA
         IOP_DMA_Channel* active_channel;
         std::list<IOP_DMA_Channel*> queued_channels;
 
+        //Channels move up to MAX_BULK_WORDS at once, then stall the engine for as long as the words would have taken
+        constexpr static int MAX_BULK_WORDS = 32;
+        int stall_cycles;
+
         //Merge of DxCR, DxCR2, DxCR3 for easier processing
         DMA_DPCR DPCR;
         DMA_DICR DICR;
 
         void transfer_end(int index);
+        int bulk_words(uint32_t words_left);
         void process_CDVD();
         void process_SPU();
         void process_SPU2();
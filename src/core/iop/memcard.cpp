@@ -1,6 +1,392 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include "memcard.hpp"
 
-Memcard::Memcard()
+Memcard::Memcard() : quit(false), dirty_pages(0)
 {
+    reset();
+}
+
+Memcard::~Memcard()
+{
+    close();
+}
+
+bool Memcard::open(const std::string& path)
+{
+    close();
+
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file.is_open())
+    {
+        //New cards come erased, and the BIOS or the game offers to format them
+        std::ofstream new_card(path, std::ios::binary);
+        std::vector<uint8_t> erased(IMAGE_SIZE, 0xFF);
+        new_card.write((char*)erased.data(), erased.size());
+        if (!new_card)
+        {
+            printf("[Memcard] Failed to create %s\n", path.c_str());
+            return false;
+        }
+        new_card.close();
+        printf("[Memcard] Created %s\n", path.c_str());
+
+        file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!file.is_open())
+            return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    if ((size_t)file.tellg() != IMAGE_SIZE)
+    {
+        printf("[Memcard] %s is not an 8 MB memory card image\n", path.c_str());
+        file.close();
+        return false;
+    }
+
+    image.resize(IMAGE_SIZE);
+    file.seekg(0);
+    file.read((char*)image.data(), IMAGE_SIZE);
+    if ((size_t)file.gcount() != IMAGE_SIZE)
+    {
+        printf("[Memcard] Failed to read %s\n", path.c_str());
+        file.close();
+        image.clear();
+        return false;
+    }
+
+    dirty.assign(PAGE_COUNT, false);
+    dirty_pages = 0;
+    quit = false;
+    flush_thread = std::thread(&Memcard::flush_loop, this);
+    return true;
+}
+
+//Anything still dirty is written back before the image is closed
+void Memcard::close()
+{
+    if (flush_thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(flush_mutex);
+            quit = true;
+        }
+        notifier.notify_all();
+        flush_thread.join();
+    }
+
+    if (file.is_open())
+        file.close();
+    image.clear();
+    dirty.clear();
+    dirty_pages = 0;
+}
+
+bool Memcard::is_inserted() const
+{
+    return file.is_open();
+}
+
+void Memcard::reset()
+{
+    terminator = DEFAULT_TERMINATOR;
+    command = 0;
+    position = 0;
+    length = 0;
+    page = 0;
+    address = 0;
+    data_length = 0;
+    checksum = 0;
+}
+
+uint8_t Memcard::start_transfer(uint8_t value, int transfer_length)
+{
+    command = 0;
+    position = 1;
+    length = std::max(transfer_length, 2);
+    response.assign(length, 0xFF);
+    return 0xFF;
+}
+
+uint8_t Memcard::write_SIO(uint8_t value)
+{
+    int index = position++;
+    if (index == 1)
+        start_command(value);
+    else
+        command_data(index, value);
+
+    if (index < length)
+        return response[index];
+    return 0xFF;
+}
+
+//Replies are padded with 0xFF at the front, so their last byte lines up with the end of the transfer
+void Memcard::set_reply_end(const uint8_t* reply, int size)
+{
+    int skip = std::max(0, size - length);
+    memcpy(&response[length - size + skip], reply + skip, size - skip);
+}
+
+void Memcard::start_command(uint8_t value)
+{
+    command = value;
+    const uint8_t ack[] = {0x2B, terminator};
+    switch (value)
+    {
+        case 0x11: //Probe
+        case 0x12: //End of erase/write
+        case 0x81: //End of read/write
+        case 0xBF:
+        case 0xF3: //Reset authentication
+        case 0xF7:
+        case 0x27: //Set terminator
+            set_reply_end(ack, sizeof(ack));
+            break;
+        case 0x21: //Set erase page
+        case 0x22: //Set write page
+        case 0x23: //Set read page
+            page = 0;
+            checksum = 0;
+            set_reply_end(ack, sizeof(ack));
+            break;
+        case 0x26: //Get card specs
+        {
+            //Page size, pages per erase block and page count, followed by their XOR
+            uint8_t specs[] =
+            {
+                0x2B, PAGE_SIZE & 0xFF, PAGE_SIZE >> 8, PAGES_PER_BLOCK, 0,
+                PAGE_COUNT & 0xFF, (PAGE_COUNT >> 8) & 0xFF, (PAGE_COUNT >> 16) & 0xFF, PAGE_COUNT >> 24,
+                0, terminator
+            };
+            for (int i = 1; i < 9; i++)
+                specs[9] ^= specs[i];
+            set_reply_end(specs, sizeof(specs));
+        }
+            break;
+        case 0x28: //Get terminator
+        {
+            const uint8_t reply[] = {0x2B, terminator, DEFAULT_TERMINATOR};
+            set_reply_end(reply, sizeof(reply));
+        }
+            break;
+        case 0x42: //Write data
+        case 0x43: //Read data
+        case 0xF0: //Authentication
+            //The reply depends on the next byte
+            break;
+        case 0x82: //Erase block
+            erase_block();
+            set_reply_end(ack, sizeof(ack));
+            break;
+        default:
+            printf("[Memcard] Unrecognized command $%02X\n", value);
+            set_reply_end(ack, sizeof(ack));
+            break;
+    }
+}
+
+void Memcard::command_data(int index, uint8_t value)
+{
+    switch (command)
+    {
+        case 0x21:
+        case 0x22:
+        case 0x23:
+            if (index <= 5)
+            {
+                page |= (uint32_t)value << ((index - 2) * 8);
+                checksum ^= value;
+                address = (size_t)page * RAW_PAGE_SIZE;
+            }
+            else if (index == 6 && value != checksum)
+                printf("[Memcard] Page $%08X has a bad checksum\n", page);
+            break;
+        case 0x27:
+            if (index == 2)
+            {
+                terminator = value;
+                response[length - 1] = terminator;
+            }
+            break;
+        case 0x42:
+            if (index == 2)
+            {
+                data_length = value;
+                checksum = 0;
+                data_buffer.assign(data_length + 4, 0x00);
+                data_buffer[1] = 0x2B;
+                data_buffer[data_length + 3] = terminator;
+                set_reply_end(data_buffer.data(), data_length + 4);
+                data_buffer.clear();
+            }
+            else if (index < data_length + 3)
+            {
+                data_buffer.push_back(value);
+                checksum ^= value;
+                if (index < data_length + 2)
+                    break;
+
+                //Commit the whole write at once, which is all the flush thread has to wait for
+                size_t size = address < IMAGE_SIZE ? std::min(data_buffer.size(), IMAGE_SIZE - address) : 0;
+                if (size)
+                {
+                    std::lock_guard<std::mutex> lock(flush_mutex);
+                    memcpy(&image[address], data_buffer.data(), size);
+                    mark_dirty(address, size);
+                }
+                address += size;
+                response[length - 2] = checksum;
+            }
+            break;
+        case 0x43:
+            if (index == 2)
+            {
+                data_length = value;
+                read_data();
+            }
+            break;
+        case 0xF0:
+            if (index == 2)
+            {
+                switch (value)
+                {
+                    //These send eight bytes that must be XORed back
+                    case 0x01:
+                    case 0x02:
+                    case 0x04:
+                    case 0x0F:
+                    case 0x11:
+                    case 0x13:
+                    {
+                        uint8_t reply[12] = {0x00, 0x2B};
+                        reply[11] = terminator;
+                        set_reply_end(reply, sizeof(reply));
+                        data_length = 8;
+                        checksum = 0;
+                    }
+                        break;
+                    default:
+                    {
+                        const uint8_t ack[] = {0x2B, terminator};
+                        set_reply_end(ack, sizeof(ack));
+                        data_length = 0;
+                    }
+                        break;
+                }
+            }
+            else if (index < data_length + 3)
+            {
+                checksum ^= value;
+                if (index == data_length + 2)
+                    response[length - 2] = checksum;
+            }
+            break;
+    }
+}
+
+void Memcard::read_data()
+{
+    size_t size = address < IMAGE_SIZE ? std::min((size_t)data_length, IMAGE_SIZE - address) : 0;
+    data_buffer.assign(data_length + 4, 0xFF);
+    data_buffer[0] = 0x00;
+    data_buffer[1] = 0x2B;
+    memcpy(&data_buffer[2], image.data() + address, size);
+    address += size;
+
+    checksum = 0;
+    for (int i = 0; i < data_length; i++)
+        checksum ^= data_buffer[i + 2];
+    data_buffer[data_length + 2] = checksum;
+    data_buffer[data_length + 3] = terminator;
+    set_reply_end(data_buffer.data(), data_length + 4);
+}
+
+void Memcard::erase_block()
+{
+    size_t start = (size_t)page * RAW_PAGE_SIZE;
+    if (start >= IMAGE_SIZE)
+        return;
+
+    size_t size = std::min((size_t)RAW_PAGE_SIZE * PAGES_PER_BLOCK, IMAGE_SIZE - start);
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    memset(&image[start], 0xFF, size);
+    mark_dirty(start, size);
+}
+
+//Must be called with flush_mutex held
+void Memcard::mark_dirty(size_t start, size_t size)
+{
+    for (size_t i = start / RAW_PAGE_SIZE; i <= (start + size - 1) / RAW_PAGE_SIZE; i++)
+    {
+        if (!dirty[i])
+        {
+            dirty[i] = true;
+            dirty_pages++;
+        }
+    }
+    last_write = std::chrono::steady_clock::now();
+    notifier.notify_all();
+}
+
+void Memcard::flush_loop()
+{
+    std::unique_lock<std::mutex> lock(flush_mutex);
+    while (true)
+    {
+        notifier.wait(lock, [this] { return quit || dirty_pages; });
+
+        //A save writes many pages in a burst, so wait for it to finish and write it back in one go
+        while (!quit)
+        {
+            std::chrono::steady_clock::time_point deadline = last_write + std::chrono::milliseconds(FLUSH_DELAY_MS);
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+            notifier.wait_until(lock, deadline);
+        }
+
+        if (dirty_pages)
+            write_back(lock);
+        else if (quit)
+            return;
+    }
+}
+
+//Copies out runs of dirty pages, then writes them without holding the lock so the card stays writable
+void Memcard::write_back(std::unique_lock<std::mutex>& lock)
+{
+    std::vector<std::pair<int, int>> runs;
+    std::vector<uint8_t> staging;
+    for (int i = 0; i < PAGE_COUNT; i++)
+    {
+        if (!dirty[i])
+            continue;
+
+        int first = i;
+        while (i < PAGE_COUNT && dirty[i])
+            dirty[i++] = false;
+        runs.push_back({first, i - first});
+        staging.insert(staging.end(), image.begin() + (size_t)first * RAW_PAGE_SIZE,
+                       image.begin() + (size_t)i * RAW_PAGE_SIZE);
+    }
+    dirty_pages = 0;
+    lock.unlock();
+
+    size_t offset = 0;
+    for (auto& run : runs)
+    {
+        size_t size = (size_t)run.second * RAW_PAGE_SIZE;
+        file.seekp((size_t)run.first * RAW_PAGE_SIZE);
+        file.write((char*)&staging[offset], size);
+        offset += size;
+    }
+    file.flush();
+    if (!file)
+    {
+        printf("[Memcard] Failed to write back the memory card\n");
+        file.clear();
+    }
 
+    lock.lock();
 }
@@ -1,11 +1,87 @@
 #ifndef MEMCARD_HPP
 #define MEMCARD_HPP
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
+/**
+  * 8 MB PS2 memory card.
+  * The image is a raw dump of the card's flash: 16384 pages of 512 bytes, each followed by 16 spare bytes holding the
+  * ECC that the IOP's card driver computes. The whole image is kept in RAM, so transfers never wait on the host.
+  * Written pages are marked dirty and a worker thread writes them back once a save has gone quiet for a moment,
+  * merging neighbouring pages into single writes.
+  */
 class Memcard
 {
+    private:
+        constexpr static int PAGE_SIZE = 512;
+        constexpr static int ECC_SIZE = 16;
+        constexpr static int RAW_PAGE_SIZE = PAGE_SIZE + ECC_SIZE;
+        constexpr static int PAGES_PER_BLOCK = 16;
+        constexpr static int PAGE_COUNT = 0x4000;
+        constexpr static size_t IMAGE_SIZE = (size_t)RAW_PAGE_SIZE * PAGE_COUNT;
+
+        constexpr static uint8_t DEFAULT_TERMINATOR = 0x55;
+
+        //How long the card must go without writes before dirty pages are written back
+        constexpr static int FLUSH_DELAY_MS = 500;
+
+        //Only the thread running the IOP modifies the image, and only while holding flush_mutex
+        std::vector<uint8_t> image;
+        std::fstream file;
+
+        std::thread flush_thread;
+        std::mutex flush_mutex;
+        std::condition_variable notifier;
+        bool quit;
+        std::vector<bool> dirty;
+        int dirty_pages;
+        std::chrono::steady_clock::time_point last_write;
+
+        //Transfer state. Replies end with a fixed sequence, so they are laid out in full when a command starts.
+        uint8_t terminator;
+        uint8_t command;
+        int position;
+        int length;
+        std::vector<uint8_t> response;
+
+        uint32_t page;
+        size_t address;
+        int data_length;
+        uint8_t checksum;
+        std::vector<uint8_t> data_buffer;
+
+        void set_reply_end(const uint8_t* reply, int size);
+        void start_command(uint8_t value);
+        void command_data(int index, uint8_t value);
+        void read_data();
+        void erase_block();
+
+        void mark_dirty(size_t start, size_t size);
+        void flush_loop();
+        void write_back(std::unique_lock<std::mutex>& lock);
+        void close();
     public:
         Memcard();
+        ~Memcard();
+
+        //Creates an erased card if the image doesn't exist yet
+        bool open(const std::string& path);
+        bool is_inserted() const;
+
+        void reset();
+
+        uint8_t start_transfer(uint8_t value, int transfer_length);
+        uint8_t write_SIO(uint8_t value);
+
+        //Only the transfer state; the card contents live in the image file
+        void load_state(std::ifstream& state);
+        void save_state(std::ofstream& state);
 };
 
 #endif // MEMCARD_HPP
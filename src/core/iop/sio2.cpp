@@ -71,6 +71,7 @@ void SIO2::write_serial(uint8_t value)
         {
             printf("[SIO2] Get new send3 port: $%08X\n", send3[send3_port]);
             command_length = (send3[send3_port] >> 8) & 0x1FF;
+            transfer_length = command_length;
             printf("[SIO2] Command len: %d\n", command_length);
 
             port = send3[send3_port] & 0x1;
@@ -96,6 +97,9 @@ void SIO2::write_device(uint8_t value)
                 case 0x01:
                     active_command = SIO_DEVICE::PAD;
                     break;
+                case 0x81:
+                    active_command = SIO_DEVICE::MEMCARD;
+                    break;
                 default:
                     active_command = SIO_DEVICE::DUMMY;
                     break;
@@ -123,6 +127,27 @@ void SIO2::write_device(uint8_t value)
             FIFO.push(reply);
         }
             break;
+        case SIO_DEVICE::MEMCARD:
+        {
+            //Only the first slot has a card
+            if (port || !memcard->is_inserted())
+            {
+                FIFO.push(0x00);
+                RECV1 = 0x1D100;
+                return;
+            }
+            RECV1 = 0x1100;
+            uint8_t reply;
+            if (new_command)
+            {
+                new_command = false;
+                reply = memcard->start_transfer(value, transfer_length);
+            }
+            else
+                reply = memcard->write_SIO(value);
+            FIFO.push(reply);
+        }
+            break;
         case SIO_DEVICE::DUMMY:
             FIFO.push(0x00);
             RECV1 = 0x1D100;
@@ -38,6 +38,7 @@ class SIO2
         bool new_command;
         SIO_DEVICE active_command;
         int command_length;
+        int transfer_length;
         int send3_port;
 
         void write_device(uint8_t value);
@@ -58,6 +59,9 @@ class SIO2
 
         void set_control(uint32_t value);
         void write_serial(uint8_t value);
+
+        void load_state(std::ifstream& state);
+        void save_state(std::ofstream& state);
 };
 
 #endif // SIO2_HPP
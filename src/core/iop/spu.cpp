@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
+#include <emmintrin.h>
 #include "spu.hpp"
 #include "../emulator.hpp"
 #include "iop_dma.hpp"
@@ -35,10 +38,17 @@ void SPU::reset(uint8_t* RAM)
 
     clear_dma_req();
 
+    voice_mixdry_left = 0;
+    voice_mixdry_right = 0;
+    voice_mixwet_left = 0;
+    voice_mixwet_right = 0;
+
     for (int i = 0; i < 24; i++)
     {
         voices[i].reset();
+        voice_out[i] = 0;
     }
+    update_mix_volumes();
 
     IRQA[id-1] = 0x800;
 
@@ -54,6 +64,15 @@ void SPU::spu_check_irq(uint32_t address)
     }
 }
 
+void SPU::spu_check_irq_range(uint32_t address, int count)
+{
+    for (int j = 0; j < 2; j++)
+    {
+        if (((IRQA[j] - address) & 0x000FFFFF) < (uint32_t)count && (core_att[j] & (1 << 6)))
+            spu_irq(j);
+    }
+}
+
 void SPU::spu_irq(int index)
 {
     if (spdif_irq & (4 << index))
@@ -68,39 +87,47 @@ void SPU::gen_sample()
 {
     for (int i = 0; i < 24; i++)
     {
-        voices[i].counter += voices[i].pitch;
-        while (voices[i].counter >= 0x1000)
+        Voice& voice = voices[i];
+        voice.counter += voice.pitch;
+        while (voice.counter >= 0x1000)
         {
-            voices[i].counter -= 0x1000;
+            voice.counter -= 0x1000;
 
-            //Read header
-            if (voices[i].block_pos == 0)
+            //Read header and decode the whole block
+            if (voice.block_pos == 0)
             {
-                voices[i].current_addr &= 0x000FFFFF;
-                uint16_t header = RAM[voices[i].current_addr];
-                voices[i].loop_code = (header >> 8) & 0x3;
+                voice.current_addr &= 0x000FFFFF;
+                uint16_t header = RAM[voice.current_addr];
+                voice.loop_code = (header >> 8) & 0x3;
                 bool loop_start = header & (1 << 10);
 
-                if (loop_start && !voices[i].loop_addr_specified)
-                    voices[i].loop_addr = voices[i].current_addr;
+                if (loop_start && !voice.loop_addr_specified)
+                    voice.loop_addr = voice.current_addr;
 
-                voices[i].block_pos = 3;
+                decode_adpcm_block(voice);
+
+                spu_check_irq(voice.current_addr);
+                voice.current_addr++;
+                voice.current_addr &= 0x000FFFFF;
+                voice.block_pos = 4;
             }
 
-            voices[i].block_pos++;
+            voice.prev_sample = voice.cur_sample;
+            voice.cur_sample = voice.decoded[voice.block_pos - 4];
+            voice.block_pos++;
 
-            if ((voices[i].block_pos % 4) == 0)
+            if ((voice.block_pos % 4) == 0)
             {
-                spu_check_irq(voices[i].current_addr);
-                voices[i].current_addr++;
-                voices[i].current_addr &= 0x000FFFFF;
+                spu_check_irq(voice.current_addr);
+                voice.current_addr++;
+                voice.current_addr &= 0x000FFFFF;
             }
 
             //End of block
-            if (voices[i].block_pos == 32)
+            if (voice.block_pos == 32)
             {
-                voices[i].block_pos = 0;
-                switch (voices[i].loop_code)
+                voice.block_pos = 0;
+                switch (voice.loop_code)
                 {
                     //Continue to next block
                     case 0:
@@ -109,15 +136,23 @@ void SPU::gen_sample()
                     //No loop specified, set ENDX and mute channel
                     case 1:
                         ENDX |= 1 << i;
+                        voice.adsr_phase = ADSR_STOPPED;
+                        voice.current_envelope = 0;
                         break;
                     //Jump to loop addr and set ENDX
                     case 3:
-                        voices[i].current_addr = voices[i].loop_addr;
+                        voice.current_addr = voice.loop_addr;
                         ENDX |= 1 << i;
                         break;
                 }
             }
         }
+
+        //Linear interpolation between the last two decoded samples
+        int32_t sample = voice.prev_sample + (((voice.cur_sample - voice.prev_sample) * (int32_t)voice.counter) >> 12);
+
+        tick_adsr(voice);
+        voice_out[i] = (sample * (int16_t)voice.current_envelope) >> 15;
     }
 
     if (ADMA_left > 0 && autodma_ctrl & (1 << (id - 1)))
@@ -136,6 +171,274 @@ void SPU::gen_sample()
     }
 }
 
+/**
+ * Returns how many samples can be generated in one go before this core could raise an IRQA interrupt or change
+ * its ADMA request, so that the emulator can end a sample block exactly on that sample.
+ */
+int SPU::samples_until_event(int max_samples)
+{
+    int samples = max_samples;
+
+    //ADMA consumes input one sample at a time and only changes state at the half buffer boundaries
+    if (ADMA_left > 0 && running_ADMA())
+    {
+        for (int i = 1; i < samples; i++)
+        {
+            int pos = (input_pos + i) & 0x1FF;
+            if (pos == 128 || pos == 129 || pos == 384)
+            {
+                samples = i;
+                break;
+            }
+        }
+    }
+
+    for (int j = 0; j < 2; j++)
+    {
+        if (!(core_att[j] & (1 << 6)) || (spdif_irq & (4 << j)))
+            continue;
+
+        for (int i = 0; i < 24 && samples > 1; i++)
+        {
+            if (voices[i].pitch)
+                samples = std::min(samples, voice_samples_until_addr(voices[i], IRQA[j], samples));
+        }
+    }
+
+    return samples;
+}
+
+//Walks a voice's ADPCM blocks without side effects to find the sample on which it will check addr
+int SPU::voice_samples_until_addr(Voice& voice, uint32_t addr, int max_samples)
+{
+    int64_t max_steps = ((int64_t)max_samples * voice.pitch + voice.counter) >> 12;
+    int64_t steps = 0;
+
+    uint32_t current_addr = voice.current_addr;
+    uint32_t loop_addr = voice.loop_addr;
+    int block_pos = voice.block_pos;
+    int loop_code = voice.loop_code;
+
+    while (true)
+    {
+        //The header is checked on the step that plays the block's first sample,
+        //and each data halfword when block_pos reaches a multiple of 4
+        int step_count;
+        if (block_pos == 0)
+        {
+            current_addr &= 0x000FFFFF;
+            uint16_t header = RAM[current_addr];
+            loop_code = (header >> 8) & 0x3;
+            if ((header & (1 << 10)) && !voice.loop_addr_specified)
+                loop_addr = current_addr;
+            step_count = 1;
+            block_pos = 5;
+        }
+        else
+        {
+            step_count = 4 - (block_pos % 4);
+            block_pos += step_count;
+        }
+
+        steps += step_count;
+        if (steps > max_steps)
+            return max_samples;
+
+        if (current_addr == addr)
+            break;
+
+        current_addr = (current_addr + 1) & 0x000FFFFF;
+        if (block_pos == 32)
+        {
+            block_pos = 0;
+            if (loop_code == 3)
+                current_addr = loop_addr;
+        }
+    }
+
+    int64_t samples = ((steps << 12) - voice.counter + voice.pitch - 1) / voice.pitch;
+    return std::max((int64_t)1, std::min((int64_t)max_samples, samples));
+}
+
+/**
+ * Mixes the last sample of all 48 voices of both cores.
+ * Reverb isn't emulated, so voices routed to the wet path are mixed in dry.
+ */
+stereo_sample SPU::mix(const SPU& core0, const SPU& core1)
+{
+    __m128i left = _mm_setzero_si128();
+    __m128i right = _mm_setzero_si128();
+
+    const SPU* cores[2] = {&core0, &core1};
+    for (int c = 0; c < 2; c++)
+    {
+        for (int i = 0; i < 24; i += 8)
+        {
+            __m128i out = _mm_load_si128((const __m128i*)&cores[c]->voice_out[i]);
+            __m128i vol_left = _mm_load_si128((const __m128i*)&cores[c]->mix_vol_left[i]);
+            __m128i vol_right = _mm_load_si128((const __m128i*)&cores[c]->mix_vol_right[i]);
+
+            //Each lane holds the sum of two voices, scaled down before accumulating so 48 voices can't overflow
+            left = _mm_add_epi32(left, _mm_srai_epi32(_mm_madd_epi16(out, vol_left), 15));
+            right = _mm_add_epi32(right, _mm_srai_epi32(_mm_madd_epi16(out, vol_right), 15));
+        }
+    }
+
+    //Horizontal sum of both channels at once, then saturate to 16 bits
+    __m128i sums = _mm_add_epi32(_mm_unpacklo_epi32(left, right), _mm_unpackhi_epi32(left, right));
+    sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 8));
+    sums = _mm_packs_epi32(sums, sums);
+
+    uint32_t packed = _mm_cvtsi128_si32(sums);
+    stereo_sample sample;
+    sample.left = packed & 0xFFFF;
+    sample.right = packed >> 16;
+    return sample;
+}
+
+void SPU::decode_adpcm_block(Voice& voice)
+{
+    const static int pos_table[5] = {0, 60, 115, 98, 122};
+    const static int neg_table[5] = {0, 0, -52, -55, -60};
+
+    uint16_t header = RAM[voice.current_addr];
+    int shift = header & 0xF;
+    int filter = (header >> 4) & 0x7;
+    if (shift > 12)
+        shift = 9;
+    if (filter > 4)
+        filter = 4;
+
+    alignas(16) uint16_t data[8];
+    for (int i = 0; i < 7; i++)
+        data[i] = RAM[(voice.current_addr + 1 + i) & 0x000FFFFF];
+    data[7] = 0;
+
+    //Sign-extend all 28 nibbles by moving each into the top of a 16-bit lane, then apply the shift in one go.
+    //nibbles[j][k] holds sample 4k + j.
+    alignas(16) int16_t nibbles[4][8];
+    __m128i raw = _mm_load_si128((__m128i*)data);
+    __m128i mask = _mm_set1_epi16((int16_t)0xF000);
+    __m128i count = _mm_cvtsi32_si128(shift);
+    _mm_store_si128((__m128i*)nibbles[0], _mm_sra_epi16(_mm_and_si128(_mm_slli_epi16(raw, 12), mask), count));
+    _mm_store_si128((__m128i*)nibbles[1], _mm_sra_epi16(_mm_and_si128(_mm_slli_epi16(raw, 8), mask), count));
+    _mm_store_si128((__m128i*)nibbles[2], _mm_sra_epi16(_mm_and_si128(_mm_slli_epi16(raw, 4), mask), count));
+    _mm_store_si128((__m128i*)nibbles[3], _mm_sra_epi16(_mm_and_si128(raw, mask), count));
+
+    //The prediction filter depends on the previous two outputs, so it has to stay scalar
+    int32_t old1 = voice.adpcm_old1;
+    int32_t old2 = voice.adpcm_old2;
+    for (int i = 0; i < 28; i++)
+    {
+        int32_t sample = nibbles[i & 0x3][i >> 2];
+        sample += (old1 * pos_table[filter] + old2 * neg_table[filter] + 32) >> 6;
+        sample = std::max(-0x8000, std::min(0x7FFF, sample));
+        voice.decoded[i] = sample;
+        old2 = old1;
+        old1 = sample;
+    }
+    voice.adpcm_old1 = old1;
+    voice.adpcm_old2 = old2;
+}
+
+void SPU::tick_adsr(Voice& voice)
+{
+    bool exponential, decrease;
+    int shift, step;
+    switch (voice.adsr_phase)
+    {
+        case ADSR_ATTACK:
+            exponential = voice.adsr1 & (1 << 15);
+            decrease = false;
+            shift = (voice.adsr1 >> 10) & 0x1F;
+            step = 7 - ((voice.adsr1 >> 8) & 0x3);
+            break;
+        case ADSR_DECAY:
+            exponential = true;
+            decrease = true;
+            shift = ((voice.adsr1 >> 4) & 0xF) << 2;
+            step = -8;
+            break;
+        case ADSR_SUSTAIN:
+            exponential = voice.adsr2 & (1 << 15);
+            decrease = voice.adsr2 & (1 << 14);
+            shift = (voice.adsr2 >> 8) & 0x1F;
+            if (decrease)
+                step = -8 + ((voice.adsr2 >> 6) & 0x3);
+            else
+                step = 7 - ((voice.adsr2 >> 6) & 0x3);
+            break;
+        case ADSR_RELEASE:
+            exponential = voice.adsr2 & (1 << 5);
+            decrease = true;
+            shift = (voice.adsr2 & 0x1F) << 2;
+            step = -8;
+            break;
+        default:
+            return;
+    }
+
+    if (voice.adsr_cycles > 1)
+    {
+        voice.adsr_cycles--;
+        return;
+    }
+
+    int32_t level = voice.current_envelope;
+    int cycles = 1 << std::max(0, shift - 11);
+    int32_t delta = step << std::max(0, 11 - shift);
+    if (exponential && !decrease && level > 0x6000)
+        cycles *= 4;
+    if (exponential && decrease)
+        delta = (delta * level) >> 15;
+
+    level = std::max(0, std::min(0x7FFF, level + delta));
+    voice.current_envelope = level;
+    voice.adsr_cycles = cycles;
+
+    switch (voice.adsr_phase)
+    {
+        case ADSR_ATTACK:
+            if (level == 0x7FFF)
+            {
+                voice.adsr_phase = ADSR_DECAY;
+                voice.adsr_cycles = 0;
+            }
+            break;
+        case ADSR_DECAY:
+            if (level <= ((voice.adsr1 & 0xF) + 1) * 0x800)
+            {
+                voice.adsr_phase = ADSR_SUSTAIN;
+                voice.adsr_cycles = 0;
+            }
+            break;
+        case ADSR_RELEASE:
+            if (level == 0)
+                voice.adsr_phase = ADSR_STOPPED;
+            break;
+        default:
+            break;
+    }
+}
+
+void SPU::update_mix_volumes()
+{
+    uint32_t mix_left = voice_mixdry_left | voice_mixwet_left;
+    uint32_t mix_right = voice_mixdry_right | voice_mixwet_right;
+    for (int i = 0; i < 24; i++)
+    {
+        mix_vol_left[i] = (mix_left & (1 << i)) ? voices[i].volume_left : 0;
+        mix_vol_right[i] = (mix_right & (1 << i)) ? voices[i].volume_right : 0;
+    }
+}
+
+//Fixed volumes are 15-bit signed halves. Sweeps aren't emulated, so they keep the last fixed volume.
+static void set_voice_volume(int16_t& volume, uint16_t value)
+{
+    if (!(value & 0x8000))
+        volume = std::max(-0x7FFF, (int)(int16_t)(value << 1));
+}
+
 void SPU::finish_DMA()
 {
     status.DMA_finished = true;
@@ -156,50 +459,60 @@ void SPU::pause_DMA()
     status.DMA_busy = false;
 }
 
-uint32_t SPU::read_DMA()
+void SPU::read_DMA(uint32_t* data, int words)
 {
-    uint32_t value = RAM[current_addr];
-    spu_check_irq(current_addr);
-    current_addr++;
-    current_addr &= 0x000FFFFF;
-
-    value |= ((uint32_t)RAM[current_addr]) << 16;
-    spu_check_irq(current_addr);
-    current_addr ++;
-    current_addr &= 0x000FFFFF;
+    uint16_t* dest = (uint16_t*)data;
+    int count = words * 2;
+    spu_check_irq_range(current_addr, count);
+    while (count)
+    {
+        int run = std::min(count, (int)(0x00100000 - current_addr));
+        memcpy(dest, &RAM[current_addr], run * sizeof(uint16_t));
+        dest += run;
+        count -= run;
+        current_addr = (current_addr + run) & 0x000FFFFF;
+    }
 
     status.DMA_busy = true;
     status.DMA_finished = false;
-    return value;
 }
 
-void SPU::write_DMA(uint32_t value)
+void SPU::write_DMA(const uint32_t* data, int words)
 {
-    //printf("[SPU%d] Write mem $%08X ($%08X)\n", id, value, current_addr);
-    RAM[current_addr] = value & 0xFFFF;
-    spu_check_irq(current_addr);
-    current_addr++;
-    current_addr &= 0x000FFFFF;
-
-    RAM[current_addr + 1] = value >> 16;
-    spu_check_irq(current_addr);
-    current_addr++;
-    current_addr &= 0x000FFFFF;
+    //printf("[SPU%d] Write mem $%08X ($%08X)\n", id, words, current_addr);
+    const uint16_t* source = (const uint16_t*)data;
+    int count = words * 2;
+    spu_check_irq_range(current_addr, count);
+    while (count)
+    {
+        int run = std::min(count, (int)(0x00100000 - current_addr));
+        memcpy(&RAM[current_addr], source, run * sizeof(uint16_t));
+        source += run;
+        count -= run;
+        current_addr = (current_addr + run) & 0x000FFFFF;
+    }
 
     status.DMA_busy = true;
     status.DMA_finished = false;
 }
 
-void SPU::write_ADMA(uint8_t *RAM)
+//Returns how many words were taken, which stops short once the input buffer is full
+int SPU::write_ADMA(int words)
 {
    // printf("[SPU%d] ADMA transfer: $%08X\n", id, ADMA_left);
-    ADMA_left += 2;
+    int accepted = 0;
+    do
+    {
+        ADMA_left += 2;
+        accepted++;
+    } while (accepted < words && ADMA_left < 0x400);
 
     if (ADMA_left >= 0x400)
         clear_dma_req();
 
     status.DMA_busy = true;
     status.DMA_finished = false;
+    return accepted;
 }
 
 void SPU::process_ADMA() 
@@ -447,41 +760,49 @@ void SPU::write16(uint32_t addr, uint16_t value)
             printf("[SPU%d] Write VMIXLH: $%04X\n", id, value);
             voice_mixdry_left &= 0xFFFF;
             voice_mixdry_left |= value << 16;
+            update_mix_volumes();
             break;
         case 0x18A:
             printf("[SPU%d] Write VMIXLL: $%04X\n", id, value);
             voice_mixdry_left &= ~0xFFFF;
             voice_mixdry_left |= value;
+            update_mix_volumes();
             break;
         case 0x18C:
             printf("[SPU%d] Write VMIXELH: $%04X\n", id, value);
             voice_mixwet_left &= 0xFFFF;
             voice_mixwet_left |= value << 16;
+            update_mix_volumes();
             break;
         case 0x18E:
             printf("[SPU%d] Write VMIXELL: $%04X\n", id, value);
             voice_mixwet_left &= ~0xFFFF;
             voice_mixwet_left |= value;
+            update_mix_volumes();
             break;
         case 0x190:
             printf("[SPU%d] Write VMIXRH: $%04X\n", id, value);
             voice_mixdry_right &= 0xFFFF;
             voice_mixdry_right |= value << 16;
+            update_mix_volumes();
             break;
         case 0x192:
             printf("[SPU%d] Write VMIXRL: $%04X\n", id, value);
             voice_mixdry_right &= ~0xFFFF;
             voice_mixdry_right |= value;
+            update_mix_volumes();
             break;
         case 0x194:
             printf("[SPU%d] Write VMIXERH: $%04X\n", id, value);
             voice_mixwet_right &= 0xFFFF;
             voice_mixwet_right |= value << 16;
+            update_mix_volumes();
             break;
         case 0x196:
             printf("[SPU%d] Write VMIXERL: $%04X\n", id, value);
             voice_mixwet_right &= ~0xFFFF;
             voice_mixwet_right |= value;
+            update_mix_volumes();
             break;
         case 0x19A:
             printf("[SPU%d] Write Core Att: $%04X\n", id, value);
@@ -596,9 +917,15 @@ void SPU::write_voice_reg(uint32_t addr, uint16_t value)
     {
         case 0:
             //printf("[SPU%d] Write V%d VOLL: $%04X\n", id, v, value);
+            voices[v].left_vol = value;
+            set_voice_volume(voices[v].volume_left, value);
+            update_mix_volumes();
             break;
         case 2:
             //printf("[SPU%d] Write V%d VOLR: $%04X\n", id, v, value);
+            voices[v].right_vol = value;
+            set_voice_volume(voices[v].volume_right, value);
+            update_mix_volumes();
             break;
         case 4:
             printf("[SPU%d] Write V%d PITCH: $%04X\n", id, v, value);
@@ -630,11 +957,24 @@ void SPU::key_on_voice(int v)
     voices[v].block_pos = 0;
     voices[v].loop_addr_specified = false;
     ENDX &= ~(1 << v);
+
+    voices[v].adsr_phase = ADSR_ATTACK;
+    voices[v].adsr_cycles = 0;
+    voices[v].current_envelope = 0;
+    voices[v].adpcm_old1 = 0;
+    voices[v].adpcm_old2 = 0;
+    voices[v].prev_sample = 0;
+    voices[v].cur_sample = 0;
 }
 
 void SPU::key_off_voice(int v)
 {
     //Set envelope to Release mode
+    if (voices[v].adsr_phase != ADSR_STOPPED)
+    {
+        voices[v].adsr_phase = ADSR_RELEASE;
+        voices[v].adsr_cycles = 0;
+    }
 }
 
 void SPU::clear_dma_req()
@@ -3,9 +3,19 @@
 #include <cstdint>
 #include <fstream>
 
+enum ADSR_PHASE
+{
+    ADSR_ATTACK,
+    ADSR_DECAY,
+    ADSR_SUSTAIN,
+    ADSR_RELEASE,
+    ADSR_STOPPED
+};
+
 struct Voice
 {
     uint16_t left_vol, right_vol;
+    int16_t volume_left, volume_right;
     uint16_t pitch;
     uint16_t adsr1, adsr2;
     uint16_t current_envelope;
@@ -19,10 +29,22 @@ struct Voice
     int block_pos;
     int loop_code;
 
+    //The current ADPCM block is decoded in one go when its header is read
+    int16_t decoded[28];
+    int16_t adpcm_old1, adpcm_old2;
+
+    //Last two decoded samples, interpolated between using the pitch counter
+    int16_t prev_sample, cur_sample;
+
+    ADSR_PHASE adsr_phase;
+    int adsr_cycles;
+
     void reset()
     {
         left_vol = 0;
         right_vol = 0;
+        volume_left = 0;
+        volume_right = 0;
         pitch = 0;
         adsr1 = 0;
         adsr2 = 0;
@@ -34,9 +56,22 @@ struct Voice
         counter = 0;
         block_pos = 0;
         loop_code = 0;
+        for (int i = 0; i < 28; i++)
+            decoded[i] = 0;
+        adpcm_old1 = 0;
+        adpcm_old2 = 0;
+        prev_sample = 0;
+        cur_sample = 0;
+        adsr_phase = ADSR_STOPPED;
+        adsr_cycles = 0;
     }
 };
 
+struct stereo_sample
+{
+    int16_t left, right;
+};
+
 struct SPU_STAT
 {
     bool DMA_finished;
@@ -68,6 +103,11 @@ class SPU
         uint32_t voice_mixdry_right;
         uint32_t voice_mixwet_left;
         uint32_t voice_mixwet_right;
+
+        //Per-voice output of the last sample and the volumes it is mixed with, zeroed for voices outside the mix
+        alignas(16) int16_t voice_out[24];
+        alignas(16) int16_t mix_vol_left[24];
+        alignas(16) int16_t mix_vol_right[24];
         //ADMA bullshit
         uint16_t autodma_ctrl;
         int ADMA_left;
@@ -81,8 +121,14 @@ class SPU
         void key_on_voice(int v);
         void key_off_voice(int v);
 
+        void decode_adpcm_block(Voice& voice);
+        void tick_adsr(Voice& voice);
+        void update_mix_volumes();
+
         void spu_check_irq(uint32_t address);
+        void spu_check_irq_range(uint32_t address, int count);
         void spu_irq(int index);
+        int voice_samples_until_addr(Voice& voice, uint32_t addr, int max_samples);
 
         uint16_t read_voice_reg(uint32_t addr);
         void write_voice_reg(uint32_t addr, uint16_t value);
@@ -98,6 +144,8 @@ class SPU
 
         void reset(uint8_t* RAM);
         void gen_sample();
+        int samples_until_event(int max_samples);
+        static stereo_sample mix(const SPU& core0, const SPU& core1);
 
         void start_DMA(int size);
         void pause_DMA();
@@ -105,9 +153,9 @@ class SPU
 
         uint16_t read_mem();
         void process_ADMA();
-        uint32_t read_DMA();
-        void write_DMA(uint32_t value);
-        void write_ADMA(uint8_t* RAM);
+        void read_DMA(uint32_t* data, int words);
+        void write_DMA(const uint32_t* data, int words);
+        int write_ADMA(int words);
         void write_mem(uint16_t value);
 
         uint16_t read16(uint32_t addr);
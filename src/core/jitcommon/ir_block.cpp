@@ -5,7 +5,9 @@ namespace IR
 
 Block::Block()
 {
+    next_instr = 0;
     cycle_count = 0;
+    guest_instruction_count = 0;
 }
 
 void Block::add_instr(Instruction &instr)
@@ -15,7 +17,7 @@ void Block::add_instr(Instruction &instr)
 
 unsigned int Block::get_instruction_count() const
 {
-    return instructions.size();
+    return instructions.size() - next_instr;
 }
 
 int Block::get_cycle_count() const
@@ -23,18 +25,31 @@ int Block::get_cycle_count() const
     return cycle_count;
 }
 
+unsigned int Block::get_guest_instruction_count() const
+{
+    return guest_instruction_count;
+}
+
 Instruction Block::get_next_instr()
 {
-    if (!instructions.size())
+    if (next_instr >= instructions.size())
     {
         Instruction instr;
         instr.op = IR::Opcode::Null;
         return instr;
     }
 
-    Instruction instr = instructions.front();
-    instructions.pop_front();
-    return instr;
+    return instructions[next_instr++];
+}
+
+std::vector<Instruction>& Block::get_instrs()
+{
+    return instructions;
+}
+
+const std::vector<Instruction>& Block::get_instrs() const
+{
+    return instructions;
 }
 
 void Block::set_cycle_count(int cycles)
@@ -42,4 +57,9 @@ void Block::set_cycle_count(int cycles)
     cycle_count = cycles;
 }
 
+void Block::set_guest_instruction_count(unsigned int count)
+{
+    guest_instruction_count = count;
+}
+
 };
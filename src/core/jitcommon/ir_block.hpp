@@ -1,6 +1,6 @@
 #ifndef IR_BLOCK_HPP
 #define IR_BLOCK_HPP
-#include <list>
+#include <vector>
 #include "ir_instr.hpp"
 
 namespace IR
@@ -9,8 +9,10 @@ namespace IR
 class Block
 {
     private:
-        std::list<Instruction> instructions;
+        std::vector<Instruction> instructions;
+        unsigned int next_instr;
         int cycle_count;
+        unsigned int guest_instruction_count;
     public:
         Block();
 
@@ -18,9 +20,15 @@ class Block
 
         unsigned int get_instruction_count() const;
         int get_cycle_count() const;
+        unsigned int get_guest_instruction_count() const;
         Instruction get_next_instr();
 
+        //Direct access for optimization passes, which run before any instruction is consumed
+        std::vector<Instruction>& get_instrs();
+        const std::vector<Instruction>& get_instrs() const;
+
         void set_cycle_count(int cycles);
+        void set_guest_instruction_count(unsigned int count);
 };
 
 };
@@ -5,10 +5,13 @@
 #include <sys/mman.h>
 #endif
 
+#include <algorithm>
 #include <limits>
 #include <cstring>
+#include <vector>
 
 #include "../errors.hpp"
+#include "../profiler.hpp"
 #include "jitcache.hpp"
 
 //////////////
@@ -527,6 +530,9 @@ void EEJitHeap::invalidate_ee_page(uint32_t page)
             for(uint32_t idx = 0; idx < 1024; idx++) {
                 if(kv->second.block_array[idx].literals_start) {
                     jit_free(kv->second.block_array[idx].literals_start);
+                    if(block_stats_enabled) {
+                        get_block_stats(kv->second.block_array[idx].block_data.pc)->invalidations++;
+                    }
                 }
             }
         }
@@ -536,6 +542,8 @@ void EEJitHeap::invalidate_ee_page(uint32_t page)
         ee_page_record_map.erase(page);
     }
 
+    page_generations[page]++;
+
     // invalidate cache if needed
     if(page == ee_page_lookup_idx) {
         ee_page_lookup_cache = nullptr;
@@ -571,6 +579,7 @@ EEJitBlockRecord* EEJitHeap::find_block(uint32_t PC)
  */
 void EEJitHeap::flush_all_blocks()
 {
+    Profiler::add_jit_flush(Profiler::JIT_EE);
     for(auto& page : ee_page_record_map)
     {
         for(uint32_t idx = 0; idx < 1024; idx++)
@@ -583,6 +592,7 @@ void EEJitHeap::flush_all_blocks()
     }
     memset(lookup_cache, 0, sizeof(lookup_cache));
     ee_page_record_map.clear();
+    flush_generation++;
     ee_page_lookup_cache = nullptr;
     ee_page_lookup_idx = -1;
 }
@@ -592,11 +602,19 @@ void EEJitHeap::flush_all_blocks()
  */
 EEJitBlockRecord* EEJitHeap::insert_block(uint32_t PC, JitBlock *block)
 {
-    // compute block size
     uint8_t *code_start = block->get_code_start();
-    uint8_t *code_end = block->get_code_pos();
     uint8_t *literals_start = block->get_literals_start();
-    std::size_t block_size = code_end - literals_start;
+    return insert_code(PC, literals_start, code_start - literals_start, block->get_code_pos() - code_start);
+}
+
+/*!
+ * Add a block which was built elsewhere, laid out as literals followed by code
+ */
+EEJitBlockRecord* EEJitHeap::insert_code(uint32_t PC, const uint8_t* literals_start, std::size_t literal_size,
+                                         std::size_t code_size)
+{
+    // compute block size
+    std::size_t block_size = literal_size + code_size;
     if(block_size <= 0) Errors::die("block size invalid");
 
     // allocate space on JIT heap
@@ -615,12 +633,10 @@ EEJitBlockRecord* EEJitHeap::insert_block(uint32_t PC, JitBlock *block)
                     "which is larger than the entire heap size.");
     }
 
-    std::memcpy(dest, block->get_literals_start(), block_size);
+    std::memcpy(dest, literals_start, block_size);
 
     // create a record
     EEJitBlockRecord record;
-    std::size_t literal_size = code_start - literals_start;
-    std::size_t code_size = code_end - code_start;
     record.literals_start = (uint8_t*)dest;
     record.code_start = (uint8_t*)dest + literal_size;
     record.code_end = (uint8_t*)dest + literal_size + code_size;
@@ -641,3 +657,114 @@ EEJitBlockRecord* EEJitHeap::insert_block(uint32_t PC, JitBlock *block)
     page_record->block_array[idx] = record;
     return &page_record->block_array[idx];
 }
+
+/*!
+ * Changes whenever the page containing PC is invalidated or the heap is flushed.
+ */
+uint64_t EEJitHeap::get_generation(uint32_t PC)
+{
+    auto it = page_generations.find(PC / 4096);
+    uint64_t page_generation = it != page_generations.end() ? it->second : 0;
+
+    // both only ever go up, so the sum changes whenever either of them does
+    return flush_generation + page_generation;
+}
+
+void EEJitHeap::set_block_stats_enabled(bool enabled)
+{
+    block_stats_enabled = enabled;
+    block_stats.clear();
+    dispatch_empty_misses = 0;
+    dispatch_conflict_misses = 0;
+}
+
+bool EEJitHeap::get_block_stats_enabled() const
+{
+    return block_stats_enabled;
+}
+
+/*!
+ * Return the stats record for a PC, creating it if needed.
+ * returns nullptr if stats are disabled.
+ */
+EEJitBlockStats* EEJitHeap::get_block_stats(uint32_t PC)
+{
+    if(!block_stats_enabled)
+        return nullptr;
+
+    auto it = block_stats.find(PC);
+    if(it == block_stats.end()) {
+        EEJitBlockStats stats = {};
+        stats.pc = PC;
+        it = block_stats.insert({PC, stats}).first;
+    }
+    return &it->second;
+}
+
+/*!
+ * Called whenever the dispatcher falls back to the slow path.
+ */
+void EEJitHeap::record_dispatch_miss(uint32_t PC)
+{
+    if(!block_stats_enabled)
+        return;
+
+    if(lookup_cache[(PC >> 2) & 0x7FFF])
+        dispatch_conflict_misses++;
+    else
+        dispatch_empty_misses++;
+}
+
+void EEJitHeap::print_block_report(int count)
+{
+    if(!block_stats_enabled) {
+        printf("[EE_JIT64] Block stats are disabled\n");
+        return;
+    }
+
+    std::vector<const EEJitBlockStats*> blocks;
+    uint64_t dispatches = 0;
+    uint64_t compile_ns = 0;
+    for(auto& kv : block_stats) {
+        blocks.push_back(&kv.second);
+        dispatches += kv.second.executions;
+        compile_ns += kv.second.compile_ns;
+    }
+
+    // Every block execution goes through the dispatcher, either via lookup_cache or the slow path
+    uint64_t misses = dispatch_empty_misses + dispatch_conflict_misses;
+    printf("[EE_JIT64] %zu blocks, %llu dispatches, %.3f ms compiling\n", blocks.size(),
+           (unsigned long long)dispatches, compile_ns / 1000000.0);
+    printf("[EE_JIT64] lookup_cache misses: %llu (%.3f%%), %llu empty, %llu conflicting\n",
+           (unsigned long long)misses, dispatches ? 100.0 * misses / dispatches : 0.0,
+           (unsigned long long)dispatch_empty_misses, (unsigned long long)dispatch_conflict_misses);
+    printf("[EE_JIT64] page lookups: %llu, %llu cached\n",
+           (unsigned long long)page_lookups, (unsigned long long)cached_page_lookups);
+
+    int hot_count = std::min(count, (int)blocks.size());
+    std::partial_sort(blocks.begin(), blocks.begin() + hot_count, blocks.end(),
+        [](const EEJitBlockStats* a, const EEJitBlockStats* b) { return a->executions > b->executions; });
+
+    printf("[EE_JIT64] Hottest blocks:\n");
+    printf("[EE_JIT64]   PC        executions     share  instrs  host bytes  compiles  compile us\n");
+    for(int i = 0; i < hot_count; i++) {
+        const EEJitBlockStats* b = blocks[i];
+        printf("[EE_JIT64]   %08X  %12llu  %6.2f%%  %6u  %10u  %8u  %10.1f\n", b->pc,
+               (unsigned long long)b->executions, dispatches ? 100.0 * b->executions / dispatches : 0.0,
+               b->guest_instrs, b->host_size, b->compiles, b->compile_ns / 1000.0);
+    }
+
+    auto churn_end = std::partition(blocks.begin(), blocks.end(),
+        [](const EEJitBlockStats* b) { return b->invalidations > 0; });
+    int churn_count = std::min(count, (int)(churn_end - blocks.begin()));
+    std::partial_sort(blocks.begin(), blocks.begin() + churn_count, churn_end,
+        [](const EEJitBlockStats* a, const EEJitBlockStats* b) { return a->invalidations > b->invalidations; });
+
+    printf("[EE_JIT64] Most invalidated blocks:\n");
+    printf("[EE_JIT64]   PC        invalidations  compiles  compile us  executions\n");
+    for(int i = 0; i < churn_count; i++) {
+        const EEJitBlockStats* b = blocks[i];
+        printf("[EE_JIT64]   %08X  %13u  %8u  %10.1f  %10llu\n", b->pc, b->invalidations, b->compiles,
+               b->compile_ns / 1000.0, (unsigned long long)b->executions);
+    }
+}
@@ -320,6 +320,20 @@ struct EEPageRecord {
 
 using EEJitBlockRecord = JitBlockRecord<EEJitBlockRecordData>;
 
+/*!
+ * Per-PC statistics, kept across invalidations and flushes so recompilation churn shows up.
+ * executions is incremented by the block's own code, so the record must never move while blocks reference it.
+ */
+struct EEJitBlockStats {
+    uint32_t pc;
+    uint64_t executions;
+    uint32_t guest_instrs;
+    uint32_t host_size;
+    uint64_t compile_ns;
+    uint32_t compiles;
+    uint32_t invalidations;
+};
+
 struct FreeList {
     FreeList *next;
     FreeList *prev;
@@ -361,6 +375,16 @@ private:
     uint64_t page_lookups = 0;
     uint64_t cached_page_lookups = 0;
 
+    // block stats
+    bool block_stats_enabled = false;
+    std::unordered_map<uint32_t, EEJitBlockStats> block_stats;
+    uint64_t dispatch_empty_misses = 0;
+    uint64_t dispatch_conflict_misses = 0;
+
+    // bumped whenever blocks are thrown away, so code compiled off-thread can tell it is stale
+    uint64_t flush_generation = 0;
+    std::unordered_map<uint32_t, uint64_t> page_generations;
+
 public:
     EEJitHeap();
     ~EEJitHeap();
@@ -368,9 +392,19 @@ public:
     EEJitBlockRecord* lookup_cache[1024 * 32];
 
     EEJitBlockRecord *insert_block(uint32_t PC, JitBlock* block);
+    EEJitBlockRecord *insert_code(uint32_t PC, const uint8_t* literals_start, std::size_t literal_size,
+                                  std::size_t code_size);
+    uint64_t get_generation(uint32_t PC);
     void flush_all_blocks();
     void invalidate_ee_page(uint32_t page);
     EEJitBlockRecord *find_block(uint32_t PC);
+
+    // Only takes effect for blocks compiled afterwards, so callers should flush the heap when changing it
+    void set_block_stats_enabled(bool enabled);
+    bool get_block_stats_enabled() const;
+    EEJitBlockStats *get_block_stats(uint32_t PC);
+    void record_dispatch_miss(uint32_t PC);
+    void print_block_report(int count);
 };
 
 
@@ -0,0 +1,197 @@
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#ifndef _WIN32
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "../errors.hpp"
+#include "jitsymbols.hpp"
+
+namespace JitSymbols
+{
+
+//See tools/perf/Documentation/jitdump-specification.txt in the Linux tree
+constexpr static uint32_t JITDUMP_MAGIC = 0x4A695444;
+constexpr static uint32_t JITDUMP_VERSION = 1;
+constexpr static uint32_t JIT_CODE_LOAD = 0;
+
+struct JitDumpHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct JitDumpCodeLoad
+{
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+};
+
+static std::atomic<Format> current_format(FORMAT_NONE);
+static std::mutex file_mutex;
+static FILE* file = nullptr;
+static void* marker = nullptr;
+static uint64_t code_index = 0;
+
+#ifndef _WIN32
+static uint64_t monotonic_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static void close_file()
+{
+#ifndef _WIN32
+    if (marker)
+        munmap(marker, sysconf(_SC_PAGESIZE));
+#endif
+    marker = nullptr;
+    if (file)
+        fclose(file);
+    file = nullptr;
+}
+
+bool set_format(Format format)
+{
+    std::lock_guard<std::mutex> lock(file_mutex);
+    close_file();
+    current_format = FORMAT_NONE;
+
+    if (format == FORMAT_NONE)
+        return true;
+
+#ifdef _WIN32
+    Errors::print_warning("[JIT] Symbol export is only supported on Linux");
+    return false;
+#else
+    char name[64];
+    if (format == FORMAT_PERF_MAP)
+        snprintf(name, sizeof(name), "/tmp/perf-%d.map", getpid());
+    else
+        snprintf(name, sizeof(name), "/tmp/jit-%d.dump", getpid());
+
+    file = fopen(name, format == FORMAT_PERF_MAP ? "w" : "w+b");
+    if (!file)
+    {
+        Errors::print_warning("[JIT] Failed to create %s", name);
+        return false;
+    }
+
+    if (format == FORMAT_JITDUMP)
+    {
+        JitDumpHeader header = {};
+        header.magic = JITDUMP_MAGIC;
+        header.version = JITDUMP_VERSION;
+        header.total_size = sizeof(header);
+        header.elf_mach = EM_X86_64;
+        header.pid = getpid();
+        header.timestamp = monotonic_ns();
+        fwrite(&header, sizeof(header), 1, file);
+        fflush(file);
+
+        //perf inject only finds the dump through an executable mapping of it in the recorded process
+        marker = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(file), 0);
+        if (marker == MAP_FAILED)
+        {
+            marker = nullptr;
+            close_file();
+            Errors::print_warning("[JIT] Failed to map %s", name);
+            return false;
+        }
+    }
+
+    printf("[JIT] Writing block symbols to %s\n", name);
+    current_format = format;
+    return true;
+#endif
+}
+
+bool parse_format(const std::string& name, Format& format)
+{
+    if (name == "none")
+        format = FORMAT_NONE;
+    else if (name == "perfmap")
+        format = FORMAT_PERF_MAP;
+    else if (name == "jitdump")
+        format = FORMAT_JITDUMP;
+    else
+        return false;
+    return true;
+}
+
+bool is_enabled()
+{
+    return current_format.load(std::memory_order_relaxed) != FORMAT_NONE;
+}
+
+void add_block(const void* code_start, const void* code_end, const char* name_format, ...)
+{
+    if (!is_enabled())
+        return;
+
+    char name[128];
+    va_list args;
+    va_start(args, name_format);
+    vsnprintf(name, sizeof(name), name_format, args);
+    va_end(args);
+
+    uint64_t start = (uint64_t)code_start;
+    uint64_t size = (uint8_t*)code_end - (uint8_t*)code_start;
+
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (!file)
+        return;
+
+#ifndef _WIN32
+    if (current_format == FORMAT_PERF_MAP)
+        fprintf(file, "%llx %llx %s\n", (unsigned long long)start, (unsigned long long)size, name);
+    else
+    {
+        size_t name_size = strlen(name) + 1;
+
+        JitDumpCodeLoad record;
+        record.id = JIT_CODE_LOAD;
+        record.total_size = sizeof(record) + name_size + size;
+        record.timestamp = monotonic_ns();
+        record.pid = getpid();
+        record.tid = syscall(SYS_gettid);
+        record.vma = start;
+        record.code_addr = start;
+        record.code_size = size;
+        record.code_index = code_index++;
+
+        fwrite(&record, sizeof(record), 1, file);
+        fwrite(name, name_size, 1, file);
+        fwrite(code_start, size, 1, file);
+    }
+
+    //perf reads the file after we've exited, possibly without a clean shutdown
+    fflush(file);
+#endif
+}
+
+};
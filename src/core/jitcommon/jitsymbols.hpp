@@ -0,0 +1,32 @@
+#ifndef JITSYMBOLS_HPP
+#define JITSYMBOLS_HPP
+#include <string>
+
+/**
+  * Exports JIT block symbols so host profilers can attribute samples inside the JIT heaps.
+  * PERF_MAP appends "start size name" lines to /tmp/perf-<pid>.map, which perf report picks up on its own.
+  * JITDUMP writes code load records to /tmp/jit-<pid>.dump for `perf record -k mono` + `perf inject --jit`,
+  * which also keeps the code bytes around for annotation.
+  * Neither format can remove symbols, so blocks freed by a cache flush keep their names until the address is reused.
+  */
+namespace JitSymbols
+{
+
+enum Format
+{
+    FORMAT_NONE,
+    FORMAT_PERF_MAP,
+    FORMAT_JITDUMP
+};
+
+//Returns false if the output file couldn't be created
+bool set_format(Format format);
+bool parse_format(const std::string& name, Format& format);
+bool is_enabled();
+
+//Safe to call from any thread
+void add_block(const void* code_start, const void* code_end, const char* name_format, ...);
+
+};
+
+#endif // JITSYMBOLS_HPP
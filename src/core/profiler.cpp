@@ -0,0 +1,193 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "profiler.hpp"
+
+namespace Profiler
+{
+
+constexpr static size_t MAX_HISTORY = 3600;
+
+std::atomic_bool enabled(false);
+uint64_t section_ticks[SECTION_COUNT];
+uint64_t section_cycles[SECTION_COUNT];
+
+static std::atomic<uint64_t> jit_ticks[JIT_COUNT];
+static std::atomic<uint32_t> jit_compiles[JIT_COUNT];
+static std::atomic<uint32_t> jit_flushes[JIT_COUNT];
+static std::atomic<uint64_t> gs_busy_ns, gs_idle_ns;
+
+static std::chrono::steady_clock::time_point frame_start;
+static uint64_t frame_start_ticks;
+static uint64_t frame_count;
+static bool in_frame = false;
+static std::deque<Frame> history;
+
+static const char* section_names[SECTION_COUNT] =
+{
+    "EE", "VU0", "VU1", "IOP", "IOP DMA", "DMAC", "VIF0", "VIF1", "GIF", "IPU", "Timers", "Events"
+};
+
+static const char* jit_names[JIT_COUNT] =
+{
+    "EE JIT", "VU JIT", "GS JIT"
+};
+
+void set_enabled(bool value)
+{
+    enabled = value;
+    in_frame = false;
+    if (!value)
+        history.clear();
+}
+
+bool is_enabled()
+{
+    return enabled;
+}
+
+void begin_frame()
+{
+    if (!enabled)
+        return;
+
+    memset(section_ticks, 0, sizeof(section_ticks));
+    memset(section_cycles, 0, sizeof(section_cycles));
+    for (int i = 0; i < JIT_COUNT; i++)
+    {
+        jit_ticks[i] = 0;
+        jit_compiles[i] = 0;
+        jit_flushes[i] = 0;
+    }
+    gs_busy_ns = 0;
+    gs_idle_ns = 0;
+
+    in_frame = true;
+    frame_start = std::chrono::steady_clock::now();
+    frame_start_ticks = __rdtsc();
+}
+
+void end_frame()
+{
+    if (!enabled || !in_frame)
+        return;
+    in_frame = false;
+
+    uint64_t ticks = __rdtsc() - frame_start_ticks;
+    std::chrono::duration<double, std::milli> wall = std::chrono::steady_clock::now() - frame_start;
+
+    //The TSC rate isn't known up front, so it's measured over the frame itself
+    double ms_per_tick = ticks ? wall.count() / ticks : 0.0;
+
+    Frame frame;
+    frame.frame = frame_count++;
+    frame.wall_ms = wall.count();
+    for (int i = 0; i < SECTION_COUNT; i++)
+    {
+        frame.section_ms[i] = section_ticks[i] * ms_per_tick;
+        frame.guest_cycles[i] = section_cycles[i];
+    }
+    for (int i = 0; i < JIT_COUNT; i++)
+    {
+        frame.jit_compile_ms[i] = jit_ticks[i] * ms_per_tick;
+        frame.jit_compiles[i] = jit_compiles[i];
+        frame.jit_flushes[i] = jit_flushes[i];
+    }
+    frame.gs_busy_ms = gs_busy_ns / 1000000.0;
+    frame.gs_idle_ms = gs_idle_ns / 1000000.0;
+
+    history.push_back(frame);
+    if (history.size() > MAX_HISTORY)
+        history.pop_front();
+}
+
+void add_jit_compile(Jit jit, uint64_t start)
+{
+    if (!enabled || !start)
+        return;
+    jit_ticks[jit] += __rdtsc() - start;
+    jit_compiles[jit]++;
+}
+
+void add_jit_flush(Jit jit)
+{
+    if (!enabled)
+        return;
+    jit_flushes[jit]++;
+}
+
+void add_gs_time(uint64_t busy_ns, uint64_t idle_ns)
+{
+    if (!enabled)
+        return;
+    gs_busy_ns += busy_ns;
+    gs_idle_ns += idle_ns;
+}
+
+const char* get_section_name(Section section)
+{
+    return section_names[section];
+}
+
+const char* get_jit_name(Jit jit)
+{
+    return jit_names[jit];
+}
+
+bool get_last_frame(Frame& frame)
+{
+    if (history.empty())
+        return false;
+    frame = history.back();
+    return true;
+}
+
+const std::deque<Frame>& get_history()
+{
+    return history;
+}
+
+static std::string csv_name(const char* name)
+{
+    std::string column(name);
+    for (char& c : column)
+    {
+        if (c == ' ')
+            c = '_';
+    }
+    return column;
+}
+
+bool write_csv(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+
+    file << "frame,wall_ms";
+    for (int i = 0; i < SECTION_COUNT; i++)
+        file << "," << csv_name(section_names[i]) << "_ms," << csv_name(section_names[i]) << "_cycles";
+    for (int i = 0; i < JIT_COUNT; i++)
+    {
+        std::string name = csv_name(jit_names[i]);
+        file << "," << name << "_ms," << name << "_compiles," << name << "_flushes";
+    }
+    file << ",GS_busy_ms,GS_idle_ms\n";
+
+    for (const Frame& frame : history)
+    {
+        file << frame.frame << "," << frame.wall_ms;
+        for (int i = 0; i < SECTION_COUNT; i++)
+            file << "," << frame.section_ms[i] << "," << frame.guest_cycles[i];
+        for (int i = 0; i < JIT_COUNT; i++)
+            file << "," << frame.jit_compile_ms[i] << "," << frame.jit_compiles[i] << "," << frame.jit_flushes[i];
+        file << "," << frame.gs_busy_ms << "," << frame.gs_idle_ms << "\n";
+    }
+
+    printf("[Profiler] Wrote %d frames to %s\n", (int)history.size(), path.c_str());
+    return true;
+}
+
+};
@@ -0,0 +1,105 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+/**
+  * Per-frame profiler for Emulator::run.
+  * Host time is taken with the TSC and calibrated against steady_clock once per frame, so a section costs two
+  * rdtscs while enabled and a single branch while disabled.
+  * JIT and GS thread counters may be updated from any thread; everything else belongs to the emulation thread.
+  */
+namespace Profiler
+{
+
+enum Section
+{
+    SECTION_EE,
+    SECTION_VU0,
+    SECTION_VU1,
+    SECTION_IOP,
+    SECTION_IOP_DMA,
+    SECTION_DMAC,
+    SECTION_VIF0,
+    SECTION_VIF1,
+    SECTION_GIF,
+    SECTION_IPU,
+    SECTION_TIMERS,
+    SECTION_EVENTS,
+    SECTION_COUNT
+};
+
+enum Jit
+{
+    JIT_EE,
+    JIT_VU,
+    JIT_GS,
+    JIT_COUNT
+};
+
+struct Frame
+{
+    uint64_t frame;
+    double wall_ms;
+
+    //VU0 work done while syncing with COP2 is counted under the EE
+    double section_ms[SECTION_COUNT];
+    uint64_t guest_cycles[SECTION_COUNT];
+
+    double jit_compile_ms[JIT_COUNT];
+    uint32_t jit_compiles[JIT_COUNT];
+    uint32_t jit_flushes[JIT_COUNT];
+
+    double gs_busy_ms;
+    double gs_idle_ms;
+};
+
+extern std::atomic_bool enabled;
+extern uint64_t section_ticks[SECTION_COUNT];
+extern uint64_t section_cycles[SECTION_COUNT];
+
+inline uint64_t timestamp()
+{
+    return enabled.load(std::memory_order_relaxed) ? __rdtsc() : 0;
+}
+
+//Adds the time since start to a section and returns the new timestamp to chain the next section from
+inline uint64_t end_section(Section section, uint64_t start, uint64_t guest_cycles = 0)
+{
+    if (!enabled.load(std::memory_order_relaxed))
+        return 0;
+    uint64_t now = __rdtsc();
+    section_ticks[section] += now - start;
+    section_cycles[section] += guest_cycles;
+    return now;
+}
+
+void set_enabled(bool value);
+bool is_enabled();
+
+void begin_frame();
+void end_frame();
+
+void add_jit_compile(Jit jit, uint64_t start);
+void add_jit_flush(Jit jit);
+void add_gs_time(uint64_t busy_ns, uint64_t idle_ns);
+
+const char* get_section_name(Section section);
+const char* get_jit_name(Jit jit);
+
+//Returns false until a frame has been profiled
+bool get_last_frame(Frame& frame);
+const std::deque<Frame>& get_history();
+bool write_csv(const std::string& path);
+
+};
+
+#endif // PROFILER_HPP
@@ -3,7 +3,7 @@
 #include "emulator.hpp"
 #include "scheduler.hpp"
 
-Scheduler::Scheduler()
+Scheduler::Scheduler() : iop_threaded(false)
 {
 
 }
@@ -19,8 +19,60 @@ void Scheduler::reset()
     iop_cycles.remainder = 0;
 
     closest_event_time = 0x7FFFFFFFULL << 32ULL;
+    closest_iop_event_time = 0x7FFFFFFFULL << 32ULL;
+    iop_thread_cycles = 0;
 
     events.clear();
+    iop_events.clear();
+}
+
+bool Scheduler::is_iop_event(EVENT_ID id)
+{
+    return id == CDVD_EVENT || id == SPU_SAMPLE;
+}
+
+std::list<SchedulerEvent>& Scheduler::get_event_list(EVENT_ID id)
+{
+    if (iop_threaded && is_iop_event(id))
+        return iop_events;
+    return events;
+}
+
+//Moves the IOP events to wherever they're processed in the new mode. The IOP thread must have caught up.
+void Scheduler::set_iop_threaded(bool threaded)
+{
+    if (threaded == iop_threaded)
+        return;
+
+    if (threaded)
+    {
+        iop_thread_cycles = iop_cycles.count;
+        for (auto it = events.begin(); it != events.end(); )
+        {
+            if (is_iop_event(it->id))
+            {
+                closest_iop_event_time = std::min(it->time_to_run, closest_iop_event_time);
+                iop_events.push_back(*it);
+                it = events.erase(it);
+            }
+            else
+                it++;
+        }
+    }
+    else
+    {
+        if (iop_thread_cycles != iop_cycles.count)
+            Errors::die("[Scheduler] IOP thread stopped at cycle %lld, expected %lld",
+                        (long long)iop_thread_cycles, (long long)iop_cycles.count);
+        for (SchedulerEvent& event : iop_events)
+        {
+            closest_event_time = std::min(event.time_to_run, closest_event_time);
+            events.push_back(event);
+        }
+        iop_events.clear();
+        closest_iop_event_time = 0x7FFFFFFFULL << 32ULL;
+    }
+    iop_threaded = threaded;
 }
 
 unsigned int Scheduler::calculate_run_cycles()
@@ -62,9 +114,29 @@ unsigned int Scheduler::get_iop_run_cycles()
 
 void Scheduler::add_event(SchedulerEvent& event)
 {
-    closest_event_time = std::min(event.time_to_run, closest_event_time);
+    if (iop_threaded && is_iop_event(event.id))
+        closest_iop_event_time = std::min(event.time_to_run, closest_iop_event_time);
+    else
+        closest_event_time = std::min(event.time_to_run, closest_event_time);
 
-    events.push_back(event);
+    get_event_list(event.id).push_back(event);
+}
+
+//Must not be called from an event handler for the event being rescheduled, as process_events erases it afterwards
+void Scheduler::reschedule_event(EVENT_ID id, int64_t time_to_run)
+{
+    for (SchedulerEvent& event : get_event_list(id))
+    {
+        if (event.id == id)
+        {
+            event.time_to_run = time_to_run;
+            break;
+        }
+    }
+    if (iop_threaded && is_iop_event(id))
+        closest_iop_event_time = std::min(time_to_run, closest_iop_event_time);
+    else
+        closest_event_time = std::min(time_to_run, closest_event_time);
 }
 
 void Scheduler::update_cycle_counts()
@@ -91,21 +163,43 @@ void Scheduler::update_cycle_counts()
 void Scheduler::process_events(Emulator* e)
 {
     if (ee_cycles.count >= closest_event_time)
+        closest_event_time = run_due_events(e, events, closest_event_time);
+}
+
+//Runs every event due by closest_time and returns the time of the next one
+int64_t Scheduler::run_due_events(Emulator* e, std::list<SchedulerEvent>& list, int64_t closest_time)
+{
+    int64_t new_time = 0x7FFFFFFFULL << 32ULL;
+    for (auto it = list.begin(); it != list.end(); )
     {
-        int64_t new_time = 0x7FFFFFFFULL << 32ULL;
-        for (auto it = events.begin(); it != events.end(); )
+        if (it->time_to_run <= closest_time)
         {
-            if (it->time_to_run <= closest_event_time)
-            {
-                (e->*it->func)();
-                it = events.erase(it);
-            }
-            else
-            {
-                new_time = std::min(it->time_to_run, new_time);
-                it++;
-            }
+            (e->*it->func)();
+            it = list.erase(it);
+        }
+        else
+        {
+            new_time = std::min(it->time_to_run, new_time);
+            it++;
         }
-        closest_event_time = new_time;
     }
+    return new_time;
+}
+
+void Scheduler::add_iop_thread_cycles(int cycles)
+{
+    iop_thread_cycles += cycles;
+}
+
+//How many cycles the IOP thread can run before its next event is due, at least one
+int64_t Scheduler::get_iop_cycles_to_event()
+{
+    int64_t delta = (closest_iop_event_time >> 3) - iop_thread_cycles;
+    return std::max(delta, (int64_t)1);
+}
+
+void Scheduler::process_iop_events(Emulator* e)
+{
+    if ((iop_thread_cycles << 3) >= closest_iop_event_time)
+        closest_iop_event_time = run_due_events(e, iop_events, closest_iop_event_time);
 }
@@ -42,6 +42,18 @@ class Scheduler
         std::list<SchedulerEvent> events;
 
         int64_t closest_event_time;
+
+        //While the IOP has its own thread, IOP events are kept apart and run against the cycles it has actually
+        //executed. iop_cycles then only tracks how far the EE has allowed it to run.
+        //The IOP thread's members get their own cache line, as the EE side updates the ones above constantly.
+        bool iop_threaded;
+        alignas(64) std::list<SchedulerEvent> iop_events;
+        int64_t closest_iop_event_time;
+        int64_t iop_thread_cycles;
+
+        static bool is_iop_event(EVENT_ID id);
+        std::list<SchedulerEvent>& get_event_list(EVENT_ID id);
+        int64_t run_due_events(Emulator* e, std::list<SchedulerEvent>& list, int64_t closest_time);
     public:
         Scheduler();
 
@@ -53,8 +65,15 @@ class Scheduler
 
         int64_t get_ee_cycles();
         int64_t get_iop_cycles();
+        int64_t get_iop_target_cycles();
+
+        void set_iop_threaded(bool threaded);
+        void add_iop_thread_cycles(int cycles);
+        int64_t get_iop_cycles_to_event();
+        void process_iop_events(Emulator* e);
 
         void add_event(SchedulerEvent& event);
+        void reschedule_event(EVENT_ID id, int64_t time_to_run);
 
         void update_cycle_counts();
         void process_events(Emulator* e);
@@ -69,6 +88,11 @@ inline int64_t Scheduler::get_ee_cycles()
 }
 
 inline int64_t Scheduler::get_iop_cycles()
+{
+    return iop_threaded ? iop_thread_cycles : iop_cycles.count;
+}
+
+inline int64_t Scheduler::get_iop_target_cycles()
 {
     return iop_cycles.count;
 }
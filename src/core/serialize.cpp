@@ -4,7 +4,7 @@
 
 #define VER_MAJOR 0
 #define VER_MINOR 0
-#define VER_REV 33
+#define VER_REV 38
 
 using namespace std;
 
@@ -68,6 +68,8 @@ void Emulator::load_state(const char *file_name)
     //Emulator info
     state.read((char*)&VBLANK_sent, sizeof(VBLANK_sent));
     state.read((char*)&frames, sizeof(frames));
+    state.read((char*)&spu_next_sample, sizeof(spu_next_sample));
+    state.read((char*)&spu_block_end, sizeof(spu_block_end));
 
     //RAM
     state.read((char*)RDRAM, 1024 * 1024 * 32);
@@ -115,6 +117,8 @@ void Emulator::load_state(const char *file_name)
 
     scheduler.load_state(state);
     pad.load_state(state);
+    memcard.load_state(state);
+    sio2.load_state(state);
     spu.load_state(state);
     spu2.load_state(state);
 
@@ -146,6 +150,8 @@ void Emulator::save_state(const char *file_name)
     //Emulator info
     state.write((char*)&VBLANK_sent, sizeof(VBLANK_sent));
     state.write((char*)&frames, sizeof(frames));
+    state.write((char*)&spu_next_sample, sizeof(spu_next_sample));
+    state.write((char*)&spu_block_end, sizeof(spu_block_end));
 
     //RAM
     state.write((char*)RDRAM, 1024 * 1024 * 32);
@@ -193,6 +199,8 @@ void Emulator::save_state(const char *file_name)
 
     scheduler.save_state(state);
     pad.save_state(state);
+    memcard.save_state(state);
+    sio2.save_state(state);
     spu.save_state(state);
     spu2.save_state(state);
 
@@ -384,6 +392,8 @@ void VectorUnit::load_state(ifstream &state)
         state.read((char*)&instr_mem, 1024 * 16);
         state.read((char*)&data_mem, 1024 * 16);
     }
+    dirty_ranges = ~0ULL;
+    vumem_is_dirty = true;
 
     state.read((char*)&running, sizeof(running));
     state.read((char*)&PC, sizeof(PC));
@@ -599,6 +609,7 @@ void IOP_DMA::load_state(ifstream &state)
 
     state.read((char*)&DPCR, sizeof(DPCR));
     state.read((char*)&DICR, sizeof(DICR));
+    state.read((char*)&stall_cycles, sizeof(stall_cycles));
 
     //We have to reapply the function pointers as there's no guarantee they will remain in memory
     //the next time Dobie is loaded
@@ -624,6 +635,7 @@ void IOP_DMA::save_state(ofstream &state)
 
     state.write((char*)&DPCR, sizeof(DPCR));
     state.write((char*)&DICR, sizeof(DICR));
+    state.write((char*)&stall_cycles, sizeof(stall_cycles));
 }
 
 void GraphicsInterface::load_state(ifstream &state)
@@ -667,58 +679,47 @@ void GraphicsInterface::save_state(ofstream &state)
 
 void SubsystemInterface::load_state(ifstream &state)
 {
-    state.read((char*)&mscom, sizeof(mscom));
-    state.read((char*)&smcom, sizeof(smcom));
-    state.read((char*)&msflag, sizeof(msflag));
-    state.read((char*)&smflag, sizeof(smflag));
-    state.read((char*)&control, sizeof(control));
+    std::atomic<uint32_t>* registers[] = {&mscom, &smcom, &msflag, &smflag, &control};
+    for (auto reg : registers)
+    {
+        uint32_t value;
+        state.read((char*)&value, sizeof(value));
+        *reg = value;
+    }
 
     int size;
-    uint32_t buffer[32];
+    uint32_t buffer[SIF_FIFO::CAPACITY];
     state.read((char*)&size, sizeof(int));
     state.read((char*)&buffer, sizeof(uint32_t) * size);
 
     //FIFOs are already cleared by the reset call, so no need to pop them
-    for (int i = 0; i < size; i++)
-        SIF0_FIFO.push(buffer[i]);
+    SIF0_FIFO.push(buffer, size);
 
     state.read((char*)&size, sizeof(int));
     state.read((char*)&buffer, sizeof(uint32_t) * size);
 
-    for (int i = 0; i < size; i++)
-        SIF1_FIFO.push(buffer[i]);
+    SIF1_FIFO.push(buffer, size);
 }
 
 void SubsystemInterface::save_state(ofstream &state)
 {
-    state.write((char*)&mscom, sizeof(mscom));
-    state.write((char*)&smcom, sizeof(smcom));
-    state.write((char*)&msflag, sizeof(msflag));
-    state.write((char*)&smflag, sizeof(smflag));
-    state.write((char*)&control, sizeof(control));
-
-    int size = SIF0_FIFO.size();
-    uint32_t buffer[32];
-    for (int i = 0; i < size; i++)
+    std::atomic<uint32_t>* registers[] = {&mscom, &smcom, &msflag, &smflag, &control};
+    for (auto reg : registers)
     {
-        buffer[i] = SIF0_FIFO.front();
-        SIF0_FIFO.pop();
+        uint32_t value = *reg;
+        state.write((char*)&value, sizeof(value));
     }
+
+    int size = SIF0_FIFO.size();
+    uint32_t buffer[SIF_FIFO::CAPACITY];
+    SIF0_FIFO.peek(buffer, size);
     state.write((char*)&size, sizeof(int));
     state.write((char*)&buffer, sizeof(uint32_t) * size);
-    for (int i = 0; i < size; i++)
-        SIF0_FIFO.push(buffer[i]);
 
     size = SIF1_FIFO.size();
-    for (int i = 0; i < size; i++)
-    {
-        buffer[i] = SIF1_FIFO.front();
-        SIF1_FIFO.pop();
-    }
+    SIF1_FIFO.peek(buffer, size);
     state.write((char*)&size, sizeof(int));
     state.write((char*)&buffer, sizeof(uint32_t) * size);
-    for (int i = 0; i < size; i++)
-        SIF1_FIFO.push(buffer[i]);
 }
 
 void VectorInterface::load_state(ifstream &state)
@@ -841,6 +842,10 @@ void CDVD_Drive::load_state(ifstream &state)
     state.read((char*)&S_out_params, sizeof(S_out_params));
     state.read((char*)&S_status, sizeof(S_status));
     state.read((char*)&rtc, sizeof(rtc));
+
+    uint64_t stream_pos;
+    state.read((char*)&stream_pos, sizeof(stream_pos));
+    read_ahead.start(stream_pos, sectors_left * get_stream_sector_size());
 }
 
 void CDVD_Drive::save_state(ofstream &state)
@@ -870,6 +875,9 @@ void CDVD_Drive::save_state(ofstream &state)
     state.write((char*)&S_out_params, sizeof(S_out_params));
     state.write((char*)&S_status, sizeof(S_status));
     state.write((char*)&rtc, sizeof(rtc));
+
+    uint64_t stream_pos = read_ahead.tell();
+    state.write((char*)&stream_pos, sizeof(stream_pos));
 }
 
 void Scheduler::load_state(ifstream &state)
@@ -904,8 +912,9 @@ void Scheduler::load_state(ifstream &state)
                 Errors::die("Event id %d not recognized!", event.id);
         }
 
-        events.push_back(event);
+        add_event(event);
     }
+    iop_thread_cycles = iop_cycles.count;
 }
 
 void Scheduler::save_state(ofstream &state)
@@ -916,14 +925,18 @@ void Scheduler::save_state(ofstream &state)
     state.write((char*)&run_cycles, sizeof(run_cycles));
     state.write((char*)&closest_event_time, sizeof(closest_event_time));
 
-    int event_size = events.size();
+    //IOP events are stored with the rest whichever thread runs them
+    int event_size = events.size() + iop_events.size();
     state.write((char*)&event_size, sizeof(event_size));
 
-    for (auto it = events.begin(); it != events.end(); it++)
+    for (auto list : {&events, &iop_events})
     {
-        SchedulerEvent event = *it;
-        state.write((char*)&event.id, sizeof(event.id));
-        state.write((char*)&event.time_to_run, sizeof(event.time_to_run));
+        for (auto it = list->begin(); it != list->end(); it++)
+        {
+            SchedulerEvent event = *it;
+            state.write((char*)&event.id, sizeof(event.id));
+            state.write((char*)&event.time_to_run, sizeof(event.time_to_run));
+        }
     }
 }
 
@@ -951,6 +964,100 @@ void Gamepad::save_state(ofstream &state)
     state.write((char*)&config_mode, sizeof(config_mode));
 }
 
+void Memcard::load_state(ifstream &state)
+{
+    state.read((char*)&terminator, sizeof(terminator));
+    state.read((char*)&command, sizeof(command));
+    state.read((char*)&position, sizeof(position));
+    state.read((char*)&length, sizeof(length));
+    state.read((char*)&page, sizeof(page));
+    uint64_t addr;
+    state.read((char*)&addr, sizeof(addr));
+    address = addr;
+    state.read((char*)&data_length, sizeof(data_length));
+    state.read((char*)&checksum, sizeof(checksum));
+
+    int size;
+    state.read((char*)&size, sizeof(size));
+    response.resize(size);
+    state.read((char*)response.data(), size);
+    state.read((char*)&size, sizeof(size));
+    data_buffer.resize(size);
+    state.read((char*)data_buffer.data(), size);
+}
+
+void Memcard::save_state(ofstream &state)
+{
+    state.write((char*)&terminator, sizeof(terminator));
+    state.write((char*)&command, sizeof(command));
+    state.write((char*)&position, sizeof(position));
+    state.write((char*)&length, sizeof(length));
+    state.write((char*)&page, sizeof(page));
+    uint64_t addr = address;
+    state.write((char*)&addr, sizeof(addr));
+    state.write((char*)&data_length, sizeof(data_length));
+    state.write((char*)&checksum, sizeof(checksum));
+
+    int size = response.size();
+    state.write((char*)&size, sizeof(size));
+    state.write((char*)response.data(), size);
+    size = data_buffer.size();
+    state.write((char*)&size, sizeof(size));
+    state.write((char*)data_buffer.data(), size);
+}
+
+void SIO2::load_state(ifstream &state)
+{
+    state.read((char*)&send1, sizeof(send1));
+    state.read((char*)&send2, sizeof(send2));
+    state.read((char*)&send3, sizeof(send3));
+    state.read((char*)&RECV1, sizeof(RECV1));
+    state.read((char*)&RECV3, sizeof(RECV3));
+    state.read((char*)&port, sizeof(port));
+    state.read((char*)&control, sizeof(control));
+    state.read((char*)&new_command, sizeof(new_command));
+    state.read((char*)&active_command, sizeof(active_command));
+    state.read((char*)&command_length, sizeof(command_length));
+    state.read((char*)&transfer_length, sizeof(transfer_length));
+    state.read((char*)&send3_port, sizeof(send3_port));
+
+    //The FIFO is already cleared by the reset call
+    int size;
+    state.read((char*)&size, sizeof(size));
+    for (int i = 0; i < size; i++)
+    {
+        uint8_t value;
+        state.read((char*)&value, sizeof(value));
+        FIFO.push(value);
+    }
+}
+
+void SIO2::save_state(ofstream &state)
+{
+    state.write((char*)&send1, sizeof(send1));
+    state.write((char*)&send2, sizeof(send2));
+    state.write((char*)&send3, sizeof(send3));
+    state.write((char*)&RECV1, sizeof(RECV1));
+    state.write((char*)&RECV3, sizeof(RECV3));
+    state.write((char*)&port, sizeof(port));
+    state.write((char*)&control, sizeof(control));
+    state.write((char*)&new_command, sizeof(new_command));
+    state.write((char*)&active_command, sizeof(active_command));
+    state.write((char*)&command_length, sizeof(command_length));
+    state.write((char*)&transfer_length, sizeof(transfer_length));
+    state.write((char*)&send3_port, sizeof(send3_port));
+
+    std::queue<uint8_t> fifo = FIFO;
+    int size = fifo.size();
+    state.write((char*)&size, sizeof(size));
+    while (!fifo.empty())
+    {
+        uint8_t value = fifo.front();
+        fifo.pop();
+        state.write((char*)&value, sizeof(value));
+    }
+}
+
 void SPU::load_state(ifstream &state)
 {
     state.read((char*)&voices, sizeof(voices));
@@ -966,6 +1073,12 @@ void SPU::load_state(ifstream &state)
     state.read((char*)&ENDX, sizeof(ENDX));
     state.read((char*)&key_off, sizeof(key_off));
     state.read((char*)&key_on, sizeof(key_on));
+    state.read((char*)&voice_mixdry_left, sizeof(voice_mixdry_left));
+    state.read((char*)&voice_mixdry_right, sizeof(voice_mixdry_right));
+    state.read((char*)&voice_mixwet_left, sizeof(voice_mixwet_left));
+    state.read((char*)&voice_mixwet_right, sizeof(voice_mixwet_right));
+
+    update_mix_volumes();
 }
 
 void SPU::save_state(ofstream &state)
@@ -983,4 +1096,8 @@ void SPU::save_state(ofstream &state)
     state.write((char*)&ENDX, sizeof(ENDX));
     state.write((char*)&key_off, sizeof(key_off));
     state.write((char*)&key_on, sizeof(key_on));
+    state.write((char*)&voice_mixdry_left, sizeof(voice_mixdry_left));
+    state.write((char*)&voice_mixdry_right, sizeof(voice_mixdry_right));
+    state.write((char*)&voice_mixwet_left, sizeof(voice_mixwet_left));
+    state.write((char*)&voice_mixwet_right, sizeof(voice_mixwet_right));
 }
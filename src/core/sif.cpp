@@ -1,81 +1,230 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include "errors.hpp"
 #include "sif.hpp"
 
 #include "iop/iop_dma.hpp"
 #include "ee/dmac.hpp"
 
-SubsystemInterface::SubsystemInterface(IOP_DMA* iop_dma, DMAC* dmac) : iop_dma(iop_dma), dmac(dmac)
+SIF_FIFO::SIF_FIFO() : head(0), tail(0)
+{
+
+}
+
+//Only safe while neither side is transferring
+void SIF_FIFO::clear()
+{
+    head = 0;
+    tail = 0;
+}
+
+int SIF_FIFO::size() const
+{
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+void SIF_FIFO::push(uint32_t word)
+{
+    push(&word, 1);
+}
+
+void SIF_FIFO::push(const uint32_t* words, int count)
+{
+    uint32_t current_tail = tail.load(std::memory_order_relaxed);
+    if (current_tail - head.load(std::memory_order_acquire) + count > CAPACITY)
+        Errors::die("[SIF] FIFO overflow");
+
+    uint32_t start = current_tail & (CAPACITY - 1);
+    uint32_t first = std::min((uint32_t)count, CAPACITY - start);
+    memcpy(&buffer[start], words, first * sizeof(uint32_t));
+    memcpy(&buffer[0], words + first, (count - first) * sizeof(uint32_t));
+
+    tail.store(current_tail + count, std::memory_order_release);
+}
+
+uint32_t SIF_FIFO::pop()
+{
+    uint32_t word;
+    pop(&word, 1);
+    return word;
+}
+
+void SIF_FIFO::pop(uint32_t* words, int count)
+{
+    uint32_t current_head = head.load(std::memory_order_relaxed);
+    if (tail.load(std::memory_order_acquire) - current_head < (uint32_t)count)
+        Errors::die("[SIF] FIFO underflow");
+
+    uint32_t start = current_head & (CAPACITY - 1);
+    uint32_t first = std::min((uint32_t)count, CAPACITY - start);
+    memcpy(words, &buffer[start], first * sizeof(uint32_t));
+    memcpy(words + first, &buffer[0], (count - first) * sizeof(uint32_t));
+
+    head.store(current_head + count, std::memory_order_release);
+}
+
+void SIF_FIFO::peek(uint32_t* words, int count) const
+{
+    uint32_t start = head.load(std::memory_order_relaxed) & (CAPACITY - 1);
+    uint32_t first = std::min((uint32_t)count, CAPACITY - start);
+    memcpy(words, &buffer[start], first * sizeof(uint32_t));
+    memcpy(words + first, &buffer[0], (count - first) * sizeof(uint32_t));
+}
+
+SubsystemInterface::SubsystemInterface(IOP_DMA* iop_dma, DMAC* dmac) : iop_dma(iop_dma), dmac(dmac), threaded(false)
 {
 
 }
 
 void SubsystemInterface::reset()
 {
-    std::queue<uint32_t> empty, empty2;
-    SIF0_FIFO.swap(empty);
-    SIF1_FIFO.swap(empty2);
+    SIF0_FIFO.clear();
+    SIF1_FIFO.clear();
     mscom = 0;
     smcom = 0;
     msflag = 0;
     smflag = 0;
     control = 0;
+
+    EE_SIF0_pending = false;
+    EE_SIF1_pending = false;
+    IOP_SIF0_pending = false;
+    IOP_SIF1_pending = false;
+}
+
+//Only safe while the IOP thread is paused
+void SubsystemInterface::set_threaded(bool threaded)
+{
+    this->threaded = threaded;
+    update_EE_DMA_requests();
+    update_IOP_DMA_requests();
+}
+
+//Loading the flag first means the common case doesn't pay for a locked instruction
+static bool take_flag(std::atomic_bool& flag)
+{
+    return flag.load(std::memory_order_relaxed) && flag.exchange(false);
+}
+
+//Raises the EE requests the IOP flagged. The FIFO is checked again, as the EE may have drained it since.
+void SubsystemInterface::update_EE_DMA_requests()
+{
+    if (take_flag(EE_SIF0_pending) && SIF0_FIFO.size() >= 4)
+        dmac->set_DMA_request(EE_SIF0);
+    if (take_flag(EE_SIF1_pending) && SIF1_FIFO.size() < MAX_FIFO_SIZE / 2)
+        dmac->set_DMA_request(EE_SIF1);
+}
+
+void SubsystemInterface::update_IOP_DMA_requests()
+{
+    if (take_flag(IOP_SIF0_pending) && SIF0_FIFO.size() < MAX_FIFO_SIZE)
+        iop_dma->set_DMA_request(IOP_SIF0);
+    if (take_flag(IOP_SIF1_pending) && SIF1_FIFO.size())
+        iop_dma->set_DMA_request(IOP_SIF1);
 }
 
 void SubsystemInterface::write_SIF0(uint32_t word)
 {
-    if (SIF0_FIFO.size() < 4)
-        oldest_SIF0_data[SIF0_FIFO.size()] = word;
-    SIF0_FIFO.push(word);
+    write_SIF0(&word, 1);
+}
+
+void SubsystemInterface::write_SIF0(const uint32_t* words, int count)
+{
+    for (int i = 0; i < count && SIF0_FIFO.size() + i < 4; i++)
+        oldest_SIF0_data[SIF0_FIFO.size() + i] = words[i];
+    SIF0_FIFO.push(words, count);
     if (SIF0_FIFO.size() >= MAX_FIFO_SIZE)
         iop_dma->clear_DMA_request(IOP_SIF0);
     if (SIF0_FIFO.size() >= 4)
-        dmac->set_DMA_request(EE_SIF0);
+    {
+        if (threaded)
+            EE_SIF0_pending = true;
+        else
+            dmac->set_DMA_request(EE_SIF0);
+    }
 }
 
 void SubsystemInterface::send_SIF0_junk(int count)
 {
     uint32_t temp[4];
-    memcpy(temp, oldest_SIF0_data, 4);
+    memcpy(temp, oldest_SIF0_data, sizeof(temp));
     for (int i = 4 - count; i < 4; i++)
-    {
         printf("[SIF] Send junk: $%08X\n", temp[i]);
-        write_SIF0(temp[i]);
-    }
+    write_SIF0(temp + 4 - count, count);
 }
 
 void SubsystemInterface::write_SIF1(uint128_t quad)
 {
     //printf("[SIF] Write SIF1: $%08X_%08X_%08X_%08X\n", quad._u32[3], quad._u32[2], quad._u32[1], quad._u32[0]);
-    for (int i = 0; i < 4; i++)
-        SIF1_FIFO.push(quad._u32[i]);
-    iop_dma->set_DMA_request(IOP_SIF1);
+    write_SIF1(&quad, 1);
+}
+
+void SubsystemInterface::write_SIF1(const uint128_t* quads, int count)
+{
+    SIF1_FIFO.push((const uint32_t*)quads, count * 4);
+    if (threaded)
+        IOP_SIF1_pending = true;
+    else
+        iop_dma->set_DMA_request(IOP_SIF1);
     if (SIF1_FIFO.size() >= MAX_FIFO_SIZE / 2)
         dmac->clear_DMA_request(EE_SIF1);
 }
 
 uint32_t SubsystemInterface::read_SIF0()
 {
-    uint32_t value = SIF0_FIFO.front();
-    SIF0_FIFO.pop();
-    iop_dma->set_DMA_request(IOP_SIF0);
+    uint32_t value = SIF0_FIFO.pop();
+    if (threaded)
+        IOP_SIF0_pending = true;
+    else
+        iop_dma->set_DMA_request(IOP_SIF0);
 
     if (SIF0_FIFO.size() < 4)
         dmac->clear_DMA_request(EE_SIF0);
     return value;
 }
 
+void SubsystemInterface::read_SIF0(uint128_t* quads, int count)
+{
+    SIF0_FIFO.pop((uint32_t*)quads, count * 4);
+    if (threaded)
+        IOP_SIF0_pending = true;
+    else
+        iop_dma->set_DMA_request(IOP_SIF0);
+
+    if (SIF0_FIFO.size() < 4)
+        dmac->clear_DMA_request(EE_SIF0);
+}
+
 uint32_t SubsystemInterface::read_SIF1()
 {
-    uint32_t value = SIF1_FIFO.front();
-    SIF1_FIFO.pop();
+    uint32_t value = SIF1_FIFO.pop();
     if (!SIF1_FIFO.size())
         iop_dma->clear_DMA_request(IOP_SIF1);
     if (SIF1_FIFO.size() < MAX_FIFO_SIZE / 2)
-        dmac->set_DMA_request(EE_SIF1);
+    {
+        if (threaded)
+            EE_SIF1_pending = true;
+        else
+            dmac->set_DMA_request(EE_SIF1);
+    }
     return value;
 }
 
+void SubsystemInterface::read_SIF1(uint32_t* words, int count)
+{
+    SIF1_FIFO.pop(words, count);
+    if (!SIF1_FIFO.size())
+        iop_dma->clear_DMA_request(IOP_SIF1);
+    if (SIF1_FIFO.size() < MAX_FIFO_SIZE / 2)
+    {
+        if (threaded)
+            EE_SIF1_pending = true;
+        else
+            dmac->set_DMA_request(EE_SIF1);
+    }
+}
+
 uint32_t SubsystemInterface::get_mscom()
 {
     return mscom;
@@ -143,14 +292,20 @@ void SubsystemInterface::set_control_IOP(uint32_t value)
 {
     uint8_t bark = value & 0xF0;
 
-    if (value & 0xA0)
+    uint32_t old_control = control.load();
+    uint32_t new_control;
+    do
     {
-        control &= ~0xF000;
-        control |= 0x2000;
-    }
+        new_control = old_control;
+        if (value & 0xA0)
+        {
+            new_control &= ~0xF000;
+            new_control |= 0x2000;
+        }
 
-    if (control & bark)
-        control &= ~bark;
-    else
-        control |= bark;
+        if (new_control & bark)
+            new_control &= ~bark;
+        else
+            new_control |= bark;
+    } while (!control.compare_exchange_weak(old_control, new_control));
 }
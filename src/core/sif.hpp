@@ -1,42 +1,87 @@
 #ifndef SIF_HPP
 #define SIF_HPP
+#include <atomic>
 #include <cstdint>
 #include <fstream>
-#include <queue>
 
 #include "int128.hpp"
 
 class IOP_DMA;
 class DMAC;
 
+/**
+  * Ring of SIF words, safe to use lock-free with one producer and one consumer thread.
+  * Spans are copied in at most two pieces, so bulk transfers don't pay a call per word.
+  * The read and write positions run freely and are only masked on access.
+  */
+class SIF_FIFO
+{
+    public:
+        //Bigger than MAX_FIFO_SIZE, as the DMACs may push a whole burst past the point their request is cleared
+        constexpr static uint32_t CAPACITY = 64;
+    private:
+        uint32_t buffer[CAPACITY];
+        std::atomic<uint32_t> head;
+        std::atomic<uint32_t> tail;
+    public:
+        SIF_FIFO();
+
+        void clear();
+        int size() const;
+
+        void push(uint32_t word);
+        void push(const uint32_t* words, int count);
+        uint32_t pop();
+        void pop(uint32_t* words, int count);
+
+        //Copies out the oldest words without consuming them
+        void peek(uint32_t* words, int count) const;
+};
+
 class SubsystemInterface
 {
     private:
         IOP_DMA* iop_dma;
         DMAC* dmac;
-        uint32_t mscom;
-        uint32_t smcom;
-        uint32_t msflag;
-        uint32_t smflag;
-        uint32_t control; //???
+
+        //Registers are atomic as both sides may write them at once when the IOP has its own thread
+        std::atomic<uint32_t> mscom;
+        std::atomic<uint32_t> smcom;
+        std::atomic<uint32_t> msflag;
+        std::atomic<uint32_t> smflag;
+        std::atomic<uint32_t> control; //???
+
+        //With the IOP threaded, a side never touches the other's DMA controller.
+        //It flags the request instead, and the owner raises it on its next update.
+        bool threaded;
+        alignas(64) std::atomic_bool EE_SIF0_pending, EE_SIF1_pending;
+        alignas(64) std::atomic_bool IOP_SIF0_pending, IOP_SIF1_pending;
 
         uint32_t oldest_SIF0_data[4];
 
-        std::queue<uint32_t> SIF0_FIFO;
-        std::queue<uint32_t> SIF1_FIFO;
+        SIF_FIFO SIF0_FIFO;
+        SIF_FIFO SIF1_FIFO;
     public:
         constexpr static int MAX_FIFO_SIZE = 32;
         SubsystemInterface(IOP_DMA* iop_dma, DMAC* dmac);
 
         void reset();
+        void set_threaded(bool threaded);
+        void update_EE_DMA_requests();
+        void update_IOP_DMA_requests();
+
         int get_SIF0_size();
         int get_SIF1_size();
 
         void write_SIF0(uint32_t word);
+        void write_SIF0(const uint32_t* words, int count);
         void send_SIF0_junk(int count);
         void write_SIF1(uint128_t quad);
+        void write_SIF1(const uint128_t* quads, int count);
         uint32_t read_SIF0();
+        void read_SIF0(uint128_t* quads, int count);
         uint32_t read_SIF1();
+        void read_SIF1(uint32_t* words, int count);
 
         uint32_t get_mscom();
         uint32_t get_smcom();
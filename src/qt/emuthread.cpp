@@ -3,6 +3,7 @@
 #include <fstream>
 
 #include "emuthread.hpp"
+#include "../core/ee/ee_jit.hpp"
 
 using namespace std;
 
@@ -22,19 +23,20 @@ EmuThread::EmuThread()
     gsdump_reading = false;
     frame_advance = false;
     block_run_loop = false;
-    gsdump_read_buffer = new GSMessage[GSDUMP_BUFFERED_MESSAGES];
+    unthrottled = false;
+    speed_percent = 100;
+    gsdump_target_frame = 0;
+    qRegisterMetaType<GSOutputFrames*>();
 }
 
 EmuThread::~EmuThread()
 {
-    delete[] gsdump_read_buffer;
+
 }
 
 void EmuThread::reset()
 {
     e.reset();
-    buffered_gs_messages = 0;
-    current_gs_message = 0;
 }
 
 void EmuThread::set_skip_BIOS_hack(SKIP_HACK skip)
@@ -47,11 +49,115 @@ void EmuThread::set_ee_mode(CPU_MODE mode)
     wait_for_lock([=]() {  e.set_ee_mode(mode); } );
 }
 
+void EmuThread::set_ee_background_jit(bool enabled)
+{
+    wait_for_lock([=]() { EE_JIT::set_background_compile(enabled); } );
+}
+
+void EmuThread::set_vu0_mode(CPU_MODE mode)
+{
+    wait_for_lock([=]() { e.set_vu0_mode(mode); } );
+}
+
 void EmuThread::set_vu1_mode(CPU_MODE mode)
 {
     wait_for_lock([=]() { e.set_vu1_mode(mode); } );
 }
 
+void EmuThread::set_vu_jit_cache_path(const std::string& path)
+{
+    wait_for_lock([=]() { e.set_vu_jit_cache_path(path); } );
+}
+
+void EmuThread::set_iop_thread(int max_skew)
+{
+    wait_for_lock([=]() {
+        e.set_iop_max_skew(max_skew);
+        e.set_iop_threaded(true);
+    } );
+}
+
+void EmuThread::set_unthrottled(bool value)
+{
+    unthrottled = value;
+}
+
+void EmuThread::set_profiler_enabled(bool enabled)
+{
+    wait_for_lock([=]() { Profiler::set_enabled(enabled); } );
+    if (!enabled)
+        emit update_profile(QString());
+}
+
+void EmuThread::set_ee_jit_block_stats(bool enabled)
+{
+    wait_for_lock([=]() { EE_JIT::set_block_stats_enabled(enabled); } );
+}
+
+void EmuThread::print_ee_jit_block_report()
+{
+    wait_for_lock([=]() { EE_JIT::print_block_report(); } );
+}
+
+bool EmuThread::write_profile_csv(const QString& path)
+{
+    bool fail = false;
+    wait_for_lock([=, &fail]() { if (!Profiler::write_csv(path.toStdString())) fail = true; } );
+    return fail;
+}
+
+bool EmuThread::set_audio_dump(const QString& path)
+{
+    std::unique_ptr<WavAudioSink> sink(new WavAudioSink());
+    if (!sink->open(path.toStdString()))
+        return true;
+
+    wait_for_lock([&]() { e.set_audio_sink(std::move(sink)); } );
+    return false;
+}
+
+bool EmuThread::set_memcard(const QString& path)
+{
+    bool fail = false;
+    std::string name = path.toStdString();
+    wait_for_lock([&]() { fail = !e.load_memcard(name.c_str()); } );
+    return fail;
+}
+
+void EmuThread::report_profile()
+{
+    Profiler::Frame frame;
+    if (!Profiler::is_enabled() || !Profiler::get_last_frame(frame))
+        return;
+
+    QString summary = QString("Frame %1: %2 ms, GS busy %3 ms, idle %4 ms\n")
+        .arg(frame.frame).arg(frame.wall_ms, 0, 'f', 2)
+        .arg(frame.gs_busy_ms, 0, 'f', 2).arg(frame.gs_idle_ms, 0, 'f', 2);
+    for (int i = 0; i < Profiler::SECTION_COUNT; i++)
+    {
+        auto section = (Profiler::Section)i;
+        summary += QString("%1: %2 ms\n").arg(Profiler::get_section_name(section))
+            .arg(frame.section_ms[i], 0, 'f', 2);
+    }
+    for (int i = 0; i < Profiler::JIT_COUNT; i++)
+    {
+        auto jit = (Profiler::Jit)i;
+        summary += QString("%1: %2 ms, %3 blocks, %4 flushes\n").arg(Profiler::get_jit_name(jit))
+            .arg(frame.jit_compile_ms[i], 0, 'f', 2).arg(frame.jit_compiles[i]).arg(frame.jit_flushes[i]);
+    }
+
+    AudioMetrics audio = e.get_audio_metrics();
+    summary += QString("Audio: %1/%2 buffered, %3 dropped, %4 underruns, rate %5\n")
+        .arg(audio.fill).arg(audio.capacity).arg(audio.dropped).arg(audio.underruns)
+        .arg(audio.rate, 0, 'f', 3);
+    emit update_profile(summary.trimmed());
+}
+
+void EmuThread::set_speed(int percent)
+{
+    speed_percent = percent;
+}
+
 void EmuThread::load_BIOS(const uint8_t *BIOS)
 {
     wait_for_lock([=]() { e.load_BIOS(BIOS); } );
@@ -94,18 +200,20 @@ bool EmuThread::save_state(const char *name)
 
 bool EmuThread::gsdump_read(const char *name)
 {
-    wait_for_lock([=]() 
+    bool fail = false;
+    wait_for_lock([=, &fail]() 
     { 
-        gsdump.open(name,ios::binary);
-        if (!gsdump.is_open())
-            return 1;
-        e.get_gs().reset();
-        e.get_gs().load_state(gsdump);
+        if (!gsdump.open(name) || !gsdump.seek(0, e.get_gs()))
+        {
+            fail = true;
+            return;
+        }
+        gsdump_target_frame = 0;
 
         printf("loaded gsdump\n");
         gsdump_reading = true;
     });
-    return 0;
+    return fail;
 }
 
 void EmuThread::gsdump_write_toggle()
@@ -118,67 +226,83 @@ void EmuThread::gsdump_single_frame()
     wait_for_lock([=]() { e.request_gsdump_single_frame(); } );
 }
 
-GSMessage& EmuThread::get_next_gsdump_message()
+bool EmuThread::gsdump_seek(int frame)
 {
-    if(!buffered_gs_messages) {
-        gsdump.read((char*)gsdump_read_buffer, sizeof(GSMessage) * GSDUMP_BUFFERED_MESSAGES);
-        current_gs_message = 0;
-        buffered_gs_messages = gsdump.gcount() / sizeof(GSMessage);
-    }
-    GSMessage& data = gsdump_read_buffer[current_gs_message];
-    current_gs_message++;
-    buffered_gs_messages--;
-    return data;
+    bool fail = false;
+    wait_for_lock([=, &fail]()
+    {
+        if (!gsdump_reading || frame < 0 || !gsdump.seek(frame, e.get_gs()))
+        {
+            fail = true;
+            return;
+        }
+
+        //The reader lands on the nearest keyframe; gsdump_run replays the rest up to the requested frame
+        gsdump_target_frame = frame;
+        printf("gsdump seek to frame %d (keyframe %d)\n", frame, gsdump.get_current_frame());
+    });
+    if (!fail)
+        unpause(PAUSE_EVENT::FRAME_ADVANCE);
+    return fail;
 }
 
-bool EmuThread::gsdump_eof()
+int EmuThread::gsdump_frame_count()
 {
-    return gsdump.eof() && !buffered_gs_messages;
+    return gsdump.get_frame_count();
 }
 
 void EmuThread::gsdump_run()
 {
     printf("gsdump frame\n");
+    QMutexLocker locker(&emu_mutex);
     try
     {
         int draws_sent = 10;
         while (true)
         {
-            GSMessage& data = get_next_gsdump_message();
+            GSMessage data;
+            if (!gsdump.read_message(data))
+                Errors::die("gs dump unexpectedly ended");
 
+            bool seeking = gsdump.get_current_frame() < gsdump_target_frame;
             switch (data.type)
             {
                 case set_xyz_t:
                     e.get_gs().send_message(data);
                     e.get_gs().wake_gs_thread();
-                    if (frame_advance && data.payload.xyz_payload.drawing_kick && --draws_sent <= 0)
+                    if (!seeking && frame_advance && data.payload.xyz_payload.drawing_kick && --draws_sent <= 0)
                     {
                         uint16_t w, h;
-                        uint32_t* frame = e.get_gs().render_partial_frame(w, h);
-                        emit completed_frame(frame, w, h, w, h);
+                        GSOutputFrames* frames = e.get_gs().render_partial_frame(w, h);
+                        emit completed_frame(frames, w, h);
                         pause(PAUSE_EVENT::FRAME_ADVANCE);
                         return;
                     }
                     break;
                 case render_crt_t:
                 {
+                    //The reader has already counted this frame, so anything up to the target is skipped.
+                    //Returning between skipped frames keeps the lock free for the UI while seeking.
+                    if (gsdump.get_current_frame() <= gsdump_target_frame)
+                        return;
                     printf("gsdump frame render\n");
                     e.get_gs().render_CRT();
-                    int w, h, new_w, new_h;
-                    e.get_inner_resolution(w, h);
+                    int new_w, new_h;
                     e.get_resolution(new_w, new_h);
 
-                    emit completed_frame(e.get_gs().get_framebuffer(), w, h, new_w, new_h);
+                    emit completed_frame(e.get_gs().get_framebuffer(), new_w, new_h);
                     printf("gsdump frame render complete\n");
                     pause(PAUSE_EVENT::FRAME_ADVANCE);
                     return;
                 }
                 case gsdump_t:
                     pause(PAUSE_EVENT::GAME_NOT_LOADED);
-                    if (gsdump.peek() != EOF)
-                        Errors::die("gsdump ended before end of file!");
                     gsdump.close();
+                    gsdump_reading = false;
                     Errors::die("gsdump ended successfully\n");
+                case memdump_t:
+                    //Partial frames are requested by the player itself, not replayed
+                    break;
                 case save_state_t:
                 case load_state_t:
                     Errors::die("save_state save/load during gsdump not supported!");
@@ -186,8 +310,6 @@ void EmuThread::gsdump_run()
                     e.get_gs().send_message(data);
                     //e.get_gs().wake_gs_thread();
             }
-            if (gsdump_eof())
-                Errors::die("gs dump unexpectedly ended");
         }
     }
     catch (Emulation_error &e)
@@ -222,22 +344,20 @@ void EmuThread::run()
                 pause(PAUSE_EVENT::FRAME_ADVANCE);
             try
             {
-                QMutexLocker locker(&emu_mutex);
-                e.run();
-                int w, h, new_w, new_h;
-                e.get_inner_resolution(w, h);
-                e.get_resolution(new_w, new_h);
-                emit completed_frame(e.get_framebuffer(), w, h, new_w, new_h);
-
-                //Update FPS
-                double FPS;
-                do
                 {
-                    chrono::system_clock::time_point now = chrono::system_clock::now();
-                    chrono::duration<double> elapsed_seconds = now - old_frametime;
-                    FPS = 1.0 / elapsed_seconds.count();
-                } while (FPS > 60.0);
-                old_frametime = chrono::system_clock::now();
+                    QMutexLocker locker(&emu_mutex);
+                    e.run();
+                    int new_w, new_h;
+                    e.get_resolution(new_w, new_h);
+                    emit completed_frame(e.get_framebuffer(), new_w, new_h);
+                    pacer.set_frame_rate(e.get_refresh_rate());
+                    report_profile();
+                }
+
+                //Wait outside the lock so the UI thread isn't held up by frame pacing
+                pacer.set_unthrottled(unthrottled);
+                pacer.set_speed(speed_percent / 100.0);
+                double FPS = pacer.wait_for_next_frame();
                 emit update_FPS(FPS);
             }
             catch (non_fatal_error &error)
@@ -3,14 +3,18 @@
 
 #include <chrono>
 
+#include <QMetaType>
 #include <QMutex>
 #include <QThread>
 #include <string>
 
 #include "../core/emulator.hpp"
 #include "../core/errors.hpp"
+#include "../core/gsdump.hpp"
+#include "../core/profiler.hpp"
+#include "framepacer.hpp"
 
-#define GSDUMP_BUFFERED_MESSAGES 100000
+Q_DECLARE_METATYPE(GSOutputFrames*)
 
 enum PAUSE_EVENT
 {
@@ -30,15 +34,18 @@ class EmuThread : public QThread
         QMutex emu_mutex;
         Emulator e;
 
-        std::chrono::system_clock::time_point old_frametime;
-        std::ifstream gsdump;
+        FramePacer pacer;
+        std::atomic_bool unthrottled;
+        std::atomic<int> speed_percent;
+        GSDumpReader gsdump;
         std::atomic_bool gsdump_reading;
         std::atomic_bool block_run_loop;
-        GSMessage* gsdump_read_buffer;
-        int buffered_gs_messages;
-        int current_gs_message;
+
+        //Frames before this one are replayed without being displayed after a seek
+        uint32_t gsdump_target_frame;
 
         void gsdump_run();
+        void report_profile();
         template <typename Func> void wait_for_lock(Func f);
     public:
         EmuThread();
@@ -47,7 +54,19 @@ class EmuThread : public QThread
 
         void set_skip_BIOS_hack(SKIP_HACK skip);
         void set_ee_mode(CPU_MODE mode);
+        void set_ee_background_jit(bool enabled);
+        void set_vu0_mode(CPU_MODE mode);
         void set_vu1_mode(CPU_MODE mode);
+        void set_vu_jit_cache_path(const std::string& path);
+        void set_iop_thread(int max_skew);
+        void set_unthrottled(bool value);
+        void set_speed(int percent);
+        void set_profiler_enabled(bool enabled);
+        void set_ee_jit_block_stats(bool enabled);
+        void print_ee_jit_block_report();
+        bool write_profile_csv(const QString& path);
+        bool set_audio_dump(const QString& path);
+        bool set_memcard(const QString& path);
         void load_BIOS(const uint8_t* BIOS);
         void load_ELF(const uint8_t* ELF, uint64_t ELF_size);
         void load_CDVD(const char* name, CDVD_CONTAINER type);
@@ -57,14 +76,15 @@ class EmuThread : public QThread
         bool gsdump_read(const char* name);
         void gsdump_write_toggle();
         void gsdump_single_frame();
-        GSMessage& get_next_gsdump_message();
-        bool gsdump_eof();
+        bool gsdump_seek(int frame);
+        int gsdump_frame_count();
         std::atomic_bool frame_advance;
     protected:
         void run() override;
     signals:
-        void completed_frame(uint32_t* buffer, int inner_w, int inner_h, int final_w, int final_h);
+        void completed_frame(GSOutputFrames* frames, int final_w, int final_h);
         void update_FPS(double FPS);
+        void update_profile(QString summary);
         void emu_error(QString err);
         void emu_non_fatal_error(QString err);
     public slots:
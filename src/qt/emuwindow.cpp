@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
@@ -6,8 +8,11 @@
 #include <QString>
 #include <QVBoxLayout>
 #include <QMenuBar>
+#include <QActionGroup>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
+#include <QStandardPaths>
 #include <QTableWidget>
 
 #include "emuwindow.hpp"
@@ -18,6 +23,8 @@
 
 #include "arg.h"
 
+#include "../core/jitcommon/jitsymbols.hpp"
+
 using namespace std;
 
 EmuWindow::EmuWindow(QWidget *parent) : QMainWindow(parent)
@@ -31,6 +38,9 @@ EmuWindow::EmuWindow(QWidget *parent) : QMainWindow(parent)
     connect(&emu_thread, &EmuThread::completed_frame,
         render_widget, &RenderWidget::draw_frame
     );
+    connect(&emu_thread, &EmuThread::update_profile,
+        render_widget, &RenderWidget::set_overlay
+    );
 
     GameListWidget* game_list_widget = new GameListWidget;
     connect(game_list_widget, &GameListWidget::game_double_clicked, this, [=](QString path) {
@@ -51,6 +61,11 @@ EmuWindow::EmuWindow(QWidget *parent) : QMainWindow(parent)
 
     create_menu();
 
+    //Translated VU microprograms are kept between sessions
+    QString cache_dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cache_dir.isEmpty() && QDir().mkpath(cache_dir))
+        emu_thread.set_vu_jit_cache_path(QDir(cache_dir).filePath("vu_jit.cache").toStdString());
+
     connect(this, SIGNAL(shutdown()), &emu_thread, SLOT(shutdown()));
     connect(this, SIGNAL(press_key(PAD_BUTTON)), &emu_thread, SLOT(press_key(PAD_BUTTON)));
     connect(this, SIGNAL(release_key(PAD_BUTTON)), &emu_thread, SLOT(release_key(PAD_BUTTON)));
@@ -73,6 +88,9 @@ EmuWindow::EmuWindow(QWidget *parent) : QMainWindow(parent)
 int EmuWindow::init(int argc, char** argv)
 {
     bool skip_BIOS = false;
+    bool benchmark = false;
+    GSBenchmarkOptions bench_options = { false, true, 0 };
+    bool bench_ab = false;
     char* argv0; // Program name; AKA argv[0]
 
     char* bios_name = nullptr, *file_name = nullptr, *gsdump = nullptr;
@@ -93,6 +111,61 @@ int EmuWindow::init(int argc, char** argv)
         case 'g':
             gsdump = ARGF();
             break;
+        case 'B':
+            benchmark = true;
+            break;
+        case 'n':
+            bench_options.skip_crt = true;
+            break;
+        case 'p':
+        {
+            QString path = QString::fromLocal8Bit(ARGF());
+            bench_options.pixel_jit = path != "interp";
+            bench_ab = path == "ab";
+            break;
+        }
+        case 'j':
+        {
+            JitSymbols::Format format;
+            if (!JitSymbols::parse_format(ARGF(), format))
+            {
+                printf("-j must be perfmap, jitdump or none\n");
+                return 1;
+            }
+            JitSymbols::set_format(format);
+            break;
+        }
+        case 'w':
+        {
+            QString path = QString::fromLocal8Bit(ARGF());
+            if (emu_thread.set_audio_dump(path))
+            {
+                printf("Failed to open %s for audio dumping\n", path.toLocal8Bit().constData());
+                return 1;
+            }
+            break;
+        }
+        case 'm':
+        {
+            QString path = QString::fromLocal8Bit(ARGF());
+            if (emu_thread.set_memcard(path))
+            {
+                printf("Failed to load memory card %s\n", path.toLocal8Bit().constData());
+                return 1;
+            }
+            break;
+        }
+        case 'i':
+        {
+            int max_skew = atoi(ARGF());
+            if (max_skew <= 0)
+            {
+                printf("-i needs a positive number of IOP cycles\n");
+                return 1;
+            }
+            emu_thread.set_iop_thread(max_skew);
+            break;
+        }
         case 'h':
         default:
             printf("usage: %s [options]\n\n", argv0);
@@ -102,9 +175,29 @@ int EmuWindow::init(int argc, char** argv)
             printf("-h\t\tshow this message\n");
             printf("-s\t\tskip BIOS\n");
             printf("-g {.GSD}\t\trun a gsdump\n");
+            printf("-B\t\tbenchmark the gsdump given with -g and exit\n");
+            printf("-n\t\tdon't render CRT output while benchmarking\n");
+            printf("-p {jit/interp/ab}\tpixel path to benchmark, ab runs both\n");
+            printf("-j {perfmap/jitdump}\texport JIT block symbols for perf\n");
+            printf("-w {WAV}\tdump audio to a WAV file\n");
+            printf("-i {CYCLES}\trun the IOP on its own thread, up to CYCLES IOP cycles behind the EE\n");
+            printf("-m {CARD}\tuse CARD as the memory card in slot 1, creating it if needed\n");
             return 1;
     } ARGEND
 
+    if (benchmark)
+    {
+        if (!gsdump)
+        {
+            printf("-B needs a gsdump (-g)\n");
+            return 1;
+        }
+
+        //Nothing else runs, so the emulation thread can go away before the benchmark starts
+        emu_thread.shutdown();
+        return run_gs_benchmark(gsdump, bench_options, bench_ab);
+    }
+
     if (gsdump)
     {
         return load_exec(gsdump, false);
@@ -126,6 +219,36 @@ EmuWindow::~EmuWindow()
     emu_thread.wait();
 }
 
+int EmuWindow::run_gs_benchmark(const char* gsdump, GSBenchmarkOptions options, bool ab)
+{
+    GSBenchmarkResult jit, interp;
+    benchmark_only = true;
+
+    if (options.pixel_jit || ab)
+    {
+        options.pixel_jit = true;
+        if (!GSReplayBenchmark::run(gsdump, options, jit))
+            return 1;
+        GSReplayBenchmark::print("JIT", jit);
+    }
+    if (!options.pixel_jit || ab)
+    {
+        options.pixel_jit = false;
+        if (!GSReplayBenchmark::run(gsdump, options, interp))
+            return 1;
+        GSReplayBenchmark::print("interpreter", interp);
+    }
+
+    if (ab)
+        GSReplayBenchmark::print_comparison("JIT", jit, "interpreter", interp);
+    return 0;
+}
+
+bool EmuWindow::is_benchmark_only() const
+{
+    return benchmark_only;
+}
+
 
 int EmuWindow::load_exec(const char* file_name, bool skip_BIOS)
 {
@@ -173,6 +296,18 @@ int EmuWindow::load_exec(const char* file_name, bool skip_BIOS)
         if (skip_BIOS)
             emu_thread.set_skip_BIOS_hack(SKIP_HACK::LOAD_DISC);
     }
+    else if (QString::compare(ext, "zso", Qt::CaseInsensitive) == 0)
+    {
+        emu_thread.load_CDVD(file_name, CDVD_CONTAINER::ZSO);
+        if (skip_BIOS)
+            emu_thread.set_skip_BIOS_hack(SKIP_HACK::LOAD_DISC);
+    }
+    else if (QString::compare(ext, "gz", Qt::CaseInsensitive) == 0)
+    {
+        emu_thread.load_CDVD(file_name, CDVD_CONTAINER::BGZF);
+        if (skip_BIOS)
+            emu_thread.set_skip_BIOS_hack(SKIP_HACK::LOAD_DISC);
+    }
     else if (QString::compare(ext, "gsd", Qt::CaseInsensitive) == 0)
         emu_thread.gsdump_read(file_name);
     else
@@ -182,6 +317,7 @@ int EmuWindow::load_exec(const char* file_name, bool skip_BIOS)
     }
 
     set_ee_mode();
+    set_vu0_mode();
     set_vu1_mode();
 
     current_ROM = file_info;
@@ -230,6 +366,19 @@ void EmuWindow::create_menu()
     connect(toggle_gsdump_action, &QAction::triggered, this,
         [this]() { this->emu_thread.gsdump_write_toggle(); });
 
+    auto seek_gsdump_action = new QAction(tr("GS dump s&eek to frame..."), this);
+    connect(seek_gsdump_action, &QAction::triggered, this, [=] (){
+        emu_thread.pause(PAUSE_EVENT::MESSAGE_BOX);
+
+        bool ok = false;
+        int last_frame = std::max(emu_thread.gsdump_frame_count() - 1, 0);
+        int frame = QInputDialog::getInt(this, tr("Seek GS dump"), tr("Frame:"), 0, 0, last_frame, 1, &ok);
+        if (ok && emu_thread.gsdump_seek(frame))
+            QMessageBox::warning(this, tr("Seek GS dump"), tr("Seeking requires an indexed GS dump."));
+
+        emu_thread.unpause(PAUSE_EVENT::MESSAGE_BOX);
+    });
+
     exit_action = new QAction(tr("&Exit"), this);
     connect(exit_action, &QAction::triggered, this, &QWidget::close);
 
@@ -294,6 +443,7 @@ void EmuWindow::create_menu()
     file_menu->addAction(save_state_action);
     file_menu->addSeparator();
     file_menu->addAction(toggle_gsdump_action);
+    file_menu->addAction(seek_gsdump_action);
     file_menu->addSeparator();
     file_menu->addAction(exit_action);
 
@@ -318,6 +468,52 @@ void EmuWindow::create_menu()
         frame_action->setChecked(emu_thread.frame_advance);
     });
 
+    auto unthrottled_action = new QAction(tr("U&nthrottled"), this);
+    unthrottled_action->setCheckable(true);
+    connect(unthrottled_action, &QAction::toggled, this, [=] (bool checked){
+        emu_thread.set_unthrottled(checked);
+    });
+
+    auto speed_menu = new QMenu(tr("S&peed"), this);
+    auto speed_group = new QActionGroup(this);
+    const int speeds[] = {50, 100, 200, 300};
+    for (int percent : speeds)
+    {
+        auto speed_action = new QAction(QString("%1%").arg(percent), speed_group);
+        speed_action->setCheckable(true);
+        speed_action->setChecked(percent == 100);
+        connect(speed_action, &QAction::triggered, this, [=] (){
+            emu_thread.set_speed(percent);
+        });
+        speed_menu->addAction(speed_action);
+    }
+
+    auto profiler_action = new QAction(tr("&Profiler Overlay"), this);
+    profiler_action->setCheckable(true);
+    connect(profiler_action, &QAction::toggled, this, [=] (bool checked){
+        emu_thread.set_profiler_enabled(checked);
+    });
+
+    auto profile_csv_action = new QAction(tr("Dump Profile to &CSV..."), this);
+    connect(profile_csv_action, &QAction::triggered, this, [=] (){
+        QString path = QFileDialog::getSaveFileName(this, tr("Dump Profile"), "profile.csv", tr("CSV (*.csv)"));
+        if (path.isEmpty())
+            return;
+        if (emu_thread.write_profile_csv(path))
+            QMessageBox::critical(this, tr("Error"), tr("Failed to write %1").arg(path));
+    });
+
+    auto block_stats_action = new QAction(tr("EE JIT &Block Stats"), this);
+    block_stats_action->setCheckable(true);
+    connect(block_stats_action, &QAction::toggled, this, [=] (bool checked){
+        emu_thread.set_ee_jit_block_stats(checked);
+    });
+
+    auto block_report_action = new QAction(tr("Print EE JIT Block &Report"), this);
+    connect(block_report_action, &QAction::triggered, this, [=] (){
+        emu_thread.print_ee_jit_block_report();
+    });
+
     auto shutdown_action = new QAction(tr("&Shutdown"), this);
     connect(shutdown_action, &QAction::triggered, this, [=]() {
         emu_thread.pause(PAUSE_EVENT::GAME_NOT_LOADED);
@@ -330,6 +526,14 @@ void EmuWindow::create_menu()
     emulation_menu->addSeparator();
     emulation_menu->addAction(frame_action);
     emulation_menu->addSeparator();
+    emulation_menu->addAction(unthrottled_action);
+    emulation_menu->addMenu(speed_menu);
+    emulation_menu->addSeparator();
+    emulation_menu->addAction(profiler_action);
+    emulation_menu->addAction(profile_csv_action);
+    emulation_menu->addAction(block_stats_action);
+    emulation_menu->addAction(block_report_action);
+    emulation_menu->addSeparator();
     emulation_menu->addAction(shutdown_action);
 
     auto settings_action = new QAction(tr("&Settings"), this);
@@ -554,10 +758,10 @@ void EmuWindow::update_FPS(double FPS)
     framerate_avg = 0.8 * framerate_avg + 0.2 * FPS;
 
     // avoid multiple copies
-    QString status = QString("FPS: %1 (%2 ms, %3 ms worst)- %4 [EE: %5] [VU1: %6]").arg(
+    QString status = QString("FPS: %1 (%2 ms, %3 ms worst)- %4 [EE: %5] [VU0: %6] [VU1: %7]").arg(
         QString::number(framerate_avg, 'f', 1), QString::number(frametime_avg * 1000., 'f', 1),
         QString::number(worst_frame_time * 1000., 'f', 1),
-        current_ROM.fileName(), ee_mode, vu1_mode
+        current_ROM.fileName(), ee_mode, vu0_mode, vu1_mode
     );
 
     setWindowTitle(status);
@@ -612,7 +816,7 @@ void EmuWindow::open_file_no_skip()
     emu_thread.pause(PAUSE_EVENT::FILE_DIALOG);
     QString file_name = QFileDialog::getOpenFileName(
         this, tr("Open Rom"), Settings::instance().last_used_directory,
-        tr("ROM Files (*.elf *.iso *.cso)")
+        tr("ROM Files (*.elf *.iso *.cso *.zso *.gz)")
     );
 
     if (!file_name.isEmpty())
@@ -629,7 +833,7 @@ void EmuWindow::open_file_skip()
     emu_thread.pause(PAUSE_EVENT::FILE_DIALOG);
     QString file_name = QFileDialog::getOpenFileName(
         this, tr("Open Rom"), Settings::instance().last_used_directory,
-        tr("ROM Files (*.elf *.iso *.cso)")
+        tr("ROM Files (*.elf *.iso *.cso *.zso *.gz)")
     );
 
     if (!file_name.isEmpty())
@@ -700,6 +904,23 @@ void EmuWindow::set_ee_mode()
         ee_mode = "Interpreter";
     }
     emu_thread.set_ee_mode(mode);
+    emu_thread.set_ee_background_jit(Settings::instance().ee_jit_enabled && Settings::instance().ee_jit_background);
+}
+
+void EmuWindow::set_vu0_mode()
+{
+    CPU_MODE mode;
+    if (Settings::instance().vu0_jit_enabled)
+    {
+        mode = CPU_MODE::JIT;
+        vu0_mode = "JIT";
+    }
+    else
+    {
+        mode = CPU_MODE::INTERPRETER;
+        vu0_mode = "Interpreter";
+    }
+    emu_thread.set_vu0_mode(mode);
 }
 
 void EmuWindow::set_vu1_mode()
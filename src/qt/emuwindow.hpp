@@ -9,6 +9,7 @@
 
 #include "../qt/settings.hpp"
 #include "../core/emulator.hpp"
+#include "../core/gsbench.hpp"
 
 class SettingsWindow;
 class RenderWidget;
@@ -19,6 +20,7 @@ class EmuWindow : public QMainWindow
     private:
         EmuThread emu_thread;
         QString ee_mode;
+        QString vu0_mode;
         QString vu1_mode;
 
         std::chrono::system_clock::time_point old_frametime;
@@ -27,6 +29,7 @@ class EmuWindow : public QMainWindow
         int frametime_list_index = 0;
 
         bool disable_fps_updates{ false };
+        bool benchmark_only{ false };
 
         QFileInfo current_ROM;
         QMenu* file_menu;
@@ -43,15 +46,19 @@ class EmuWindow : public QMainWindow
 
         SettingsWindow* settings_window = nullptr;
 
+        void set_vu0_mode();
         void set_vu1_mode();
         void set_ee_mode();
         void show_render_view();
         void show_default_view();
+
+        int run_gs_benchmark(const char* gsdump, GSBenchmarkOptions options, bool ab);
     public:
         explicit EmuWindow(QWidget *parent = nullptr);
         ~EmuWindow() final;
 
         int init(int argc, char** argv);
+        bool is_benchmark_only() const;
         int load_exec(const char* file_name, bool skip_BIOS);
 
         void create_menu();
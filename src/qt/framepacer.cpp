@@ -0,0 +1,75 @@
+#include <thread>
+
+#include "framepacer.hpp"
+
+using namespace std;
+
+FramePacer::FramePacer() : frame_rate(60.0), speed(1.0), unthrottled(false)
+{
+    reset();
+}
+
+void FramePacer::reset()
+{
+    last_frame = clock::now();
+    next_frame = last_frame;
+}
+
+void FramePacer::set_frame_rate(double rate)
+{
+    if (rate > 0.0)
+        frame_rate = rate;
+}
+
+void FramePacer::set_speed(double multiplier)
+{
+    if (multiplier > 0.0)
+        speed = multiplier;
+}
+
+void FramePacer::set_unthrottled(bool value)
+{
+    if (unthrottled && !value)
+        next_frame = clock::now();
+    unthrottled = value;
+}
+
+FramePacer::clock::duration FramePacer::frame_duration() const
+{
+    chrono::duration<double> seconds(1.0 / (frame_rate * speed));
+    return chrono::duration_cast<clock::duration>(seconds);
+}
+
+double FramePacer::wait_for_next_frame()
+{
+    clock::time_point now = clock::now();
+
+    if (!unthrottled)
+    {
+        clock::duration duration = frame_duration();
+        next_frame += duration;
+
+        //After a pause or a long stall, don't run flat out to make up the lost frames
+        if (now - next_frame > duration * MAX_FRAMES_BEHIND)
+            next_frame = now;
+
+        while (next_frame - now > SPIN_MARGIN)
+        {
+            this_thread::sleep_for(next_frame - now - SPIN_MARGIN);
+            now = clock::now();
+        }
+
+        while (now < next_frame)
+        {
+            this_thread::yield();
+            now = clock::now();
+        }
+    }
+
+    chrono::duration<double> elapsed_seconds = now - last_frame;
+    last_frame = now;
+
+    if (elapsed_seconds.count() <= 0.0)
+        return 0.0;
+    return 1.0 / elapsed_seconds.count();
+}
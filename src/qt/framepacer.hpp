@@ -0,0 +1,41 @@
+#ifndef FRAMEPACER_HPP
+#define FRAMEPACER_HPP
+
+#include <chrono>
+
+/**
+  * Paces emulated frames to the console's refresh rate.
+  * Most of the wait is spent asleep; only the final stretch, where the OS scheduler is too coarse
+  * to wake us on time, is spun out.
+  */
+class FramePacer
+{
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        //How early to wake up from sleep and start spinning
+        const clock::duration SPIN_MARGIN = std::chrono::microseconds(1000);
+        //If we fall further behind than this, give up on catching up and start pacing from now
+        const int MAX_FRAMES_BEHIND = 3;
+
+        clock::time_point next_frame;
+        clock::time_point last_frame;
+
+        double frame_rate;
+        double speed;
+        bool unthrottled;
+
+        clock::duration frame_duration() const;
+    public:
+        FramePacer();
+
+        void reset();
+        void set_frame_rate(double rate);
+        void set_speed(double multiplier);
+        void set_unthrottled(bool value);
+
+        //Blocks until the next frame is due, returns the frame rate actually achieved
+        double wait_for_next_frame();
+};
+
+#endif // FRAMEPACER_HPP
@@ -83,6 +83,8 @@ QStringList GameListModel::get_directory_entries(QString path)
     const QStringList file_types({
         "*.iso",
         "*.cso",
+        "*.zso",
+        "*.gz",
         "*.elf",
         "*.gsd"
     });
@@ -16,6 +16,10 @@ int main(int argc, char** argv)
     if (window->init(argc, argv))
         return 1;
 
+    //Benchmarks print their results from init and don't need the UI
+    if (window->is_benchmark_only())
+        return 0;
+
     a.exec();
     return 0;
 }
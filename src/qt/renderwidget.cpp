@@ -15,23 +15,55 @@ RenderWidget::RenderWidget(QWidget* parent)
     setAutoFillBackground(true);
 }
 
-void RenderWidget::draw_frame(uint32_t* buffer, int inner_w, int inner_h, int final_w, int final_h)
+void RenderWidget::draw_frame(GSOutputFrames* frames, int final_w, int final_h)
 {
-    if (!buffer || !inner_w || !inner_h)
+    if (!frames || !final_w || !final_h)
         return;
 
-    final_image = QImage(
-        reinterpret_cast<uint8_t*>(buffer),
-        inner_w, inner_h, QImage::Format_RGBA8888
-    ).scaled(final_w, final_h);
+    this->frames = frames;
+    this->final_w = final_w;
+    this->final_h = final_h;
 
+    //The frame itself is picked up in paintEvent, so frames that arrive faster than we paint are skipped
     update();
 }
 
+void RenderWidget::acquire_frame()
+{
+    if (!frames || !frames->acquire())
+        return;
+
+    int index = frames->front;
+    int w = frames->get_front_width();
+    int h = frames->get_front_height();
+
+    if (!w || !h)
+    {
+        current_frame = -1;
+        return;
+    }
+
+    QImage& image = frame_images[index];
+    if (image.width() != w || image.height() != h)
+    {
+        image = QImage(
+            reinterpret_cast<uint8_t*>(frames->get_front()),
+            w, h, w * sizeof(uint32_t), QImage::Format_RGBA8888
+        );
+    }
+    current_frame = index;
+}
+
 void RenderWidget::paintEvent(QPaintEvent* event)
 {
     event->accept();
 
+    acquire_frame();
+    if (current_frame < 0)
+        return;
+
+    const QImage& image = frame_images[current_frame];
+
     QPainter painter(this);
 
     QRect widget_rect(
@@ -40,15 +72,39 @@ void RenderWidget::paintEvent(QPaintEvent* event)
         painter.device()->height()
     );
 
-    QImage image = final_image.scaled(
-        widget_rect.width(), widget_rect.height(),
+    QSize display_size(final_w, final_h);
+    display_size.scale(
+        widget_rect.size(),
         respect_aspect_ratio ? Qt::KeepAspectRatio : Qt::IgnoreAspectRatio
     );
 
-    QRect src_rect(image.rect());
+    QRect target_rect(QPoint(0, 0), display_size);
+    target_rect.moveCenter(widget_rect.center());
 
-    src_rect.moveCenter(widget_rect.center());
-    painter.drawImage(src_rect.topLeft(), image);
+    //Integer scales are plain pixel replication, anything else gets a single filtered scale straight to the widget
+    if (display_size == image.size())
+        painter.drawImage(target_rect.topLeft(), image);
+    else
+    {
+        bool integer_scale = !(display_size.width() % image.width()) && !(display_size.height() % image.height());
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, !integer_scale);
+        painter.drawImage(target_rect, image);
+    }
+
+    if (!overlay_text.isEmpty())
+    {
+        QRect text_rect = painter.fontMetrics().boundingRect(widget_rect, Qt::AlignLeft | Qt::AlignTop, overlay_text);
+        text_rect.translate(8, 8);
+        painter.fillRect(text_rect.adjusted(-4, -4, 4, 4), QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        painter.drawText(text_rect, Qt::AlignLeft | Qt::AlignTop, overlay_text);
+    }
+}
+
+void RenderWidget::set_overlay(QString text)
+{
+    overlay_text = text;
+    update();
 }
 
 void RenderWidget::toggle_aspect_ratio()
@@ -83,5 +139,8 @@ void RenderWidget::screenshot()
         return;
     }
 
-    writer.write(final_image);
+    if (current_frame < 0)
+        return;
+
+    writer.write(frame_images[current_frame].scaled(final_w, final_h));
 }
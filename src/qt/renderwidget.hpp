@@ -4,12 +4,22 @@
 #include <QWidget>
 #include <QPaintEvent>
 
+#include "../core/gsthread.hpp"
+
 class RenderWidget : public QWidget
 {
     Q_OBJECT
     private:
-        QImage final_image;
+        GSOutputFrames* frames = nullptr;
+        //Wrappers around the GS output buffers, only rebuilt when a buffer's dimensions change
+        QImage frame_images[GSOutputFrames::FRAME_COUNT];
+        int current_frame = -1;
+        int final_w = DEFAULT_WIDTH;
+        int final_h = DEFAULT_HEIGHT;
         bool respect_aspect_ratio = true;
+        QString overlay_text;
+
+        void acquire_frame();
     public:
         static const int MAX_SCALING = 4;
         static const int DEFAULT_WIDTH = 640;
@@ -20,8 +30,9 @@ class RenderWidget : public QWidget
 
         bool get_respect_aspect_ratio() const;
     public slots:
-        void draw_frame(uint32_t* buffer, int inner_w, int inner_h, int final_w, int final_h);
+        void draw_frame(GSOutputFrames* frames, int final_w, int final_h);
         void toggle_aspect_ratio();
+        void set_overlay(QString text);
         void screenshot();
 };
-#endif
\ No newline at end of file
+#endif
@@ -28,8 +28,10 @@ class Settings final : public QObject
         QStringList rom_directories_to_remove;
         QStringList recent_roms;
 
+        bool vu0_jit_enabled;
         bool vu1_jit_enabled;
         bool ee_jit_enabled;
+        bool ee_jit_background;
 
         void save();
         void reset();